@@ -0,0 +1,98 @@
+/**
+ * @file BaseStore.hpp
+ * @brief Single-file, append-only record store for base metadata.
+ *
+ * The file starts with a versioned header and is followed by fixed-size
+ * records, each carrying its own CRC. Saves and deletes append a record; the
+ * latest record for a tag wins. The RAM index (TagId -> file offset) is a
+ * hash table rebuilt by one sequential scan on open, and the log is compacted
+ * into a fresh file once superseded records outnumber live ones: on open,
+ * and otherwise only when the owner calls compact(), since rewriting the
+ * file holds off the step ISR for a long time. The scan
+ * skips records whose CRC fails and drops a partial record at the tail.
+ *
+ * Older files are upgraded in place on open: v1 (keyed by 32-bit RFIDs) and
+ * v2 (no motion profile). v1 records keep a legacy-key flag so a 7-byte tag
+ * whose old key was its last four UID bytes can claim its record later (see
+ * rekey()).
+ */
+#pragma once
+
+#include <Arduino.h>
+#include <FS.h>
+
+#include "Storage.hpp"
+#include "TagId.hpp"
+#include "TagIndex.hpp"
+
+#ifndef STORAGE_MAX_BASES
+#define STORAGE_MAX_BASES 1024
+#endif
+
+class BaseStore {
+ public:
+  static constexpr size_t kMaxRecords = STORAGE_MAX_BASES;
+
+  struct Stats {
+    size_t live = 0;
+    size_t dead = 0;
+    size_t fileBytes = 0;
+    uint32_t compactions = 0;
+    // Records skipped on open because their CRC did not match.
+    size_t corrupt = 0;
+    size_t indexSlots = 0;
+    size_t maxProbe = 0;
+    // Bytes written to the log, compaction included.
+    uint32_t bytesWritten = 0;
+  };
+
+  struct Update {
+    TagId rfid;
+    Storage::BaseInfo info;
+  };
+
+  // Called for every valid record in log order while the file is scanned,
+  // so callers can build their own view without re-reading the file.
+  using Visitor = void (*)(TagId rfid, const Storage::BaseInfo* info, void* ctx);
+
+  bool open(const char* path, Visitor visit = nullptr, void* ctx = nullptr);
+  bool read(TagId rfid, Storage::BaseInfo& out) const;
+  // Same, but reuses `file` across calls (opened on first use) so a batch of
+  // reads costs one open.
+  bool read(TagId rfid, Storage::BaseInfo& out, File& file) const;
+  // `legacyKey` marks records imported under a 32-bit key.
+  bool put(TagId rfid, const Storage::BaseInfo& info, bool legacyKey = false);
+  // Appends records for distinct tags, new or existing, with one open and
+  // close, so a batch costs one filesystem commit. On failure none of them
+  // take effect.
+  bool putAll(const Update* updates, size_t count);
+  bool erase(TagId rfid);
+  // Reads the record stored under `rfid` only if it was imported under a
+  // legacy key, so a caller can move it without writing yet.
+  bool readLegacy(TagId rfid, Storage::BaseInfo& out) const;
+  // Moves the record stored under `from` to `to`, but only if `from` was
+  // imported under a legacy key and `to` is not taken.
+  bool rekey(TagId from, TagId to);
+  bool compact();
+  // Superseded records outnumber live ones, so compact() is worth its cost.
+  bool needsCompaction() const;
+
+  bool contains(TagId rfid) const { return m_index.contains(rfid); }
+  size_t size() const { return m_index.size(); }
+  // Sorted RFIDs greater than `after`.
+  size_t list(TagId* out, size_t max, TagId after = 0) const;
+  Stats stats() const;
+
+ private:
+  bool create();
+  bool upgrade(File& src, uint16_t version);
+  bool append(TagId rfid, uint8_t op, uint8_t flags, const Storage::BaseInfo* info);
+
+  String m_path;
+  TagIndex<kMaxRecords> m_index;
+  size_t m_dead = 0;
+  size_t m_corrupt = 0;
+  uint32_t m_fileBytes = 0;
+  uint32_t m_compactions = 0;
+  uint32_t m_bytesWritten = 0;
+};
@@ -0,0 +1,41 @@
+/**
+ * @file Boot.hpp
+ * @brief Staged startup: which subsystems are up, and how long each took.
+ *
+ * setup() brings up the core (stepper, buttons, serial console) and returns
+ * within milliseconds. Storage, the PN532 and WiFi/the web server follow as
+ * background stages, each logged with its duration and reported by the
+ * serial `boot.status` command. Commands that need a stage are refused until
+ * it is ready.
+ */
+#pragma once
+
+#include <Arduino.h>
+
+#include "JsonWriter.hpp"
+
+namespace Boot {
+
+enum class Stage : uint8_t { Core, Storage, Rfid, Wifi, Web, Count };
+enum class State : uint8_t { Pending, Running, Ready, Failed };
+
+// Stage sets for ready(), e.g. bit(Stage::Storage) | bit(Stage::Wifi).
+constexpr uint8_t bit(Stage stage) { return static_cast<uint8_t>(1u << static_cast<uint8_t>(stage)); }
+
+// Call first thing in setup(); stage times are relative to reset.
+void begin();
+void enter(Stage stage);
+void finish(Stage stage, bool ok);
+
+State state(Stage stage);
+// True when every stage in `stages` is Ready.
+bool ready(uint8_t stages);
+// The first stage in `stages` that is not Ready, for error replies.
+Stage firstMissing(uint8_t stages);
+
+const char* stageName(Stage stage);
+const char* stateName(State state);
+// Writes the boot report members into the open object.
+void toJson(JsonWriter& out);
+
+}  // namespace Boot
@@ -0,0 +1,56 @@
+/**
+ * @file Buttons.hpp
+ * @brief Interrupt-driven, debounced jog buttons.
+ *
+ * Each button edge raises a GPIO interrupt. The handler debounces by time
+ * (the first edge counts, further edges within BUTTONS_DEBOUNCE_US are
+ * bounce) and acts on the stepper directly, so a press or release reaches the
+ * motor at the next step alarm however busy the tasks are:
+ *
+ * - press: start jogging in that direction;
+ * - release within BUTTONS_HOLD_MS (a tap): stop once the plunger has moved
+ *   BUTTONS_TAP_FULL_STEPS full steps from where it was pressed;
+ * - release after that (a hold), or pressing both buttons: brake to a stop.
+ *
+ * Presses cancel queued moves. Every accepted edge is also posted to an event
+ * queue that poll() drains for the tap/hold counters.
+ */
+#pragma once
+
+#include <Arduino.h>
+
+class StepperControl;
+
+namespace Buttons {
+
+enum class Button : uint8_t { Withdraw, Dispense, Count };
+
+struct Event {
+  Button button;
+  bool pressed;
+  uint32_t atUs;
+  // For releases: how long the button was down, and whether it became a hold.
+  uint32_t heldUs;
+  bool hold;
+};
+
+struct Stats {
+  uint32_t presses = 0;
+  uint32_t taps = 0;
+  uint32_t holds = 0;
+  // Edges ignored as contact bounce.
+  uint32_t bounces = 0;
+  // Edges the handler missed and poll() caught up on.
+  uint32_t recovered = 0;
+  uint32_t dropped = 0;
+  uint32_t lastEventUs = 0;
+};
+
+void begin(StepperControl& stepper);
+// Catches a final edge that fell inside the debounce window, and drains the
+// event queue. Call from the motion task.
+void poll();
+Stats stats();
+bool isPressed(Button button);
+
+}  // namespace Buttons
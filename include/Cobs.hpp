@@ -0,0 +1,94 @@
+/**
+ * @file Cobs.hpp
+ * @brief Consistent Overhead Byte Stuffing for 0x00-delimited serial frames.
+ */
+#pragma once
+
+#include <Arduino.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+namespace Cobs {
+
+// Worst-case encoded size of `len` bytes, excluding the 0x00 delimiter.
+constexpr size_t maxEncodedSize(size_t len) { return len + len / 254 + 1; }
+
+// Encodes `len` bytes into `out` (at least maxEncodedSize(len) bytes) and
+// returns the encoded length. The output contains no 0x00 bytes.
+inline size_t encode(const uint8_t* in, size_t len, uint8_t* out) {
+  size_t codeAt = 0;
+  size_t o = 1;
+  uint8_t code = 1;
+  for (size_t i = 0; i < len; ++i) {
+    if (in[i] == 0) {
+      out[codeAt] = code;
+      codeAt = o++;
+      code = 1;
+      continue;
+    }
+    out[o++] = in[i];
+    if (++code == 0xFF) {
+      out[codeAt] = code;
+      codeAt = o++;
+      code = 1;
+    }
+  }
+  out[codeAt] = code;
+  return o;
+}
+
+// Decodes one frame (without its delimiter) into `out`, which may alias
+// `in`. Returns the decoded length, or 0 if the input is malformed or does
+// not fit in `cap` bytes.
+inline size_t decode(const uint8_t* in, size_t len, uint8_t* out, size_t cap) {
+  size_t i = 0;
+  size_t o = 0;
+  while (i < len) {
+    uint8_t code = in[i++];
+    if (code == 0 || i + code - 1 > len) return 0;
+    for (uint8_t k = 1; k < code; ++k) {
+      if (o == cap) return 0;
+      out[o++] = in[i++];
+    }
+    if (code != 0xFF && i < len) {
+      if (o == cap) return 0;
+      out[o++] = 0;
+    }
+  }
+  return o;
+}
+
+// Streams one frame to a Print as bytes are produced, buffering at most one
+// 254-byte block. finish() closes the frame with the 0x00 delimiter.
+class Encoder {
+ public:
+  explicit Encoder(Print& out) : m_out(out) {}
+
+  void put(uint8_t b) {
+    if (b == 0) {
+      emit();
+      return;
+    }
+    m_block[m_len++] = b;
+    if (m_len == 254) emit();
+  }
+
+  void finish() {
+    emit();
+    m_out.write(static_cast<uint8_t>(0));
+  }
+
+ private:
+  void emit() {
+    m_out.write(static_cast<uint8_t>(m_len + 1));
+    m_out.write(m_block, m_len);
+    m_len = 0;
+  }
+
+  Print& m_out;
+  uint8_t m_block[254];
+  size_t m_len = 0;
+};
+
+}  // namespace Cobs
@@ -0,0 +1,32 @@
+/**
+ * @file Console.hpp
+ * @brief Serial command console with JSON replies. Reading, parsing,
+ *        dispatch and reply formatting do not allocate.
+ *
+ * The console starts in text mode: one command per line, one JSON reply
+ * line each. `proto.binary [baud]` switches to COBS/CRC frames (see
+ * SerialFrames.hpp), which carry the same commands and replies with sequence
+ * numbers, plus a telemetry stream set with `proto.telemetry <hz>`.
+ * `proto.text [baud]` switches back. Log lines from other tasks are queued
+ * and written by the console between replies (see Log.hpp).
+ */
+#pragma once
+
+#include <Arduino.h>
+
+class RfidReader;
+class StepperControl;
+
+namespace Shared {
+class WifiManager;
+}
+
+namespace Console {
+
+void begin(Shared::WifiManager& wifi, RfidReader& rfid, StepperControl& stepper);
+void poll();
+// Runs one command line; lines longer than the console limit are truncated.
+// The reply goes to Serial as a text line.
+void handleLine(const char* line);
+
+}  // namespace Console
@@ -0,0 +1,193 @@
+/**
+ * @file ConsoleEngine.hpp
+ * @brief Allocation-free building blocks for the serial console: a fixed
+ *        line buffer, an in-place tokenizer, a compile-time sorted command
+ *        table and a chunked reply formatter.
+ */
+#pragma once
+
+#include <Arduino.h>
+#include <string.h>
+
+#include "JsonWriter.hpp"
+
+namespace ConsoleEngine {
+
+// Accumulates bytes into a fixed buffer until a newline. Lines longer than
+// N - 1 characters are dropped whole and reported through overflowed().
+template <size_t N>
+class LineReader {
+ public:
+  // Feeds one byte; returns the completed line (without the newline) or
+  // nullptr. The returned buffer stays valid until the next push().
+  char* push(char c) {
+    if (c == '\r') return nullptr;
+    if (c == '\n') {
+      bool dropped = m_overflow;
+      size_t len = m_len;
+      m_len = 0;
+      m_overflow = false;
+      if (dropped) {
+        m_lastOverflowed = true;
+        return nullptr;
+      }
+      m_buf[len] = '\0';
+      return m_buf;
+    }
+    if (m_len + 1 < N) {
+      m_buf[m_len++] = c;
+    } else {
+      m_overflow = true;
+    }
+    return nullptr;
+  }
+
+  // True once after a line was dropped for being too long.
+  bool overflowed() {
+    bool v = m_lastOverflowed;
+    m_lastOverflowed = false;
+    return v;
+  }
+
+ private:
+  char m_buf[N];
+  size_t m_len = 0;
+  bool m_overflow = false;
+  bool m_lastOverflowed = false;
+};
+
+// Splits a mutable line into space-separated tokens in place.
+class Args {
+ public:
+  explicit Args(char* text) : m_cursor(text) { skipSpaces(); }
+
+  // Next token, or nullptr when none are left. The token lives in the line
+  // buffer and may be split further in place.
+  char* next() {
+    if (*m_cursor == '\0') return nullptr;
+    char* start = m_cursor;
+    while (*m_cursor && *m_cursor != ' ') ++m_cursor;
+    if (*m_cursor) *m_cursor++ = '\0';
+    skipSpaces();
+    return start;
+  }
+
+  // Everything not yet consumed, with trailing spaces removed.
+  const char* rest() {
+    char* end = m_cursor + strlen(m_cursor);
+    while (end > m_cursor && end[-1] == ' ') *--end = '\0';
+    const char* r = m_cursor;
+    m_cursor = end;
+    return r;
+  }
+
+  bool empty() const { return *m_cursor == '\0'; }
+
+ private:
+  void skipSpaces() {
+    while (*m_cursor == ' ') ++m_cursor;
+  }
+
+  char* m_cursor;
+};
+
+using Handler = void (*)(Args& args);
+
+struct Command {
+  const char* name;
+  Handler run;
+  // Caller-defined bits that must be set before `run` may be called; the
+  // engine only carries them.
+  uint8_t needs = 0;
+};
+
+constexpr int compare(const char* a, const char* b) {
+  while (*a && *a == *b) {
+    ++a;
+    ++b;
+  }
+  return static_cast<unsigned char>(*a) - static_cast<unsigned char>(*b);
+}
+
+template <size_t N>
+constexpr bool isSorted(const Command (&table)[N]) {
+  for (size_t i = 1; i < N; ++i) {
+    if (compare(table[i - 1].name, table[i].name) >= 0) return false;
+  }
+  return true;
+}
+
+// Binary search over a table checked with isSorted() at compile time.
+template <size_t N>
+const Command* find(const Command (&table)[N], const char* name) {
+  size_t lo = 0;
+  size_t hi = N;
+  while (lo < hi) {
+    size_t mid = (lo + hi) / 2;
+    int c = compare(table[mid].name, name);
+    if (c == 0) return &table[mid];
+    if (c < 0) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return nullptr;
+}
+
+// Formats one {"cmd":...,"status":...[,"message":...][,"data":...]} line into
+// a fixed stack buffer and writes it to `out` in whole chunks. Payloads
+// larger than the buffer are flushed as they are produced, so replies of any
+// size need no heap. The command name and message are escaped, since an
+// unknown command is echoed back as the host sent it.
+class Reply : public Print {
+ public:
+  static constexpr size_t kChunk = 256;
+
+  Reply(Print& out, const char* cmd, bool ok, const char* message = nullptr) : m_out(out) {
+    print("{\"cmd\":");
+    JsonWriter::quote(*this, cmd);
+    print(ok ? ",\"status\":\"ok\"" : ",\"status\":\"error\"");
+    if (message && *message) {
+      print(",\"message\":");
+      JsonWriter::quote(*this, message);
+    }
+  }
+  ~Reply() {
+    print("}\r\n");
+    flush();
+  }
+
+  // Starts the data member; write one JSON value to the returned Print.
+  Print& data() {
+    print(",\"data\":");
+    return *this;
+  }
+
+  size_t write(uint8_t c) override { return write(&c, 1); }
+  size_t write(const uint8_t* data, size_t size) override {
+    for (size_t left = size; left > 0;) {
+      if (m_len == kChunk) flush();
+      size_t n = kChunk - m_len < left ? kChunk - m_len : left;
+      memcpy(m_buf + m_len, data, n);
+      m_len += n;
+      data += n;
+      left -= n;
+    }
+    return size;
+  }
+  using Print::write;
+
+  void flush() override {
+    if (m_len == 0) return;
+    m_out.write(reinterpret_cast<const uint8_t*>(m_buf), m_len);
+    m_len = 0;
+  }
+
+ private:
+  Print& m_out;
+  char m_buf[kChunk];
+  size_t m_len = 0;
+};
+
+}  // namespace ConsoleEngine
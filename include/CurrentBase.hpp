@@ -0,0 +1,41 @@
+/**
+ * @file CurrentBase.hpp
+ * @brief Hot slot holding the metadata of the currently docked base.
+ *
+ * When a tag is detected its record is prefetched into the slot, so
+ * GET /api/current, the serial `base.current` command and the UI's "current"
+ * event are served from RAM without touching storage.
+ */
+#pragma once
+
+#include <Arduino.h>
+#include "JsonWriter.hpp"
+#include "Storage.hpp"
+
+namespace CurrentBase {
+
+struct Slot {
+  TagId rfid = 0;
+  // True once a stored record for `rfid` has been loaded.
+  bool known = false;
+  Storage::BaseInfo info;
+};
+
+// Prefetches the record for a newly detected tag (0 clears the slot). Reads
+// storage, so call it from the web task rather than the RFID or request path.
+void load(TagId rfid);
+
+// Keep the slot in step with writes to the docked base. Writes to any other
+// tag are ignored, checked under the slot's lock.
+void onSaved(TagId rfid, const Storage::BaseInfo& info);
+void onDeleted(TagId rfid);
+// True, once, after onSaved() or onDeleted() changed the slot. The web task
+// then reapplies the motion profile from get(), so it is only ever applied
+// by the task that also handles docking.
+bool takeChanged();
+
+Slot get();
+// Writes the slot's members into the open object.
+void toJson(const Slot& slot, JsonWriter& out);
+
+}  // namespace CurrentBase
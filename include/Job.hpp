@@ -0,0 +1,62 @@
+/**
+ * @file Job.hpp
+ * @brief Runs a recipe's withdraw, dwell and dispense steps on the device.
+ *
+ * A job starts automatically when a docked base's `recipe_id` names a stored
+ * recipe, or on request over serial or HTTP. It is advanced by tick() from
+ * the motion task, one non-blocking check per call; other tasks only post
+ * requests and read progress snapshots.
+ *
+ * A job needs a docked base, and undocking the base aborts its job. A move cut short by the jog buttons
+ * pauses the job, and resuming finishes the remaining steps of that move.
+ */
+#pragma once
+
+#include <Arduino.h>
+#include "JsonWriter.hpp"
+#include "Recipes.hpp"
+#include "TagId.hpp"
+
+class StepperControl;
+
+namespace Job {
+
+enum class State : uint8_t { Idle, Running, Paused, Done, Aborted };
+
+enum class Result : uint8_t { Ok, NoBase, UnknownRecipe, NotCalibrated, Busy, NotRunning, NotPaused };
+
+struct Progress {
+  State state = State::Idle;
+  char recipeId[24] = {};
+  TagId rfid = 0;
+  uint8_t step = 0;
+  uint8_t stepCount = 0;
+  Recipes::Action action = Recipes::Action::Dwell;
+  uint32_t elapsedMs = 0;
+  // Why the job paused or aborted; empty otherwise.
+  const char* reason = "";
+  // Bumped on every change, so pollers can tell when to republish.
+  uint32_t generation = 0;
+};
+
+void begin(StepperControl& stepper);
+
+Result start(const char* recipeId, TagId rfid);
+Result pause();
+Result resume();
+Result abort();
+
+// Called by the web task once the docked tag's record has been prefetched.
+void onDocked(TagId rfid, const char* recipeId);
+
+// Advances the running job; call from the motion task.
+void tick();
+
+Progress progress();
+
+const char* stateName(State state);
+const char* describe(Result result);
+// Writes the progress members into the open object.
+void toJson(const Progress& progress, JsonWriter& out);
+
+}  // namespace Job
@@ -0,0 +1,129 @@
+/**
+ * @file JsonWriter.hpp
+ * @brief Writes JSON straight to a Print as it is produced, with no document
+ *        or heap in between.
+ */
+#pragma once
+
+#include <Arduino.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <type_traits>
+
+// Commas between members and elements are inserted automatically. Nesting is
+// tracked with one bit per level, so up to 32 levels need no extra storage.
+class JsonWriter {
+ public:
+  explicit JsonWriter(Print& out) : m_out(out) {}
+
+  void beginObject() { open('{'); }
+  void endObject() { close('}'); }
+  void beginArray() { open('['); }
+  void endArray() { close(']'); }
+
+  // Starts a member of the open object; follow it with one value or begin*().
+  JsonWriter& key(const char* name) {
+    separate();
+    quote(m_out, name);
+    m_out.print(':');
+    m_afterKey = true;
+    return *this;
+  }
+
+  void value(const char* s) {
+    separate();
+    if (s) {
+      quote(m_out, s);
+    } else {
+      m_out.print("null");
+    }
+  }
+  void value(bool b) {
+    separate();
+    m_out.print(b ? "true" : "false");
+  }
+  // NaN and infinities have no JSON form and are written as null.
+  void value(double v) {
+    separate();
+    char buf[24];
+    if (isfinite(v)) {
+      snprintf(buf, sizeof(buf), "%.7g", v);
+    } else {
+      strlcpy(buf, "null", sizeof(buf));
+    }
+    m_out.print(buf);
+  }
+  template <typename T, typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value,
+                                                int>::type = 0>
+  void value(T v) {
+    separate();
+    char buf[12];
+    if (std::is_signed<T>::value) {
+      snprintf(buf, sizeof(buf), "%ld", static_cast<long>(v));
+    } else {
+      snprintf(buf, sizeof(buf), "%lu", static_cast<unsigned long>(v));
+    }
+    m_out.print(buf);
+  }
+  void null() {
+    separate();
+    m_out.print("null");
+  }
+
+  template <typename T>
+  void member(const char* name, T v) {
+    key(name).value(v);
+  }
+
+  // Writes `s` as a quoted JSON string, escaping quotes, backslashes and
+  // control characters.
+  static void quote(Print& out, const char* s) {
+    out.print('"');
+    const char* run = s;
+    for (; *s; ++s) {
+      unsigned char c = static_cast<unsigned char>(*s);
+      if (c >= 0x20 && c != '"' && c != '\\') continue;
+      out.write(run, s - run);
+      char esc[7];
+      if (c == '"' || c == '\\') {
+        esc[0] = '\\';
+        esc[1] = static_cast<char>(c);
+        esc[2] = '\0';
+      } else {
+        snprintf(esc, sizeof(esc), "\\u%04x", c);
+      }
+      out.print(esc);
+      run = s + 1;
+    }
+    out.write(run, s - run);
+    out.print('"');
+  }
+
+ private:
+  void separate() {
+    if (m_afterKey) {
+      m_afterKey = false;
+      return;
+    }
+    uint32_t bit = 1UL << (m_depth & 31);
+    if (m_started & bit) m_out.print(',');
+    m_started |= bit;
+  }
+  void open(char c) {
+    separate();
+    m_out.print(c);
+    ++m_depth;
+    m_started &= ~(1UL << (m_depth & 31));
+  }
+  void close(char c) {
+    m_out.print(c);
+    --m_depth;
+  }
+
+  Print& m_out;
+  uint32_t m_started = 0;
+  uint8_t m_depth = 0;
+  bool m_afterKey = false;
+};
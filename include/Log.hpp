@@ -0,0 +1,34 @@
+/**
+ * @file Log.hpp
+ * @brief Diagnostic log lines from any task, written out by the console.
+ *
+ * Serial belongs to the console task: in binary mode a byte from another task
+ * would land inside a frame the console is streaming. Modules therefore log
+ * through Log::printf(), which queues the line; the console writes queued
+ * lines between replies, as text or as LogLine frames (see SerialFrames.hpp).
+ * Until the console attaches, during early boot, lines go straight to Serial.
+ * Lines that find the queue full are counted and dropped.
+ */
+#pragma once
+
+#include <Arduino.h>
+
+#ifndef LOG_QUEUE_LINES
+#define LOG_QUEUE_LINES 16
+#endif
+
+namespace Log {
+
+// Longer lines are truncated.
+constexpr size_t kMaxLine = 120;
+
+// One line; a trailing newline is optional.
+void printf(const char* format, ...) __attribute__((format(printf, 1, 2)));
+
+// For the console: from now on lines are queued for it.
+void attach();
+// Takes the oldest queued line; false when there is none.
+bool pop(char (&line)[kMaxLine + 1]);
+uint32_t dropped();
+
+}  // namespace Log
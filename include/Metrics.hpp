@@ -0,0 +1,67 @@
+/**
+ * @file Metrics.hpp
+ * @brief Per-phase latency histograms, task loop periods and step-deadline
+ *        counters, reported over /api/metrics and the serial `metrics` command.
+ *
+ * Task periods and step latency each have a single writer (their task or the
+ * step ISR). Phases can be timed from several tasks, e.g. Flash from the web
+ * task's commits and from saves on the AsyncTCP task, so phase samples are
+ * recorded under a critical section. Readers get a best-effort snapshot,
+ * which is fine for diagnostics.
+ */
+#pragma once
+
+#include <Arduino.h>
+
+#include "JsonWriter.hpp"
+
+namespace Metrics {
+
+enum class Phase : uint8_t { Console, Rfid, Buttons, Web, Flash, Count };
+enum class Task : uint8_t { Motion, Rfid, Web, Console, Count };
+
+// Log2 buckets: bucket i counts samples in [2^(i-1), 2^i) microseconds, the
+// last bucket everything above.
+class Histogram {
+ public:
+  static constexpr size_t kBuckets = 20;
+
+  void IRAM_ATTR record(uint32_t us);
+  void reset();
+  uint32_t count() const { return m_count; }
+  uint32_t maxUs() const { return m_max; }
+  uint32_t meanUs() const { return m_count ? static_cast<uint32_t>(m_sum / m_count) : 0; }
+  uint32_t percentileUs(uint8_t pct) const;
+  // Writes count, mean, p99 and max into the open object.
+  void toJson(JsonWriter& out) const;
+
+ private:
+  uint32_t m_buckets[kBuckets] = {};
+  uint32_t m_count = 0;
+  uint32_t m_max = 0;
+  uint64_t m_sum = 0;
+};
+
+void begin();
+void reset();
+
+void recordPhase(Phase phase, uint32_t cycles);
+void markPeriod(Task task);
+void IRAM_ATTR recordStepLatency(uint32_t us);
+uint32_t missedStepDeadlines();
+
+// Writes the window, phase, period and step members into the open object.
+void toJson(JsonWriter& out);
+
+// Times the enclosing scope with the CPU cycle counter.
+class PhaseTimer {
+ public:
+  explicit PhaseTimer(Phase phase) : m_phase(phase), m_start(ESP.getCycleCount()) {}
+  ~PhaseTimer() { recordPhase(m_phase, ESP.getCycleCount() - m_start); }
+
+ private:
+  Phase m_phase;
+  uint32_t m_start;
+};
+
+}  // namespace Metrics
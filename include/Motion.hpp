@@ -0,0 +1,65 @@
+/**
+ * @file Motion.hpp
+ * @brief Volumetric move commands on top of StepperControl's move queue,
+ *        shared by the serial console and the HTTP API.
+ *
+ * Volumes are converted to steps with a steps-per-microliter calibration
+ * stored on LittleFS. Until one is set, volumetric moves are refused; raw
+ * step moves always work. Positions are in steps from boot or from the last
+ * `zero`; positive is towards withdraw.
+ *
+ * The global speed and acceleration (motion.profile) apply unless the docked
+ * base has a motion profile of its own, whose non-zero fields then override
+ * them: thin paint can run faster than the global maximum, thick paint slower.
+ */
+#pragma once
+
+#include <Arduino.h>
+#include "JsonWriter.hpp"
+#include "Storage.hpp"
+
+class StepperControl;
+
+namespace Motion {
+
+enum class Result : uint8_t { Ok, QueueFull, NotCalibrated, BadArgument, Busy };
+
+const char* describe(Result result);
+
+// Raw step moves work from here on; volumetric ones once loadCalibration()
+// has found a calibration.
+void begin(StepperControl& stepper);
+// Call after Storage::init() has mounted LittleFS.
+void loadCalibration();
+
+// Converts a volume to a whole, positive number of steps.
+Result toSteps(float microliters, int32_t& steps);
+
+Result withdraw(float microliters);
+Result dispense(float microliters);
+Result move(int32_t steps);
+// Drops queued moves and brakes to a stop.
+void stop();
+// Makes the current position zero; refused while moving.
+Result zero();
+
+// Sets the global profile, in steps, and reapplies the docked base's. An
+// acceleration of 0 keeps the current one.
+void setProfile(uint32_t maxStepsPerSec, uint32_t accelStepsPerSec2);
+// Applies a docked base's profile, or only the global one for nullptr. Its
+// speeds and acceleration are in microliters, so they wait for a calibration.
+void useBaseProfile(const Storage::MotionProfile* profile);
+// Settle time after each job move, from the docked base's profile.
+uint32_t settleMs();
+
+float stepsPerMicroliter();
+// Validates and applies a new calibration; tick() persists it.
+Result setStepsPerMicroliter(float stepsPerUl);
+// Writes a changed calibration to flash; waits while `motionIdle` is false,
+// like Storage::tick().
+void tick(bool motionIdle);
+
+// Writes the status members into the open object.
+void toJson(JsonWriter& out);
+
+}  // namespace Motion
@@ -6,7 +6,8 @@
 
 namespace Pins {
 
-// Stepper driver (A4988)
+// Stepper driver (A4988). MS1-MS3 are set by board straps, not firmware;
+// STEPPER_MICROSTEPS must match them.
 constexpr int STEPPER_STEP = 21;
 constexpr int STEPPER_DIR  = 20;
 
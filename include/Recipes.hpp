@@ -0,0 +1,75 @@
+/**
+ * @file Recipes.hpp
+ * @brief Fill recipes: named sequences of withdraw, dwell and dispense steps,
+ *        kept in RAM and persisted to one LittleFS file.
+ *
+ * A recipe is looked up by the `recipe_id` stored in a base's metadata when
+ * the base is docked, so lookups never touch flash.
+ */
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+#include "JsonWriter.hpp"
+
+namespace Recipes {
+
+constexpr size_t kMaxRecipes = 16;
+constexpr size_t kMaxSteps = 16;
+
+// Bounds on a step, to catch typos before they reach the plunger: a ten
+// minute dwell, the contents of a 100 mL syringe, and the fastest rate a
+// base's motion profile accepts.
+constexpr float kMaxDwellMs = 600000.0f;
+constexpr float kMaxStepUl = 100000.0f;
+constexpr float kMaxRateUlPerSec = 10000.0f;
+
+enum class Action : uint8_t { Withdraw = 1, Dwell = 2, Dispense = 3 };
+
+struct Step {
+  Action action;
+  uint8_t reserved[3];
+  // Microliters for withdraw/dispense, milliseconds for dwell.
+  float amount;
+  // Plunger rate in microliters per second; 0 uses the motion profile's
+  // maximum speed. Ignored for dwell.
+  float rate;
+};
+
+struct Recipe {
+  char id[24];
+  uint8_t stepCount;
+  uint8_t reserved[3];
+  Step steps[kMaxSteps];
+
+  Recipe() : stepCount(0), reserved(), steps() { id[0] = '\0'; }
+};
+
+// Loads recipes; call after Storage::init() has mounted LittleFS.
+bool init();
+
+bool find(const char* id, Recipe& out);
+// Adds or replaces the recipe with the same id; fails for steps outside the
+// bounds above. Changes apply at once and are written by tick().
+bool put(const Recipe& recipe);
+bool erase(const char* id);
+// Writes changed recipes to flash; waits while `motionIdle` is false, like
+// Storage::tick().
+void tick(bool motionIdle);
+size_t count();
+// Copies up to `max` recipe ids (sorted) into `out`.
+size_t listIds(char (*out)[24], size_t max);
+
+const char* actionName(Action action);
+bool parseAction(const char* name, Action& out);
+
+// {"id":...,"steps":[{"action":"withdraw","ul":..,"rate_ul_s":..},
+//                    {"action":"dwell","ms":..}, ...]}
+// Writes the recipe's members into the open object.
+void toJson(const Recipe& recipe, JsonWriter& out);
+// Parses the same shape (the id comes from the caller). Returns nullptr on
+// success or a short reason.
+const char* fromJson(JsonObjectConst in, Recipe& out);
+
+}  // namespace Recipes
@@ -1,18 +1,43 @@
 /**
  * @file RfidReader.hpp
  * @brief PN532 RFID reader helper.
+ *
+ * Polling is split-phase: poll() issues InListPassiveTarget and returns, and a
+ * later poll() collects the UID once the PN532 pulls its IRQ line low. No call
+ * waits for the RF field. A few empty or failed polls in a row clear the
+ * current tag, so removing a base reads as tag 0.
+ *
+ * Tags are keyed by their full UID (see TagId.hpp). The key is 64 bits, which
+ * RV32 cannot load in one instruction, so other tasks read it under a lock.
  */
 #pragma once
 
 #include <Arduino.h>
 
+#include "TagId.hpp"
+
 class RfidReader {
  public:
   bool begin();
   void poll();
-  uint32_t currentTag() const { return m_currentTag; }
-  bool hasTag() const { return m_currentTag != 0; }
+  TagId currentTag() const;
+  bool hasTag() const { return currentTag() != 0; }
+
+  uint32_t lastPollUs() const { return m_lastPollUs; }
+  uint32_t maxPollUs() const { return m_maxPollUs; }
+  void resetPollStats() { m_maxPollUs = 0; }
 
  private:
-  uint32_t m_currentTag = 0;
+  enum class State : uint8_t { Offline, Idle, Waiting };
+
+  void step(uint32_t nowMs);
+  void missedPoll();
+
+  State m_state = State::Offline;
+  TagId m_currentTag = 0;
+  uint8_t m_misses = 0;
+  mutable portMUX_TYPE m_mux = portMUX_INITIALIZER_UNLOCKED;
+  uint32_t m_stateSinceMs = 0;
+  uint32_t m_lastPollUs = 0;
+  uint32_t m_maxPollUs = 0;
 };
@@ -0,0 +1,194 @@
+/**
+ * @file SerialFrames.hpp
+ * @brief Binary serial framing: COBS-encoded frames with a sequence number
+ *        and CRC32, used by the console's binary mode.
+ *
+ * Frame before encoding: [type u8][seq u8][payload ...][crc32 LE], where the
+ * CRC covers type, seq and payload. Every frame on the wire is written as
+ * 0x00, COBS bytes, 0x00, so a receiver resynchronises on the next delimiter
+ * after line noise, and empty frames are ignored. Firmware log lines are sent
+ * as LogLine frames in this mode (see Log.hpp).
+ * Multi-byte payload fields are little-endian.
+ */
+#pragma once
+
+#include <Arduino.h>
+#include <string.h>
+
+#include "Checksum.hpp"
+#include "Cobs.hpp"
+
+namespace SerialFrames {
+
+enum Type : uint8_t {
+  // Host -> device.
+  Command = 0x01,  // payload: one console command line, no newline
+  Ping = 0x02,     // payload: empty
+
+  // Device -> host. Replies echo the request's sequence number.
+  CommandReply = 0x81,  // payload: the JSON reply line
+  Pong = 0x82,          // payload: u32 millis
+  Telemetry = 0x90,     // payload: TelemetryFrame; device-side sequence
+  LogLine = 0x91,       // payload: one log line, no newline; device-side sequence
+  Error = 0xEE,         // payload: u8 ErrorCode, u8 offending type
+};
+
+enum ErrorCode : uint8_t {
+  BadCrc = 1,
+  TooLong = 2,
+  UnknownType = 3,
+  BadFrame = 4,
+};
+
+// Telemetry flags.
+constexpr uint8_t kFlagMoving = 0x01;
+constexpr uint8_t kFlagWithdrawing = 0x02;
+constexpr uint8_t kFlagTag = 0x04;
+
+// Telemetry payload, written field by field in this order (27 bytes).
+struct TelemetryFrame {
+  uint32_t millis;
+  int32_t positionSteps;
+  uint32_t stepsRemaining;
+  uint16_t intervalUs;
+  uint8_t flags;
+  uint64_t rfid;
+  uint32_t missedDeadlines;
+};
+
+constexpr size_t kHeaderBytes = 2;
+constexpr size_t kCrcBytes = 4;
+
+// A decoded, CRC-checked frame. Points into the reader's buffer.
+struct Frame {
+  uint8_t type;
+  uint8_t seq;
+  const uint8_t* payload;
+  size_t len;
+};
+
+// Collects bytes up to each 0x00 delimiter and decodes them in place into
+// frames whose payload is at most N bytes.
+template <size_t N>
+class FrameReader {
+ public:
+  enum class Result : uint8_t { None, Ok, Error };
+
+  // Feeds one byte. On Ok, `frame` is valid until the next push(); on Error,
+  // `error` says why and `frame.type`/`frame.seq` hold what could be read.
+  Result push(uint8_t b, Frame& frame, ErrorCode& error) {
+    if (b != 0) {
+      if (m_len < sizeof(m_buf)) {
+        m_buf[m_len++] = b;
+      } else {
+        m_overflow = true;
+      }
+      return Result::None;
+    }
+    size_t raw = m_len;
+    bool overflow = m_overflow;
+    m_len = 0;
+    m_overflow = false;
+    if (raw == 0) return Result::None;
+
+    frame = Frame{0, 0, nullptr, 0};
+    if (overflow) {
+      error = TooLong;
+      return Result::Error;
+    }
+    size_t len = Cobs::decode(m_buf, raw, m_buf, sizeof(m_buf));
+    if (len >= kHeaderBytes) {
+      frame.type = m_buf[0];
+      frame.seq = m_buf[1];
+    }
+    if (len < kHeaderBytes + kCrcBytes) {
+      error = BadFrame;
+      return Result::Error;
+    }
+    size_t body = len - kCrcBytes;
+    uint32_t expected = static_cast<uint32_t>(m_buf[body]) | (static_cast<uint32_t>(m_buf[body + 1]) << 8) |
+                        (static_cast<uint32_t>(m_buf[body + 2]) << 16) |
+                        (static_cast<uint32_t>(m_buf[body + 3]) << 24);
+    if (Checksum::crc32(m_buf, body) != expected) {
+      error = BadCrc;
+      return Result::Error;
+    }
+    frame.payload = m_buf + kHeaderBytes;
+    frame.len = body - kHeaderBytes;
+    return Result::Ok;
+  }
+
+ private:
+  uint8_t m_buf[Cobs::maxEncodedSize(N + kHeaderBytes + kCrcBytes)];
+  size_t m_len = 0;
+  bool m_overflow = false;
+};
+
+// Writes one frame to `out` as the payload is produced: nothing is buffered
+// beyond one COBS block, so payloads of any length need no heap.
+class FrameWriter : public Print {
+ public:
+  FrameWriter(Print& out, uint8_t type, uint8_t seq) : m_out(out), m_cobs(out) {
+    m_out.write(static_cast<uint8_t>(0));
+    put(type);
+    put(seq);
+  }
+  ~FrameWriter() { finish(); }
+
+  size_t write(uint8_t c) override {
+    put(c);
+    return 1;
+  }
+  size_t write(const uint8_t* data, size_t size) override {
+    for (size_t i = 0; i < size; ++i) put(data[i]);
+    return size;
+  }
+  using Print::write;
+
+  void u8(uint8_t v) { put(v); }
+  void u16(uint16_t v) {
+    put(static_cast<uint8_t>(v));
+    put(static_cast<uint8_t>(v >> 8));
+  }
+  void u32(uint32_t v) {
+    u16(static_cast<uint16_t>(v));
+    u16(static_cast<uint16_t>(v >> 16));
+  }
+  void u64(uint64_t v) {
+    u32(static_cast<uint32_t>(v));
+    u32(static_cast<uint32_t>(v >> 32));
+  }
+
+  // Appends the CRC and the closing delimiter. Called by the destructor if
+  // not called explicitly.
+  void finish() {
+    if (m_done) return;
+    m_done = true;
+    uint32_t crc = m_crc;
+    for (int i = 0; i < 4; ++i) m_cobs.put(static_cast<uint8_t>(crc >> (8 * i)));
+    m_cobs.finish();
+  }
+
+ private:
+  void put(uint8_t b) {
+    m_crc = Checksum::crc32(&b, 1, m_crc);
+    m_cobs.put(b);
+  }
+
+  Print& m_out;
+  Cobs::Encoder m_cobs;
+  uint32_t m_crc = 0;
+  bool m_done = false;
+};
+
+inline void writeTelemetry(FrameWriter& w, const TelemetryFrame& t) {
+  w.u32(t.millis);
+  w.u32(static_cast<uint32_t>(t.positionSteps));
+  w.u32(t.stepsRemaining);
+  w.u16(t.intervalUs);
+  w.u8(t.flags);
+  w.u64(t.rfid);
+  w.u32(t.missedDeadlines);
+}
+
+}  // namespace SerialFrames
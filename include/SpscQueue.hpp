@@ -0,0 +1,50 @@
+/**
+ * @file SpscQueue.hpp
+ * @brief Lock-free single-producer/single-consumer ring buffer for passing
+ *        messages between tasks (or from an ISR to a task).
+ */
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+template <typename T, size_t N>
+class SpscQueue {
+  static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscQueue capacity must be a power of two");
+
+ public:
+  // Producer side. Returns false when the queue is full.
+  bool push(const T& item) {
+    size_t head = m_head.load(std::memory_order_relaxed);
+    size_t tail = m_tail.load(std::memory_order_acquire);
+    if (head - tail == N) return false;
+    m_items[head & (N - 1)] = item;
+    m_head.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer side. Returns false when the queue is empty.
+  bool pop(T& out) {
+    size_t tail = m_tail.load(std::memory_order_relaxed);
+    size_t head = m_head.load(std::memory_order_acquire);
+    if (head == tail) return false;
+    out = m_items[tail & (N - 1)];
+    m_tail.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool empty() const {
+    return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_acquire);
+  }
+
+  size_t size() const {
+    return m_head.load(std::memory_order_acquire) - m_tail.load(std::memory_order_acquire);
+  }
+
+  static constexpr size_t capacity() { return N; }
+
+ private:
+  T m_items[N] = {};
+  std::atomic<size_t> m_head{0};
+  std::atomic<size_t> m_tail{0};
+};
@@ -0,0 +1,52 @@
+/**
+ * @file StepPulse.hpp
+ * @brief STEP pin output for StepperControl: RMT pulse trains, or a portable
+ *        digitalWrite fallback.
+ *
+ * With the RMT backend the peripheral times every pulse. The step ISR queues
+ * a train of up to kMaxTrain steps, each a pulse plus the gap to the next,
+ * starts it, and is not called again until the train has played out. That is
+ * one interrupt per train instead of two per step, which is what makes 1/16
+ * microstepping at full plunger speed affordable.
+ *
+ * The fallback raises and lowers the pin from the step ISR, two alarms per
+ * step, and caps the step rate accordingly. Build with -DSTEPPER_PULSE_RMT=0
+ * to select it.
+ */
+#pragma once
+
+#include <Arduino.h>
+
+#ifndef STEPPER_PULSE_RMT
+#define STEPPER_PULSE_RMT 1
+#endif
+
+namespace StepPulse {
+
+#if STEPPER_PULSE_RMT
+// One RMT memory block (48 words on the C3), less the end marker.
+constexpr size_t kMaxTrain = 47;
+// Pulse plus the A4988's 1 us minimum low time, with margin.
+constexpr uint32_t kMinIntervalUs = 5;
+#else
+constexpr size_t kMaxTrain = 1;
+// Two timer interrupts per step.
+constexpr uint32_t kMinIntervalUs = 50;
+#endif
+
+bool begin(int pin, uint32_t pulseUs);
+const char* name();
+
+#if STEPPER_PULSE_RMT
+// Appends a step followed by `intervalUs` until the next one.
+void IRAM_ATTR add(uint32_t intervalUs);
+// Plays the steps added since the last start(). The line idles low after the
+// last pulse rather than waiting out its interval.
+void IRAM_ATTR start();
+// True while the previous train is still playing.
+bool IRAM_ATTR busy();
+#else
+void IRAM_ATTR write(bool high);
+#endif
+
+}  // namespace StepPulse
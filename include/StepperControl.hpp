@@ -0,0 +1,139 @@
+/**
+ * @file StepperControl.hpp
+ * @brief Hardware-timer step generation for the A4988 plunger driver.
+ *
+ * Step pulses are emitted from a timer ISR, so step timing does not depend on
+ * how long loop() takes. The caller only sets direction, speed and enable.
+ *
+ * Relative moves can be queued: the ISR starts the next one as soon as the
+ * previous move has come to rest, so a host can pipeline doses without
+ * waiting for each to finish. Manual jogging (setMoving) takes precedence;
+ * queued moves wait until it stops.
+ *
+ * Moves follow a trapezoidal velocity profile. The acceleration ramp is
+ * precomputed into an interval table whenever the profile changes; the ISR
+ * only walks up and down that table, with no division or sqrt per step.
+ *
+ * Pulses go out through StepPulse. With the RMT backend each alarm hands the
+ * peripheral a train of steps covering up to STEPPER_TRAIN_US, so setDirection,
+ * stops and new moves take effect at the next train, and position() may lead
+ * the shaft by up to one train.
+ */
+#pragma once
+
+#include <Arduino.h>
+
+// Must match the A4988's MS1-MS3 straps. Speeds, accelerations and positions
+// are all in microsteps; the default profile scales with this. Unstrapped
+// boards run at full steps through the driver's pull-downs; boards strapped
+// for 1/16 build with -DSTEPPER_MICROSTEPS=16.
+#ifndef STEPPER_MICROSTEPS
+#define STEPPER_MICROSTEPS 1
+#endif
+
+// Ramp table length. Reaching v steps/s at acceleration a takes v^2 / 2a
+// steps; the top speed is capped where the table ends. Two tables of this
+// many uint16_t are kept; the default profile needs 7500 steps at 1/16, so
+// that costs 32 KB instead of 16 KB.
+#ifndef STEPPER_RAMP_STEPS
+#define STEPPER_RAMP_STEPS (STEPPER_MICROSTEPS > 8 ? 8192 : 4096)
+#endif
+
+class StepperControl {
+ public:
+  static constexpr uint32_t kUnlimitedSteps = UINT32_MAX;
+  static constexpr uint16_t kMicrosteps = STEPPER_MICROSTEPS;
+  // Firmware from before STEPPER_MICROSTEPS left MS1-MS3 to the A4988's
+  // pull-downs, i.e. full steps. Its profile and saved calibrations are in
+  // these steps.
+  static constexpr uint16_t kLegacyMicrosteps = 1;
+  static constexpr size_t kMaxRampSteps = STEPPER_RAMP_STEPS;
+  static constexpr size_t kMoveQueueLength = 16;
+
+  bool begin();
+
+  // Rebuilds the ramp table. Safe to call while moving; the ISR picks up the
+  // new table at the closest matching speed.
+  void setProfile(uint32_t maxStepsPerSec, uint32_t accelStepsPerSec2);
+  uint32_t maxSpeed() const { return m_maxStepsPerSec; }
+  uint32_t acceleration() const { return m_accelStepsPerSec2; }
+  size_t rampLength() const { return m_rampLen; }
+
+  // Per-direction speed caps below maxSpeed(), applied on top of setSpeed();
+  // 0 lifts a cap.
+  void setDirectionLimits(uint32_t withdrawStepsPerSec, uint32_t dispenseStepsPerSec);
+  // The cap in force for a direction, in steps/s; 0 when there is none.
+  uint32_t speedLimit(bool withdraw) const {
+    uint32_t interval = m_limitIntervalUs[withdraw ? 1 : 0];
+    return interval ? 1000000UL / interval : 0;
+  }
+
+  void setDirection(bool withdraw);
+  void setSpeed(uint32_t stepsPerSec);
+  void setMoving(bool moving);
+  void moveSteps(uint32_t steps);
+  void halt();
+
+  // Appends a relative move: positive steps withdraw, negative dispense.
+  // Returns false when the queue is full or steps is zero.
+  bool queueMove(int32_t steps);
+  // Drops queued moves and brakes the one in progress to a stop.
+  void cancelMoves();
+
+  // For GPIO interrupt handlers: drop queued moves and start a jog of
+  // `steps` (kUnlimitedSteps to run until stopped), or brake to a stop. They
+  // take effect at the next step alarm, without waiting for a task.
+  void IRAM_ATTR jogFromIsr(bool withdraw, uint32_t steps);
+  void IRAM_ATTR stopFromIsr();
+  size_t queuedMoves() const;
+
+  bool isMoving() const { return m_active || (m_run && m_budget != 0); }
+  bool isWithdrawing() const { return m_withdraw; }
+  uint32_t stepsRemaining() const { return isMoving() ? m_budget : 0; }
+  uint32_t currentIntervalUs() const { return m_active ? m_nextIntervalUs : 0; }
+  // Steps taken since boot, counted by the ISR: withdrawing adds, dispensing
+  // subtracts.
+  int32_t position() const { return m_position; }
+  // Redefines the current position; only while stopped.
+  bool setPosition(int32_t steps);
+
+ private:
+  static void IRAM_ATTR onTimer();
+  void IRAM_ATTR service();
+  void IRAM_ATTR scheduleNext(uint32_t us);
+  uint32_t IRAM_ATTR nextInterval(bool cruise);
+  bool IRAM_ATTR startQueuedMove();
+  uint32_t IRAM_ATTR emitSteps(bool cruise);
+
+  hw_timer_t* m_timer = nullptr;
+  mutable portMUX_TYPE m_mux = portMUX_INITIALIZER_UNLOCKED;
+
+  // Two ramp tables so a profile change can be built while the ISR is
+  // still reading the active one.
+  uint16_t m_rampTables[2][kMaxRampSteps] = {};
+  const uint16_t* m_ramp = m_rampTables[0];
+  volatile size_t m_rampLen = 0;
+  uint32_t m_maxStepsPerSec = 0;
+  uint32_t m_accelStepsPerSec2 = 0;
+
+  // Written by the caller, consumed by the ISR.
+  volatile bool m_run = false;
+  volatile bool m_withdraw = false;
+  volatile uint32_t m_targetIntervalUs = 0;
+  // Indexed by withdraw (1) or dispense (0); 0 is no cap.
+  volatile uint32_t m_limitIntervalUs[2] = {};
+  volatile uint32_t m_budget = 0;
+
+  // Queued moves, guarded by m_mux; the ISR consumes at m_moveTail.
+  int32_t m_moves[kMoveQueueLength] = {};
+  size_t m_moveHead = 0;
+  size_t m_moveTail = 0;
+
+  // Owned by the ISR.
+  volatile bool m_active = false;
+  volatile uint32_t m_nextIntervalUs = 0;
+  volatile int32_t m_position = 0;
+  size_t m_rampIndex = 0;
+  bool m_pulseHigh = false;
+  bool m_dirApplied = false;
+};
@@ -1,18 +1,53 @@
 /**
  * @file Storage.hpp
- * @brief LittleFS persistence for base syringe metadata.
+ * @brief LittleFS persistence for base syringe metadata, with an in-RAM
+ *        LRU read cache (size set by STORAGE_CACHE_BYTES).
+ *
+ * Records live in one packed, CRC-checked log file (see BaseStore.hpp).
+ * Per-tag JSON files from older firmware are imported on first boot.
+ *
+ * Saves and deletes are held in RAM and committed together once no edit has
+ * arrived for STORAGE_COALESCE_MS (or the oldest has waited
+ * STORAGE_MAX_DELAY_MS), so a burst of saves from the UI costs one append
+ * instead of one per save. Commits wait for the plunger to stop, since flash
+ * writes hold off the step ISR. Until then, reads, counts and listings
+ * already reflect the held edits.
  */
 #pragma once
 
 #include <Arduino.h>
 
+#include "TagId.hpp"
+
+// Quiet time after the last edit before pending edits are committed.
+#ifndef STORAGE_COALESCE_MS
+#define STORAGE_COALESCE_MS 750
+#endif
+
+// Longest an edit waits while edits keep arriving.
+#ifndef STORAGE_MAX_DELAY_MS
+#define STORAGE_MAX_DELAY_MS 3000
+#endif
+
 namespace Storage {
 
+// How the plunger moves while this base is docked. Zero fields fall back to
+// the global motion profile (see Motion.hpp).
+struct MotionProfile {
+  float withdrawUlPerSec = 0.0f;
+  float dispenseUlPerSec = 0.0f;
+  float accelUlPerSec2 = 0.0f;
+  // Settle time after each move of a job, for paint that keeps flowing once
+  // the plunger stops.
+  uint32_t dwellMs = 0;
+};
+
 struct BaseInfo {
   char paintName[32];
   char recipeName[32];
   char recipeId[24];
   char notes[96];
+  MotionProfile motion;
 
   BaseInfo() {
     paintName[0] = '\0';
@@ -22,10 +57,72 @@ struct BaseInfo {
   }
 };
 
+struct CacheStats {
+  uint32_t hits = 0;
+  uint32_t misses = 0;
+  uint32_t evictions = 0;
+  size_t entries = 0;
+  size_t capacity = 0;
+  size_t bytes = 0;
+  // Every live record is cached, so no read goes to flash.
+  bool complete = false;
+};
+
+struct StoreStats {
+  size_t live = 0;
+  size_t dead = 0;
+  size_t fileBytes = 0;
+  uint32_t compactions = 0;
+  size_t corrupt = 0;
+  size_t indexSlots = 0;
+  size_t maxProbe = 0;
+};
+
+struct WriteStats {
+  uint32_t saves = 0;
+  // Saves that replaced a pending edit, or matched the stored record, and so
+  // cost no flash write of their own.
+  uint32_t coalesced = 0;
+  uint32_t unchanged = 0;
+  uint32_t commits = 0;
+  uint32_t recordsWritten = 0;
+  // Log bytes written, compaction included, per byte of metadata saved.
+  float writeAmplification = 0.0f;
+  size_t pending = 0;
+};
+
 bool init();
-bool loadBase(uint32_t rfid, BaseInfo& out);
-bool saveBase(uint32_t rfid, const BaseInfo& info);
-bool deleteBase(uint32_t rfid);
-bool listBaseIds(uint32_t* out, size_t max, size_t& count);
+// A miss for a 7-byte tag falls back to the record older firmware stored
+// under its last four UID bytes, and queues moving that record to the full
+// key. Never writes flash itself.
+bool loadBase(TagId rfid, BaseInfo& out);
+// Visible to loadBase() and listings immediately; see the file comment for
+// when it reaches flash. Both fail while every pending slot holds an edit to
+// another tag, until the next commit frees them.
+bool saveBase(TagId rfid, const BaseInfo& info);
+bool deleteBase(TagId rfid);
+// Sorted RFIDs greater than `after`, at most `max` of them. Pass the last
+// RFID of one page as `after` to fetch the next.
+bool listBaseIds(TagId* out, size_t max, size_t& count, TagId after = 0);
+size_t baseCount();
+
+// Returns false to stop the walk; that record does not count as visited.
+using BaseVisitor = bool (*)(TagId rfid, const BaseInfo& info, void* ctx);
+// Calls `visit` for up to `max` records with RFID greater than `after`, in
+// RFID order, and returns how many were visited. Records not in the cache
+// are read through a single file handle.
+size_t visitBases(TagId after, size_t max, BaseVisitor visit, void* ctx);
+CacheStats cacheStats();
+StoreStats storeStats();
+// Flash write latency is reported by Metrics as the "flash" phase.
+WriteStats writeStats();
+
+// Commits pending edits whose window has passed, and compacts the log when
+// it is due; call periodically from a low-priority task. Flash writes hold
+// off the step ISR, so both wait while `motionIdle` is false, even past
+// STORAGE_MAX_DELAY_MS.
+void tick(bool motionIdle);
+// Commits all pending edits now, whether or not the plunger moves.
+bool flush();
 
 }  // namespace Storage
@@ -0,0 +1,65 @@
+/**
+ * @file TagId.hpp
+ * @brief 64-bit tag keys built from the full RFID UID.
+ *
+ * The key is the UID read big-endian: a 4-byte UID keeps the value older
+ * firmware stored for it, and 7-byte UIDs (NTAG, Ultralight, DESFire) fill
+ * 56 bits instead of being cut to their last four bytes. ISO 14443 7-byte
+ * UIDs start with a non-zero manufacturer byte, so the two never overlap.
+ * 0 means "no tag".
+ *
+ * Keys print as 8 hex digits when they fit in 32 bits and as 14 otherwise,
+ * matching the UID length.
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+using TagId = uint64_t;
+
+namespace Tags {
+
+// Longest formatted key plus the terminator.
+constexpr size_t kHexSize = 17;
+
+// 10-byte UIDs do not fit; they keep their last eight bytes.
+inline TagId fromUid(const uint8_t* uid, uint8_t len) {
+  uint8_t start = len > 8 ? len - 8 : 0;
+  TagId id = 0;
+  for (uint8_t i = start; i < len; ++i) id = (id << 8) | uid[i];
+  return id;
+}
+
+// The 32-bit key older firmware derived from the same UID.
+inline uint32_t legacyKey(TagId id) { return static_cast<uint32_t>(id); }
+
+inline bool isLegacyWidth(TagId id) { return id <= UINT32_MAX; }
+
+inline void format(TagId id, char* buf, size_t len) {
+  if (isLegacyWidth(id)) {
+    snprintf(buf, len, "%08lX", static_cast<unsigned long>(id));
+  } else {
+    snprintf(buf, len, "%014llX", static_cast<unsigned long long>(id));
+  }
+}
+
+// Accepts 1-16 hex digits; rejects 0 and trailing garbage.
+inline bool parse(const char* text, TagId& out) {
+  if (!text || !*text) return false;
+  char* end = nullptr;
+  unsigned long long v = strtoull(text, &end, 16);
+  if (*end != '\0' || end - text > 16) return false;
+  out = static_cast<TagId>(v);
+  return out != 0;
+}
+
+// Fixed-size buffer for printing a key inline.
+struct Hex {
+  explicit Hex(TagId id) { format(id, str, sizeof(str)); }
+  char str[kHexSize];
+};
+
+}  // namespace Tags
@@ -0,0 +1,147 @@
+/**
+ * @file TagIndex.hpp
+ * @brief Fixed-capacity open-addressing hash map from TagId to a 32-bit value.
+ *
+ * Linear probing over a table sized for a 75% load at full capacity, with
+ * backward-shift deletion so no tombstones build up. Keys are stored as two
+ * 32-bit halves so a slot is 12 bytes rather than a padded 16. Key 0 marks
+ * an empty slot, which is also the "no tag" value.
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "TagId.hpp"
+
+template <size_t Capacity>
+class TagIndex {
+ public:
+  static constexpr size_t kSlots = Capacity + Capacity / 3 + 1;
+
+  // Inserts or updates. Returns false only when adding a new key to a full
+  // index.
+  bool put(TagId key, uint32_t value) {
+    if (key == 0) return false;
+    size_t i = home(key);
+    for (size_t probe = 1;; ++probe, i = next(i)) {
+      Slot& s = m_slots[i];
+      if (s.empty()) {
+        if (m_count == Capacity) return false;
+        s.set(key, value);
+        ++m_count;
+        if (probe > m_maxProbe) m_maxProbe = probe;
+        return true;
+      }
+      if (s.key() == key) {
+        s.value = value;
+        return true;
+      }
+    }
+  }
+
+  uint32_t* find(TagId key) {
+    size_t i = locate(key);
+    return i == kSlots ? nullptr : &m_slots[i].value;
+  }
+  const uint32_t* find(TagId key) const { return const_cast<TagIndex*>(this)->find(key); }
+  bool contains(TagId key) const { return find(key) != nullptr; }
+
+  bool erase(TagId key) {
+    size_t hole = locate(key);
+    if (hole == kSlots) return false;
+    // Pull later entries of the run back over the hole unless that would
+    // move them in front of their home slot.
+    for (size_t j = next(hole); !m_slots[j].empty(); j = next(j)) {
+      if (distance(home(m_slots[j].key()), j) >= distance(hole, j)) {
+        m_slots[hole] = m_slots[j];
+        hole = j;
+      }
+    }
+    m_slots[hole] = Slot();
+    --m_count;
+    return true;
+  }
+
+  void clear() {
+    for (Slot& s : m_slots) s = Slot();
+    m_count = 0;
+    m_maxProbe = 0;
+  }
+
+  size_t size() const { return m_count; }
+  // Longest probe sequence any insert has needed since the last clear().
+  size_t maxProbe() const { return m_maxProbe; }
+
+  // Calls fn(key, value&) for every entry in table order, which is stable
+  // while the index is not modified.
+  template <typename Fn>
+  void forEach(Fn fn) {
+    for (Slot& s : m_slots) {
+      if (!s.empty()) fn(s.key(), s.value);
+    }
+  }
+
+  // The `max` smallest keys greater than `after`, sorted. One pass over the
+  // table, so pages stay stable across inserts and deletes.
+  size_t listAfter(TagId after, TagId* out, size_t max) const {
+    size_t n = 0;
+    if (max == 0) return 0;
+    for (const Slot& s : m_slots) {
+      if (s.empty()) continue;
+      TagId key = s.key();
+      if (key <= after || (n == max && key >= out[n - 1])) continue;
+      size_t at = n < max ? n++ : max - 1;
+      while (at > 0 && out[at - 1] > key) {
+        out[at] = out[at - 1];
+        --at;
+      }
+      out[at] = key;
+    }
+    return n;
+  }
+
+ private:
+  struct Slot {
+    uint32_t keyLo = 0;
+    uint32_t keyHi = 0;
+    uint32_t value = 0;
+
+    bool empty() const { return (keyLo | keyHi) == 0; }
+    TagId key() const { return (static_cast<TagId>(keyHi) << 32) | keyLo; }
+    void set(TagId k, uint32_t v) {
+      keyLo = static_cast<uint32_t>(k);
+      keyHi = static_cast<uint32_t>(k >> 32);
+      value = v;
+    }
+  };
+
+  // murmur3's 32-bit finalizer over both halves, then (h * kSlots) >> 32 to
+  // map it onto the table. kSlots is not a power of two, so that last step
+  // is a 32x32->64 multiply; on RV32 it costs one extra mulhu.
+  static size_t home(TagId key) {
+    uint32_t h = static_cast<uint32_t>(key) ^ (static_cast<uint32_t>(key >> 32) * 0x9E3779B1u);
+    h ^= h >> 16;
+    h *= 0x85EBCA6Bu;
+    h ^= h >> 13;
+    h *= 0xC2B2AE35u;
+    h ^= h >> 16;
+    return static_cast<size_t>((static_cast<uint64_t>(h) * kSlots) >> 32);
+  }
+
+  static size_t next(size_t i) { return i + 1 == kSlots ? 0 : i + 1; }
+  static size_t distance(size_t from, size_t to) { return to >= from ? to - from : to + kSlots - from; }
+
+  size_t locate(TagId key) const {
+    if (key == 0) return kSlots;
+    for (size_t i = home(key);; i = next(i)) {
+      const Slot& s = m_slots[i];
+      if (s.empty()) return kSlots;
+      if (s.key() == key) return i;
+    }
+  }
+
+  Slot m_slots[kSlots];
+  size_t m_count = 0;
+  size_t m_maxProbe = 0;
+};
@@ -1,15 +1,24 @@
 /**
  * @file WebUI.hpp
- * @brief Embedded HTTP server for base syringe metadata.
+ * @brief Embedded HTTP server for base syringe metadata, motion, recipes and
+ *        jobs, with a server-sent event stream of tag, current-base, stepper,
+ *        save and job events at /api/events.
  */
 #pragma once
 
 #include <Arduino.h>
 
+#include "TagId.hpp"
+
 namespace WebUI {
 
 void begin();
-void handle();
-void setCurrentRfid(uint32_t rfid);
+// Update the state shown to clients; changes are pushed to subscribers of
+// /api/events. Call from the web task, after CurrentBase::load() for a new
+// tag so the "current" event carries its record.
+void setCurrentRfid(TagId rfid);
+void setStepperState(bool moving, bool withdrawing);
+// Pushes job progress to subscribers if it changed since the last call.
+void refreshJob();
 
 }  // namespace WebUI
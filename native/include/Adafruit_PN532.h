@@ -0,0 +1,39 @@
+/**
+ * @file Adafruit_PN532.h
+ * @brief Host stand-in for the Adafruit PN532 driver.
+ *
+ * Tags are "presented" from host code with HostPn532::present()/remove().
+ * Detection follows the real split-phase API: startPassiveTargetIDDetection()
+ * drops the IRQ pin once a tag is in the field, readDetectedPassiveTargetID()
+ * collects it.
+ */
+#pragma once
+
+#include <Arduino.h>
+#include <Wire.h>
+
+#define PN532_MIFARE_ISO14443A (0x00)
+
+namespace HostPn532 {
+void present(const uint8_t* uid, uint8_t len);
+void remove();
+// Simulated I2C cost of each driver call, in microseconds.
+void setCallCostUs(uint32_t us);
+}  // namespace HostPn532
+
+class Adafruit_PN532 {
+ public:
+  Adafruit_PN532(uint8_t irq, uint8_t reset, TwoWire* theWire = &Wire);
+
+  bool begin();
+  uint32_t getFirmwareVersion();
+  bool SAMConfig();
+  bool setPassiveActivationRetries(uint8_t maxRetries);
+  bool readPassiveTargetID(uint8_t cardbaudrate, uint8_t* uid, uint8_t* uidLength, uint16_t timeout = 0);
+  bool startPassiveTargetIDDetection(uint8_t cardbaudrate);
+  bool readDetectedPassiveTargetID(uint8_t* uid, uint8_t* uidLength);
+
+ private:
+  uint8_t m_irq;
+  bool m_detecting = false;
+};
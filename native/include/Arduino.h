@@ -0,0 +1,269 @@
+/**
+ * @file Arduino.h
+ * @brief Host stand-in for the subset of the Arduino-ESP32 core the firmware uses.
+ */
+#pragma once
+
+#include <cctype>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+#define PROGMEM
+#define IRAM_ATTR
+#define ARDUINO_ISR_ATTR
+#define F(str) (str)
+#define PSTR(str) (str)
+
+constexpr uint8_t LOW = 0;
+constexpr uint8_t HIGH = 1;
+constexpr uint8_t INPUT = 0x01;
+constexpr uint8_t OUTPUT = 0x03;
+constexpr uint8_t INPUT_PULLUP = 0x05;
+constexpr int RISING = 0x01;
+constexpr int FALLING = 0x02;
+constexpr int CHANGE = 0x03;
+constexpr int DEC = 10;
+constexpr int HEX = 16;
+
+size_t strlcpy(char* dst, const char* src, size_t size);
+
+// ---------------------------------------------------------------------------
+// Time and GPIO
+
+namespace HostClock {
+// Switch micros()/millis() to a manually advanced virtual clock.
+void useVirtual(bool enabled);
+bool isVirtual();
+void set(uint64_t us);
+void advance(uint64_t us);
+uint64_t now();
+}  // namespace HostClock
+
+namespace HostGpio {
+constexpr int kPinCount = 48;
+void setInput(int pin, uint8_t level);
+uint8_t output(int pin);
+void setWriteHook(void (*hook)(int pin, uint8_t level));
+}  // namespace HostGpio
+
+uint32_t micros();
+uint32_t millis();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+void yield();
+
+void pinMode(int pin, uint8_t mode);
+void digitalWrite(int pin, uint8_t level);
+int digitalRead(int pin);
+int digitalPinToInterrupt(int pin);
+void attachInterrupt(int interrupt, void (*isr)(), int mode);
+void detachInterrupt(int interrupt);
+
+// ---------------------------------------------------------------------------
+// Hardware timers (arduino-esp32 2.x API)
+
+struct hw_timer_t;
+
+hw_timer_t* timerBegin(uint8_t num, uint16_t divider, bool countUp);
+void timerEnd(hw_timer_t* timer);
+void timerAttachInterrupt(hw_timer_t* timer, void (*fn)(), bool edge);
+void timerAlarmWrite(hw_timer_t* timer, uint64_t alarmValue, bool autoreload);
+void timerAlarmEnable(hw_timer_t* timer);
+void timerAlarmDisable(hw_timer_t* timer);
+void timerWrite(hw_timer_t* timer, uint64_t value);
+uint64_t timerRead(hw_timer_t* timer);
+
+namespace HostTimer {
+// Fire every armed timer alarm that falls due up to `untilUs` on the virtual
+// clock, advancing the clock to each alarm before calling its ISR.
+void runUntil(uint64_t untilUs);
+// Virtual timestamp of the next due alarm, or UINT64_MAX when none is armed.
+uint64_t nextDue();
+}  // namespace HostTimer
+
+// ---------------------------------------------------------------------------
+// String
+
+class String {
+ public:
+  String() = default;
+  String(const char* s) : m_str(s ? s : "") {}
+  String(const std::string& s) : m_str(s) {}
+  String(char c) : m_str(1, c) {}
+  String(int v, int base = DEC);
+  String(unsigned int v, int base = DEC);
+  String(long v, int base = DEC);
+  String(unsigned long v, int base = DEC);
+  String(float v, unsigned int decimals = 2);
+  String(double v, unsigned int decimals = 2);
+
+  unsigned int length() const { return static_cast<unsigned int>(m_str.size()); }
+  const char* c_str() const { return m_str.c_str(); }
+  bool reserve(unsigned int size) {
+    m_str.reserve(size);
+    return true;
+  }
+
+  String& operator+=(const String& rhs) {
+    m_str += rhs.m_str;
+    return *this;
+  }
+  String& operator+=(const char* rhs) {
+    m_str += rhs;
+    return *this;
+  }
+  String& operator+=(char c) {
+    m_str += c;
+    return *this;
+  }
+  bool concat(const char* s) {
+    m_str += s;
+    return true;
+  }
+  bool concat(const char* s, unsigned int len) {
+    m_str.append(s, len);
+    return true;
+  }
+  bool concat(const String& s) {
+    m_str += s.m_str;
+    return true;
+  }
+  bool concat(char c) {
+    m_str += c;
+    return true;
+  }
+
+  friend String operator+(const String& a, const String& b) { return String(a.m_str + b.m_str); }
+  friend String operator+(const String& a, const char* b) { return String(a.m_str + b); }
+  friend String operator+(const char* a, const String& b) { return String(a + b.m_str); }
+
+  bool operator==(const String& rhs) const { return m_str == rhs.m_str; }
+  bool operator==(const char* rhs) const { return m_str == rhs; }
+  bool operator!=(const String& rhs) const { return m_str != rhs.m_str; }
+  bool operator!=(const char* rhs) const { return m_str != rhs; }
+  bool operator<(const String& rhs) const { return m_str < rhs.m_str; }
+  char operator[](unsigned int i) const { return i < m_str.size() ? m_str[i] : '\0'; }
+  char charAt(unsigned int i) const { return (*this)[i]; }
+
+  bool equals(const String& rhs) const { return m_str == rhs.m_str; }
+  bool equalsIgnoreCase(const String& rhs) const;
+  bool startsWith(const String& prefix) const { return m_str.rfind(prefix.m_str, 0) == 0; }
+  bool endsWith(const String& suffix) const;
+  int indexOf(char c, unsigned int from = 0) const;
+  int indexOf(const String& s, unsigned int from = 0) const;
+  int lastIndexOf(char c) const;
+  String substring(unsigned int from) const;
+  String substring(unsigned int from, unsigned int to) const;
+  void trim();
+  void toLowerCase();
+  void toUpperCase();
+  long toInt() const { return std::strtol(m_str.c_str(), nullptr, 10); }
+  float toFloat() const { return std::strtof(m_str.c_str(), nullptr); }
+  bool isEmpty() const { return m_str.empty(); }
+
+ private:
+  std::string m_str;
+};
+
+// ---------------------------------------------------------------------------
+// Print / Stream / Serial
+
+class Print {
+ public:
+  virtual ~Print() = default;
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t* buffer, size_t size);
+  size_t write(const char* s) { return write(reinterpret_cast<const uint8_t*>(s), strlen(s)); }
+  size_t write(const char* s, size_t n) { return write(reinterpret_cast<const uint8_t*>(s), n); }
+  virtual void flush() {}
+
+  size_t print(const char* s) { return write(s); }
+  size_t print(const String& s) { return write(s.c_str(), s.length()); }
+  size_t print(char c) { return write(static_cast<uint8_t>(c)); }
+  size_t print(int v, int base = DEC) { return print(String(v, base)); }
+  size_t print(unsigned int v, int base = DEC) { return print(String(v, base)); }
+  size_t print(long v, int base = DEC) { return print(String(v, base)); }
+  size_t print(unsigned long v, int base = DEC) { return print(String(v, base)); }
+  size_t print(double v, int decimals = 2) { return print(String(v, static_cast<unsigned int>(decimals))); }
+  template <typename T>
+  size_t println(const T& v) {
+    size_t n = print(v);
+    return n + println();
+  }
+  template <typename T>
+  size_t println(const T& v, int fmt) {
+    size_t n = print(v, fmt);
+    return n + println();
+  }
+  size_t println() { return write("\r\n"); }
+  size_t printf(const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+};
+
+class Stream : public Print {
+ public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+  size_t readBytes(uint8_t* buffer, size_t length);
+  size_t readBytes(char* buffer, size_t length) {
+    return readBytes(reinterpret_cast<uint8_t*>(buffer), length);
+  }
+  void setTimeout(unsigned long) {}
+};
+
+class HardwareSerial : public Stream {
+ public:
+  void begin(unsigned long baud);
+  void end() {}
+  void updateBaudRate(unsigned long baud) { m_baud = baud; }
+  unsigned long baudRate() const { return m_baud; }
+  int available() override;
+  int read() override;
+  int peek() override;
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t* buffer, size_t size) override;
+  using Print::write;
+  int availableForWrite() { return 4096; }
+  operator bool() const { return true; }
+
+  // Host side: queue bytes as if the host PC had sent them.
+  void inject(const char* data, size_t len);
+  void inject(const char* line) { inject(line, strlen(line)); }
+  // Host side: silence output (benchmarks) or capture it.
+  void setEcho(bool echo) { m_echo = echo; }
+  std::string takeOutput();
+
+ private:
+  unsigned long m_baud = 0;
+  bool m_echo = true;
+  std::string m_rx;
+  size_t m_rxPos = 0;
+  std::string m_tx;
+};
+
+extern HardwareSerial Serial;
+
+// ---------------------------------------------------------------------------
+// ESP system
+
+class EspClass {
+ public:
+  uint32_t getFreeHeap() const { return 200 * 1024; }
+  uint32_t getMinFreeHeap() const { return 180 * 1024; }
+  uint32_t getMaxAllocHeap() const { return 100 * 1024; }
+  uint32_t getCycleCount() const;
+  uint32_t getCpuFreqMHz() const { return 160; }
+  void restart() { std::exit(0); }
+};
+
+extern EspClass ESP;
+
+int64_t esp_timer_get_time();
@@ -0,0 +1,253 @@
+/**
+ * @file ESPAsyncWebServer.h
+ * @brief Host stand-in for ESPAsyncWebServer.
+ *
+ * Requests are dispatched in-process with AsyncWebServer::request(); the
+ * response is captured instead of being written to a socket. Bodies are fed
+ * to body handlers and chunked fillers are drained in small pieces, so the
+ * incremental paths run the same way they do on the device.
+ */
+#pragma once
+
+#include <Arduino.h>
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+enum WebRequestMethod : uint8_t {
+  HTTP_GET = 0b00000001,
+  HTTP_POST = 0b00000010,
+  HTTP_DELETE = 0b00000100,
+  HTTP_PUT = 0b00001000,
+  HTTP_PATCH = 0b00010000,
+  HTTP_HEAD = 0b00100000,
+  HTTP_OPTIONS = 0b01000000,
+  HTTP_ANY = 0b01111111,
+};
+using WebRequestMethodComposite = uint8_t;
+
+constexpr size_t RESPONSE_TRY_AGAIN = 0xFFFFFFFF;
+
+class AsyncWebServerRequest;
+
+using ArRequestHandlerFunction = std::function<void(AsyncWebServerRequest*)>;
+using ArUploadHandlerFunction = std::function<void(AsyncWebServerRequest*, const String& filename, size_t index,
+                                                   uint8_t* data, size_t len, bool final)>;
+using ArBodyHandlerFunction =
+    std::function<void(AsyncWebServerRequest*, uint8_t* data, size_t len, size_t index, size_t total)>;
+using AwsResponseFiller = std::function<size_t(uint8_t* buffer, size_t maxLen, size_t index)>;
+
+struct HostHttpResponse {
+  int code = 0;
+  std::string contentType;
+  std::string body;
+  std::vector<std::pair<std::string, std::string>> headers;
+  bool chunked = false;
+};
+
+class AsyncWebParameter {
+ public:
+  AsyncWebParameter(const String& name, const String& value) : m_name(name), m_value(value) {}
+  const String& name() const { return m_name; }
+  const String& value() const { return m_value; }
+
+ private:
+  String m_name;
+  String m_value;
+};
+
+class AsyncWebHeader {
+ public:
+  AsyncWebHeader(const String& name, const String& value) : m_name(name), m_value(value) {}
+  const String& name() const { return m_name; }
+  const String& value() const { return m_value; }
+
+ private:
+  String m_name;
+  String m_value;
+};
+
+class AsyncWebServerResponse {
+ public:
+  AsyncWebServerResponse(int code, const String& contentType) : m_code(code), m_contentType(contentType) {}
+  virtual ~AsyncWebServerResponse() = default;
+  void addHeader(const String& name, const String& value) {
+    m_headers.emplace_back(name.c_str(), value.c_str());
+  }
+  // Host side: render into a captured response.
+  virtual void render(HostHttpResponse& out);
+
+ protected:
+  int m_code;
+  String m_contentType;
+  std::vector<std::pair<std::string, std::string>> m_headers;
+};
+
+class AsyncBasicResponse : public AsyncWebServerResponse {
+ public:
+  AsyncBasicResponse(int code, const String& contentType, std::string content)
+      : AsyncWebServerResponse(code, contentType), m_content(std::move(content)) {}
+  void render(HostHttpResponse& out) override;
+
+ private:
+  std::string m_content;
+};
+
+class AsyncChunkedResponse : public AsyncWebServerResponse {
+ public:
+  AsyncChunkedResponse(const String& contentType, AwsResponseFiller filler)
+      : AsyncWebServerResponse(200, contentType), m_filler(std::move(filler)) {}
+  void render(HostHttpResponse& out) override;
+
+ private:
+  AwsResponseFiller m_filler;
+};
+
+class AsyncResponseStream : public AsyncWebServerResponse, public Print {
+ public:
+  explicit AsyncResponseStream(const String& contentType) : AsyncWebServerResponse(200, contentType) {}
+  size_t write(uint8_t c) override {
+    m_content.push_back(static_cast<char>(c));
+    return 1;
+  }
+  size_t write(const uint8_t* data, size_t len) override {
+    m_content.append(reinterpret_cast<const char*>(data), len);
+    return len;
+  }
+  using Print::write;
+  void render(HostHttpResponse& out) override;
+
+ private:
+  std::string m_content;
+};
+
+class AsyncWebServerRequest {
+ public:
+  WebRequestMethodComposite method() const { return m_method; }
+  const String& url() const { return m_url; }
+  size_t contentLength() const { return m_contentLength; }
+
+  bool hasParam(const String& name, bool post = false) const;
+  const AsyncWebParameter* getParam(const String& name, bool post = false) const;
+  bool hasHeader(const String& name) const;
+  const AsyncWebHeader* getHeader(const String& name) const;
+
+  void send(int code, const String& contentType = String(), const String& content = String());
+  void send(AsyncWebServerResponse* response);
+  AsyncWebServerResponse* beginResponse(int code, const String& contentType, const String& content = String());
+  AsyncWebServerResponse* beginResponse(int code, const String& contentType, const uint8_t* content, size_t len);
+  AsyncWebServerResponse* beginChunkedResponse(const String& contentType, AwsResponseFiller filler);
+  AsyncResponseStream* beginResponseStream(const String& contentType, size_t bufferSize = 1460);
+
+  // Scratch pointer owned by the request and released with free().
+  void* _tempObject = nullptr;
+
+ private:
+  friend class AsyncWebServer;
+
+  WebRequestMethodComposite m_method = HTTP_GET;
+  String m_url;
+  size_t m_contentLength = 0;
+  std::vector<AsyncWebParameter> m_params;
+  std::vector<AsyncWebHeader> m_headers;
+  std::unique_ptr<AsyncWebServerResponse> m_response;
+};
+
+using ArRequestFilterFunction = std::function<bool(AsyncWebServerRequest*)>;
+
+class AsyncWebHandler {
+ public:
+  virtual ~AsyncWebHandler() = default;
+  AsyncWebHandler& setFilter(ArRequestFilterFunction fn) {
+    m_filter = std::move(fn);
+    return *this;
+  }
+  bool filter(AsyncWebServerRequest* request) const { return !m_filter || m_filter(request); }
+
+ private:
+  ArRequestFilterFunction m_filter;
+};
+
+// One event as delivered to connected SSE clients.
+struct HostEvent {
+  std::string event;
+  std::string data;
+  uint32_t id;
+};
+
+class AsyncEventSourceClient {
+ public:
+  void send(const char* message, const char* event = nullptr, uint32_t id = 0, uint32_t reconnect = 0);
+  // Host side: events delivered to this client.
+  std::vector<HostEvent> sent;
+};
+
+using ArEventHandlerFunction = std::function<void(AsyncEventSourceClient*)>;
+
+class AsyncEventSource : public AsyncWebHandler {
+ public:
+  explicit AsyncEventSource(const String& url) : m_url(url) { registry().push_back(this); }
+  const String& url() const { return m_url; }
+  void onConnect(ArEventHandlerFunction cb) { m_connect = std::move(cb); }
+  void send(const char* message, const char* event = nullptr, uint32_t id = 0, uint32_t reconnect = 0);
+  size_t count() const { return m_clients.size(); }
+
+  // Host side: attach a client (running the connect callback) or drop all.
+  AsyncEventSourceClient* connectHostClient();
+  void disconnectHostClients() { m_clients.clear(); }
+  static AsyncEventSource* hostFind(const char* url) {
+    for (AsyncEventSource* source : registry()) {
+      if (source->m_url == url) return source;
+    }
+    return nullptr;
+  }
+
+ private:
+  static std::vector<AsyncEventSource*>& registry() {
+    static std::vector<AsyncEventSource*> sources;
+    return sources;
+  }
+
+  String m_url;
+  ArEventHandlerFunction m_connect;
+  std::vector<std::unique_ptr<AsyncEventSourceClient>> m_clients;
+};
+
+class AsyncWebServer {
+ public:
+  explicit AsyncWebServer(uint16_t port) : m_port(port) {}
+
+  void begin() { s_active = this; }
+  void end() { s_active = nullptr; }
+  void on(const char* uri, WebRequestMethodComposite method, ArRequestHandlerFunction onRequest,
+          ArUploadHandlerFunction onUpload = nullptr, ArBodyHandlerFunction onBody = nullptr);
+  void onNotFound(ArRequestHandlerFunction fn) { m_notFound = std::move(fn); }
+  AsyncWebHandler& addHandler(AsyncWebHandler* handler) {
+    m_handlers.push_back(handler);
+    return *handler;
+  }
+
+  // Host side: dispatch one request through the registered handlers. The body
+  // is delivered to body handlers in `bodyPiece`-byte pieces and chunked
+  // responses are drained `chunkSize` bytes at a time.
+  static HostHttpResponse request(WebRequestMethodComposite method, const char* uri, const char* body = nullptr,
+                                  const std::vector<std::pair<std::string, std::string>>& headers = {});
+  static void setPieceSizes(size_t bodyPiece, size_t chunkSize);
+  static size_t chunkSize();
+
+ private:
+  struct Route {
+    String uri;
+    WebRequestMethodComposite method;
+    ArRequestHandlerFunction onRequest;
+    ArBodyHandlerFunction onBody;
+  };
+
+  static AsyncWebServer* s_active;
+  uint16_t m_port;
+  std::vector<Route> m_routes;
+  std::vector<AsyncWebHandler*> m_handlers;
+  ArRequestHandlerFunction m_notFound;
+};
@@ -0,0 +1,78 @@
+/**
+ * @file FS.h
+ * @brief Host stand-in for the Arduino-ESP32 filesystem API, backed by a host directory.
+ */
+#pragma once
+
+#include <Arduino.h>
+
+#include <memory>
+
+namespace fs {
+
+enum SeekMode { SeekSet = 0, SeekCur = 1, SeekEnd = 2 };
+
+struct FileImpl;
+
+class File : public Stream {
+ public:
+  File() = default;
+  explicit File(std::shared_ptr<FileImpl> impl) : m_impl(std::move(impl)) {}
+
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t* buf, size_t size) override;
+  using Print::write;
+  int available() override;
+  int read() override;
+  int peek() override;
+  void flush() override;
+  size_t read(uint8_t* buf, size_t size);
+  bool seek(uint32_t pos, SeekMode mode = SeekSet);
+  size_t position() const;
+  size_t size() const;
+  void close();
+  operator bool() const;
+  const char* name() const;
+  const char* path() const;
+  bool isDirectory() const;
+  File openNextFile(const char* mode = "r");
+
+ private:
+  std::shared_ptr<FileImpl> m_impl;
+};
+
+class FS {
+ public:
+  File open(const char* path, const char* mode = "r", bool create = false);
+  File open(const String& path, const char* mode = "r", bool create = false) {
+    return open(path.c_str(), mode, create);
+  }
+  bool exists(const char* path);
+  bool exists(const String& path) { return exists(path.c_str()); }
+  bool remove(const char* path);
+  bool remove(const String& path) { return remove(path.c_str()); }
+  bool rename(const char* from, const char* to);
+  bool rename(const String& from, const String& to) { return rename(from.c_str(), to.c_str()); }
+  bool mkdir(const char* path);
+  bool mkdir(const String& path) { return mkdir(path.c_str()); }
+  bool rmdir(const char* path);
+};
+
+}  // namespace fs
+
+using fs::File;
+using fs::FS;
+using fs::SeekCur;
+using fs::SeekEnd;
+using fs::SeekSet;
+
+namespace HostFs {
+// Directory that stands in for the flash partition. Defaults to a fresh
+// directory under $TMPDIR; override before LittleFS.begin().
+void setRoot(const char* dir);
+const char* root();
+// Counters for benchmarks: files opened and bytes written since reset.
+void resetCounters();
+uint32_t opens();
+uint64_t bytesWritten();
+}  // namespace HostFs
@@ -0,0 +1,18 @@
+/**
+ * @file LittleFS.h
+ * @brief Host stand-in for LittleFS, backed by a host directory.
+ */
+#pragma once
+
+#include <FS.h>
+
+class LittleFSFS : public fs::FS {
+ public:
+  bool begin(bool formatOnFail = false, const char* basePath = "/littlefs", uint8_t maxOpenFiles = 10,
+             const char* partitionLabel = "spiffs");
+  void end() {}
+  size_t totalBytes();
+  size_t usedBytes();
+};
+
+extern LittleFSFS LittleFS;
@@ -0,0 +1,17 @@
+/**
+ * @file WifiCredentials.hpp
+ * @brief Host stand-in for the shared WiFi credential store.
+ */
+#pragma once
+
+#include <Arduino.h>
+
+namespace Shared {
+namespace WiFiCredentials {
+
+bool save(const String& ssid, const String& password);
+bool load(String& ssid, String& password);
+bool clear();
+
+}  // namespace WiFiCredentials
+}  // namespace Shared
@@ -0,0 +1,24 @@
+/**
+ * @file WifiManager.hpp
+ * @brief Host stand-in for the shared WiFi station/AP manager.
+ */
+#pragma once
+
+#include <Arduino.h>
+
+namespace Shared {
+
+class WifiManager {
+ public:
+  bool connect(const String& ssid, const String& password);
+  void startAccessPoint();
+  String buildStatusJson() const;
+  String buildScanJson();
+
+ private:
+  bool m_connected = false;
+  bool m_ap = false;
+  String m_ssid;
+};
+
+}  // namespace Shared
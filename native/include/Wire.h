@@ -0,0 +1,21 @@
+/**
+ * @file Wire.h
+ * @brief Host stand-in for the Arduino I2C bus (no-op).
+ */
+#pragma once
+
+#include <Arduino.h>
+
+class TwoWire {
+ public:
+  bool begin(int sda = -1, int scl = -1, uint32_t frequency = 0) {
+    (void)sda;
+    (void)scl;
+    (void)frequency;
+    return true;
+  }
+  void setClock(uint32_t) {}
+  void setTimeOut(uint16_t) {}
+};
+
+extern TwoWire Wire;
@@ -0,0 +1,66 @@
+/**
+ * @file rmt.h
+ * @brief Host stand-in for the subset of the ESP-IDF RMT TX driver that
+ *        StepPulse uses.
+ *
+ * A started train is not played out in real time: each rising edge is
+ * reported at once to the hook set with HostRmt::setEdgeHook, stamped with
+ * the clock value at which the peripheral would produce it.
+ */
+#pragma once
+
+#include <Arduino.h>
+
+typedef int esp_err_t;
+constexpr esp_err_t ESP_OK = 0;
+constexpr esp_err_t ESP_ERR_INVALID_ARG = 0x102;
+
+typedef int gpio_num_t;
+
+typedef enum { RMT_CHANNEL_0, RMT_CHANNEL_1, RMT_CHANNEL_MAX } rmt_channel_t;
+typedef enum { RMT_IDLE_LEVEL_LOW, RMT_IDLE_LEVEL_HIGH } rmt_idle_level_t;
+
+typedef struct {
+  union {
+    struct {
+      uint32_t duration0 : 15;
+      uint32_t level0 : 1;
+      uint32_t duration1 : 15;
+      uint32_t level1 : 1;
+    };
+    uint32_t val;
+  };
+} rmt_item32_t;
+
+typedef struct {
+  bool idle_output_en;
+  rmt_idle_level_t idle_level;
+} rmt_tx_config_t;
+
+typedef struct {
+  rmt_channel_t channel;
+  gpio_num_t gpio_num;
+  uint8_t clk_div;
+  uint8_t mem_block_num;
+  rmt_tx_config_t tx_config;
+} rmt_config_t;
+
+#define RMT_DEFAULT_CONFIG_TX(gpio, channel_id) \
+  { (channel_id), (gpio), 80, 1, { true, RMT_IDLE_LEVEL_LOW } }
+
+// Words of RMT memory per channel, as on the ESP32-C3.
+constexpr size_t kHostRmtMemWords = 48;
+
+esp_err_t rmt_config(const rmt_config_t* config);
+esp_err_t rmt_driver_install(rmt_channel_t channel, size_t rx_buf_size, int intr_alloc_flags);
+esp_err_t rmt_fill_tx_items(rmt_channel_t channel, const rmt_item32_t* item, uint16_t item_num, uint16_t mem_offset);
+esp_err_t rmt_tx_start(rmt_channel_t channel, bool tx_idx_rst);
+
+namespace HostRmt {
+// Called for every rising edge a started train produces, with its virtual
+// time in microseconds (the channel's divider is assumed to be 80).
+void setEdgeHook(void (*hook)(int pin, uint64_t atUs));
+// Trains started and rising edges produced since boot.
+uint32_t trains();
+uint32_t edges();
+}  // namespace HostRmt
@@ -0,0 +1,14 @@
+/**
+ * @file semphr.h
+ * @brief Host stand-in for FreeRTOS mutexes, backed by std::recursive_timed_mutex.
+ */
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+
+typedef struct HostSemaphore* SemaphoreHandle_t;
+
+SemaphoreHandle_t xSemaphoreCreateMutex();
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem);
+void vSemaphoreDelete(SemaphoreHandle_t sem);
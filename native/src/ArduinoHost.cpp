@@ -0,0 +1,426 @@
+/**
+ * @file ArduinoHost.cpp
+ * @brief Host implementation of the Arduino core stand-in: clock, GPIO,
+ *        hardware timers, String and Serial.
+ */
+#include <Arduino.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <unistd.h>
+
+HardwareSerial Serial;
+EspClass ESP;
+
+size_t strlcpy(char* dst, const char* src, size_t size) {
+  size_t len = strlen(src);
+  if (size != 0) {
+    size_t n = len < size - 1 ? len : size - 1;
+    memcpy(dst, src, n);
+    dst[n] = '\0';
+  }
+  return len;
+}
+
+// ---------------------------------------------------------------------------
+// Clock
+
+namespace {
+using SteadyClock = std::chrono::steady_clock;
+const SteadyClock::time_point g_epoch = SteadyClock::now();
+std::atomic<bool> g_virtual{false};
+std::atomic<uint64_t> g_virtualUs{0};
+
+uint64_t realMicros() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(SteadyClock::now() - g_epoch).count();
+}
+}  // namespace
+
+namespace HostClock {
+void useVirtual(bool enabled) {
+  if (enabled) g_virtualUs = realMicros();
+  g_virtual = enabled;
+}
+bool isVirtual() { return g_virtual; }
+void set(uint64_t us) { g_virtualUs = us; }
+void advance(uint64_t us) { g_virtualUs += us; }
+uint64_t now() { return g_virtual ? g_virtualUs.load() : realMicros(); }
+}  // namespace HostClock
+
+uint32_t micros() { return static_cast<uint32_t>(HostClock::now()); }
+uint32_t millis() { return static_cast<uint32_t>(HostClock::now() / 1000); }
+int64_t esp_timer_get_time() { return static_cast<int64_t>(HostClock::now()); }
+
+uint32_t EspClass::getCycleCount() const {
+  return static_cast<uint32_t>(HostClock::now() * getCpuFreqMHz());
+}
+
+void delayMicroseconds(uint32_t us) {
+  if (HostClock::isVirtual()) {
+    HostTimer::runUntil(HostClock::now() + us);
+    return;
+  }
+  std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+void delay(uint32_t ms) { delayMicroseconds(ms * 1000); }
+
+void yield() {
+  if (!HostClock::isVirtual()) std::this_thread::yield();
+}
+
+// ---------------------------------------------------------------------------
+// GPIO
+
+namespace {
+struct PinState {
+  uint8_t mode = INPUT;
+  uint8_t level = LOW;
+  void (*isr)() = nullptr;
+  int isrMode = 0;
+};
+PinState g_pins[HostGpio::kPinCount];
+void (*g_writeHook)(int, uint8_t) = nullptr;
+
+bool validPin(int pin) { return pin >= 0 && pin < HostGpio::kPinCount; }
+}  // namespace
+
+namespace HostGpio {
+void setInput(int pin, uint8_t level) {
+  if (!validPin(pin)) return;
+  PinState& p = g_pins[pin];
+  uint8_t prev = p.level;
+  p.level = level;
+  if (!p.isr || prev == level) return;
+  bool rising = level == HIGH;
+  if (p.isrMode == CHANGE || (p.isrMode == RISING && rising) || (p.isrMode == FALLING && !rising)) {
+    p.isr();
+  }
+}
+uint8_t output(int pin) { return validPin(pin) ? g_pins[pin].level : LOW; }
+void setWriteHook(void (*hook)(int, uint8_t)) { g_writeHook = hook; }
+}  // namespace HostGpio
+
+void pinMode(int pin, uint8_t mode) {
+  if (!validPin(pin)) return;
+  g_pins[pin].mode = mode;
+  if (mode == INPUT_PULLUP) g_pins[pin].level = HIGH;
+}
+
+void digitalWrite(int pin, uint8_t level) {
+  if (!validPin(pin)) return;
+  g_pins[pin].level = level ? HIGH : LOW;
+  if (g_writeHook) g_writeHook(pin, g_pins[pin].level);
+}
+
+int digitalRead(int pin) { return validPin(pin) ? g_pins[pin].level : LOW; }
+
+int digitalPinToInterrupt(int pin) { return pin; }
+
+void attachInterrupt(int interrupt, void (*isr)(), int mode) {
+  if (!validPin(interrupt)) return;
+  g_pins[interrupt].isr = isr;
+  g_pins[interrupt].isrMode = mode;
+}
+
+void detachInterrupt(int interrupt) {
+  if (validPin(interrupt)) g_pins[interrupt].isr = nullptr;
+}
+
+// ---------------------------------------------------------------------------
+// Hardware timers
+//
+// Timers count in microseconds (the firmware always uses an 80 divider on
+// the 80 MHz APB clock). With the real clock a helper thread fires alarms;
+// with the virtual clock HostTimer::runUntil() does.
+
+struct hw_timer_t {
+  uint8_t num = 0;
+  void (*fn)() = nullptr;
+  uint64_t alarm = 0;
+  bool autoreload = false;
+  bool enabled = false;
+  uint64_t startUs = 0;  // clock value at which the counter was zero
+  std::thread worker;
+  std::atomic<bool> stop{false};
+};
+
+namespace {
+hw_timer_t g_timers[4];
+std::mutex g_timerMutex;
+
+uint64_t dueAt(const hw_timer_t& t) { return t.startUs + t.alarm; }
+
+void fire(hw_timer_t& t) {
+  uint64_t due = dueAt(t);
+  if (t.autoreload) {
+    t.startUs = due;
+  } else {
+    t.enabled = false;
+  }
+  if (t.fn) t.fn();
+}
+
+void realTimeWorker(hw_timer_t* t) {
+  while (!t->stop) {
+    uint64_t due = 0;
+    {
+      std::lock_guard<std::mutex> lock(g_timerMutex);
+      if (!t->enabled || HostClock::isVirtual()) {
+        due = 0;
+      } else {
+        due = dueAt(*t);
+      }
+    }
+    if (due == 0) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      continue;
+    }
+    uint64_t now = HostClock::now();
+    if (now < due) {
+      std::this_thread::sleep_for(std::chrono::microseconds(std::min<uint64_t>(due - now, 1000)));
+      continue;
+    }
+    std::lock_guard<std::mutex> lock(g_timerMutex);
+    if (t->enabled && !HostClock::isVirtual()) fire(*t);
+  }
+}
+}  // namespace
+
+hw_timer_t* timerBegin(uint8_t num, uint16_t divider, bool countUp) {
+  (void)divider;
+  (void)countUp;
+  if (num >= 4) return nullptr;
+  hw_timer_t* t = &g_timers[num];
+  t->num = num;
+  t->startUs = HostClock::now();
+  if (!t->worker.joinable()) {
+    t->stop = false;
+    t->worker = std::thread(realTimeWorker, t);
+    t->worker.detach();
+  }
+  return t;
+}
+
+void timerEnd(hw_timer_t* timer) {
+  timer->enabled = false;
+  timer->stop = true;
+}
+
+void timerAttachInterrupt(hw_timer_t* timer, void (*fn)(), bool edge) {
+  (void)edge;
+  timer->fn = fn;
+}
+
+void timerAlarmWrite(hw_timer_t* timer, uint64_t alarmValue, bool autoreload) {
+  timer->alarm = alarmValue;
+  timer->autoreload = autoreload;
+}
+
+void timerAlarmEnable(hw_timer_t* timer) {
+  timer->startUs = HostClock::now();
+  timer->enabled = true;
+}
+
+void timerAlarmDisable(hw_timer_t* timer) { timer->enabled = false; }
+
+void timerWrite(hw_timer_t* timer, uint64_t value) { timer->startUs = HostClock::now() - value; }
+
+uint64_t timerRead(hw_timer_t* timer) { return HostClock::now() - timer->startUs; }
+
+namespace HostTimer {
+uint64_t nextDue() {
+  uint64_t next = UINT64_MAX;
+  for (const hw_timer_t& t : g_timers) {
+    if (t.enabled && t.fn) next = std::min(next, dueAt(t));
+  }
+  return next;
+}
+
+void runUntil(uint64_t untilUs) {
+  for (;;) {
+    hw_timer_t* earliest = nullptr;
+    for (hw_timer_t& t : g_timers) {
+      if (!t.enabled || !t.fn) continue;
+      if (!earliest || dueAt(t) < dueAt(*earliest)) earliest = &t;
+    }
+    if (!earliest || dueAt(*earliest) > untilUs) break;
+    if (dueAt(*earliest) > HostClock::now()) HostClock::set(dueAt(*earliest));
+    fire(*earliest);
+  }
+  if (untilUs > HostClock::now()) HostClock::set(untilUs);
+}
+}  // namespace HostTimer
+
+// ---------------------------------------------------------------------------
+// String
+
+namespace {
+std::string formatInt(long long v, int base) {
+  char buf[72];
+  if (base == HEX) {
+    snprintf(buf, sizeof(buf), "%llX", static_cast<unsigned long long>(v));
+  } else {
+    snprintf(buf, sizeof(buf), "%lld", v);
+  }
+  return buf;
+}
+}  // namespace
+
+String::String(int v, int base) : m_str(formatInt(v, base)) {}
+String::String(unsigned int v, int base) : m_str(formatInt(v, base)) {}
+String::String(long v, int base) : m_str(formatInt(v, base)) {}
+String::String(unsigned long v, int base) : m_str(formatInt(static_cast<long long>(v), base)) {}
+String::String(float v, unsigned int decimals) : String(static_cast<double>(v), decimals) {}
+String::String(double v, unsigned int decimals) {
+  char buf[64];
+  snprintf(buf, sizeof(buf), "%.*f", static_cast<int>(decimals), v);
+  m_str = buf;
+}
+
+bool String::equalsIgnoreCase(const String& rhs) const {
+  if (m_str.size() != rhs.m_str.size()) return false;
+  for (size_t i = 0; i < m_str.size(); ++i) {
+    if (tolower(static_cast<unsigned char>(m_str[i])) != tolower(static_cast<unsigned char>(rhs.m_str[i]))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool String::endsWith(const String& suffix) const {
+  return m_str.size() >= suffix.m_str.size() &&
+         m_str.compare(m_str.size() - suffix.m_str.size(), suffix.m_str.size(), suffix.m_str) == 0;
+}
+
+int String::indexOf(char c, unsigned int from) const {
+  size_t pos = m_str.find(c, from);
+  return pos == std::string::npos ? -1 : static_cast<int>(pos);
+}
+
+int String::indexOf(const String& s, unsigned int from) const {
+  size_t pos = m_str.find(s.m_str, from);
+  return pos == std::string::npos ? -1 : static_cast<int>(pos);
+}
+
+int String::lastIndexOf(char c) const {
+  size_t pos = m_str.rfind(c);
+  return pos == std::string::npos ? -1 : static_cast<int>(pos);
+}
+
+String String::substring(unsigned int from) const {
+  return from >= m_str.size() ? String() : String(m_str.substr(from));
+}
+
+String String::substring(unsigned int from, unsigned int to) const {
+  if (from > to) std::swap(from, to);
+  if (from >= m_str.size()) return String();
+  return String(m_str.substr(from, to - from));
+}
+
+void String::trim() {
+  size_t start = 0;
+  while (start < m_str.size() && isspace(static_cast<unsigned char>(m_str[start]))) ++start;
+  size_t end = m_str.size();
+  while (end > start && isspace(static_cast<unsigned char>(m_str[end - 1]))) --end;
+  m_str = m_str.substr(start, end - start);
+}
+
+void String::toLowerCase() {
+  for (char& c : m_str) c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+}
+
+void String::toUpperCase() {
+  for (char& c : m_str) c = static_cast<char>(toupper(static_cast<unsigned char>(c)));
+}
+
+// ---------------------------------------------------------------------------
+// Print / Stream / Serial
+
+size_t Print::write(const uint8_t* buffer, size_t size) {
+  size_t n = 0;
+  while (n < size && write(buffer[n])) ++n;
+  return n;
+}
+
+size_t Print::printf(const char* fmt, ...) {
+  char stackBuf[256];
+  va_list args;
+  va_start(args, fmt);
+  int len = vsnprintf(stackBuf, sizeof(stackBuf), fmt, args);
+  va_end(args);
+  if (len < 0) return 0;
+  if (static_cast<size_t>(len) < sizeof(stackBuf)) return write(stackBuf, len);
+  std::string big(static_cast<size_t>(len) + 1, '\0');
+  va_start(args, fmt);
+  vsnprintf(&big[0], big.size(), fmt, args);
+  va_end(args);
+  return write(big.data(), len);
+}
+
+size_t Stream::readBytes(uint8_t* buffer, size_t length) {
+  size_t n = 0;
+  while (n < length) {
+    int c = read();
+    if (c < 0) break;
+    buffer[n++] = static_cast<uint8_t>(c);
+  }
+  return n;
+}
+
+namespace {
+std::mutex g_serialMutex;
+}
+
+void HardwareSerial::begin(unsigned long baud) { m_baud = baud; }
+
+int HardwareSerial::available() {
+  std::lock_guard<std::mutex> lock(g_serialMutex);
+  return static_cast<int>(m_rx.size() - m_rxPos);
+}
+
+int HardwareSerial::read() {
+  std::lock_guard<std::mutex> lock(g_serialMutex);
+  if (m_rxPos >= m_rx.size()) return -1;
+  int c = static_cast<uint8_t>(m_rx[m_rxPos++]);
+  if (m_rxPos == m_rx.size()) {
+    m_rx.clear();
+    m_rxPos = 0;
+  }
+  return c;
+}
+
+int HardwareSerial::peek() {
+  std::lock_guard<std::mutex> lock(g_serialMutex);
+  return m_rxPos < m_rx.size() ? static_cast<uint8_t>(m_rx[m_rxPos]) : -1;
+}
+
+size_t HardwareSerial::write(uint8_t c) { return write(&c, 1); }
+
+size_t HardwareSerial::write(const uint8_t* buffer, size_t size) {
+  std::lock_guard<std::mutex> lock(g_serialMutex);
+  if (m_echo) {
+    fwrite(buffer, 1, size, stdout);
+    fflush(stdout);
+  } else {
+    m_tx.append(reinterpret_cast<const char*>(buffer), size);
+    if (m_tx.size() > (1u << 20)) m_tx.clear();
+  }
+  return size;
+}
+
+void HardwareSerial::inject(const char* data, size_t len) {
+  std::lock_guard<std::mutex> lock(g_serialMutex);
+  m_rx.append(data, len);
+}
+
+std::string HardwareSerial::takeOutput() {
+  std::lock_guard<std::mutex> lock(g_serialMutex);
+  std::string out;
+  out.swap(m_tx);
+  return out;
+}
@@ -0,0 +1,207 @@
+/**
+ * @file AsyncWebServerHost.cpp
+ * @brief Host implementation of the ESPAsyncWebServer stand-in with
+ *        in-process request dispatch.
+ */
+#include <ESPAsyncWebServer.h>
+
+AsyncWebServer* AsyncWebServer::s_active = nullptr;
+
+namespace {
+size_t g_bodyPiece = 64;
+size_t g_chunkSize = 256;
+
+std::string lower(std::string s) {
+  for (char& c : s) c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+  return s;
+}
+
+std::string urlDecode(const std::string& in) {
+  std::string out;
+  for (size_t i = 0; i < in.size(); ++i) {
+    if (in[i] == '+') {
+      out += ' ';
+    } else if (in[i] == '%' && i + 2 < in.size()) {
+      out += static_cast<char>(strtol(in.substr(i + 1, 2).c_str(), nullptr, 16));
+      i += 2;
+    } else {
+      out += in[i];
+    }
+  }
+  return out;
+}
+
+// Same rule as AsyncCallbackWebHandler: exact match, or the route followed
+// by a path separator.
+bool routeMatches(const String& route, const String& url) {
+  if (route == url) return true;
+  std::string prefix = std::string(route.c_str()) + "/";
+  return std::string(url.c_str()).compare(0, prefix.size(), prefix) == 0;
+}
+}  // namespace
+
+void AsyncWebServerResponse::render(HostHttpResponse& out) {
+  out.code = m_code;
+  out.contentType = m_contentType.c_str();
+  out.headers = m_headers;
+}
+
+void AsyncBasicResponse::render(HostHttpResponse& out) {
+  AsyncWebServerResponse::render(out);
+  out.body = m_content;
+}
+
+void AsyncChunkedResponse::render(HostHttpResponse& out) {
+  AsyncWebServerResponse::render(out);
+  out.chunked = true;
+  std::vector<uint8_t> buf(AsyncWebServer::chunkSize());
+  size_t index = 0;
+  for (;;) {
+    size_t n = m_filler(buf.data(), buf.size(), index);
+    if (n == RESPONSE_TRY_AGAIN) continue;
+    if (n == 0) break;
+    out.body.append(reinterpret_cast<const char*>(buf.data()), n);
+    index += n;
+  }
+}
+
+void AsyncResponseStream::render(HostHttpResponse& out) {
+  AsyncWebServerResponse::render(out);
+  out.body = m_content;
+}
+
+bool AsyncWebServerRequest::hasParam(const String& name, bool post) const { return getParam(name, post) != nullptr; }
+
+const AsyncWebParameter* AsyncWebServerRequest::getParam(const String& name, bool post) const {
+  (void)post;
+  for (const AsyncWebParameter& p : m_params) {
+    if (p.name() == name) return &p;
+  }
+  return nullptr;
+}
+
+bool AsyncWebServerRequest::hasHeader(const String& name) const { return getHeader(name) != nullptr; }
+
+const AsyncWebHeader* AsyncWebServerRequest::getHeader(const String& name) const {
+  std::string key = lower(name.c_str());
+  for (const AsyncWebHeader& h : m_headers) {
+    if (lower(h.name().c_str()) == key) return &h;
+  }
+  return nullptr;
+}
+
+void AsyncWebServerRequest::send(int code, const String& contentType, const String& content) {
+  send(beginResponse(code, contentType, content));
+}
+
+void AsyncWebServerRequest::send(AsyncWebServerResponse* response) { m_response.reset(response); }
+
+AsyncWebServerResponse* AsyncWebServerRequest::beginResponse(int code, const String& contentType,
+                                                             const String& content) {
+  return new AsyncBasicResponse(code, contentType, std::string(content.c_str(), content.length()));
+}
+
+AsyncWebServerResponse* AsyncWebServerRequest::beginResponse(int code, const String& contentType,
+                                                             const uint8_t* content, size_t len) {
+  return new AsyncBasicResponse(code, contentType, std::string(reinterpret_cast<const char*>(content), len));
+}
+
+AsyncWebServerResponse* AsyncWebServerRequest::beginChunkedResponse(const String& contentType,
+                                                                    AwsResponseFiller filler) {
+  return new AsyncChunkedResponse(contentType, std::move(filler));
+}
+
+AsyncResponseStream* AsyncWebServerRequest::beginResponseStream(const String& contentType, size_t bufferSize) {
+  (void)bufferSize;
+  return new AsyncResponseStream(contentType);
+}
+
+void AsyncEventSourceClient::send(const char* message, const char* event, uint32_t id, uint32_t reconnect) {
+  (void)reconnect;
+  sent.push_back({event ? event : "", message ? message : "", id});
+}
+
+void AsyncEventSource::send(const char* message, const char* event, uint32_t id, uint32_t reconnect) {
+  for (auto& client : m_clients) client->send(message, event, id, reconnect);
+}
+
+AsyncEventSourceClient* AsyncEventSource::connectHostClient() {
+  m_clients.emplace_back(new AsyncEventSourceClient());
+  AsyncEventSourceClient* client = m_clients.back().get();
+  if (m_connect) m_connect(client);
+  return client;
+}
+
+void AsyncWebServer::on(const char* uri, WebRequestMethodComposite method, ArRequestHandlerFunction onRequest,
+                        ArUploadHandlerFunction onUpload, ArBodyHandlerFunction onBody) {
+  (void)onUpload;
+  m_routes.push_back({String(uri), method, std::move(onRequest), std::move(onBody)});
+}
+
+void AsyncWebServer::setPieceSizes(size_t bodyPiece, size_t chunkSize) {
+  g_bodyPiece = bodyPiece ? bodyPiece : 1;
+  g_chunkSize = chunkSize ? chunkSize : 1;
+}
+
+size_t AsyncWebServer::chunkSize() { return g_chunkSize; }
+
+HostHttpResponse AsyncWebServer::request(WebRequestMethodComposite method, const char* uri, const char* body,
+                                         const std::vector<std::pair<std::string, std::string>>& headers) {
+  AsyncWebServer* server = s_active;
+  if (!server) return HostHttpResponse();
+
+  AsyncWebServerRequest req;
+  std::string full = uri;
+  std::string path = full;
+  size_t q = full.find('?');
+  if (q != std::string::npos) {
+    path = full.substr(0, q);
+    std::string query = full.substr(q + 1);
+    size_t start = 0;
+    while (start <= query.size()) {
+      size_t amp = query.find('&', start);
+      std::string pair = query.substr(start, amp == std::string::npos ? std::string::npos : amp - start);
+      if (!pair.empty()) {
+        size_t eq = pair.find('=');
+        std::string key = urlDecode(pair.substr(0, eq));
+        std::string value = eq == std::string::npos ? "" : urlDecode(pair.substr(eq + 1));
+        req.m_params.emplace_back(String(key), String(value));
+      }
+      if (amp == std::string::npos) break;
+      start = amp + 1;
+    }
+  }
+  for (const auto& h : headers) req.m_headers.emplace_back(String(h.first), String(h.second));
+  req.m_url = String(path);
+  req.m_method = method;
+  req.m_contentLength = body ? strlen(body) : 0;
+
+  const Route* match = nullptr;
+  for (const Route& route : server->m_routes) {
+    if ((route.method & method) && routeMatches(route.uri, req.m_url)) {
+      match = &route;
+      break;
+    }
+  }
+
+  if (match) {
+    size_t total = body ? strlen(body) : 0;
+    if (match->onBody && total > 0) {
+      std::vector<uint8_t> data(body, body + total);
+      for (size_t index = 0; index < total; index += g_bodyPiece) {
+        size_t len = total - index < g_bodyPiece ? total - index : g_bodyPiece;
+        match->onBody(&req, data.data() + index, len, index, total);
+      }
+    }
+    match->onRequest(&req);
+  } else if (server->m_notFound) {
+    server->m_notFound(&req);
+  } else {
+    req.send(404, "text/plain", "Not found");
+  }
+
+  HostHttpResponse out;
+  if (req.m_response) req.m_response->render(out);
+  free(req._tempObject);
+  return out;
+}
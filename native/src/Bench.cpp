@@ -0,0 +1,328 @@
+/**
+ * @file Bench.cpp
+ * @brief Host microbenchmarks for storage, docking and the serial console.
+ *
+ * Usage: program bench [--filter <substr>] [--budget <name>=<ns_per_op>]...
+ * Prints one JSON line per benchmark and exits non-zero if any benchmark
+ * exceeds its budget or gets a wrong result, so CI can flag regressions.
+ * Log lines from the code under test go to stderr, so stdout stays JSON.
+ */
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <WifiManager.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "Console.hpp"
+#include "CurrentBase.hpp"
+#include "Log.hpp"
+#include "Motion.hpp"
+#include "RfidReader.hpp"
+#include "SerialFrames.hpp"
+#include "StepperControl.hpp"
+#include "Storage.hpp"
+
+namespace {
+
+struct Budget {
+  std::string name;
+  double nsPerOp;
+};
+
+struct Context {
+  std::string filter;
+  std::vector<Budget> budgets;
+  bool failed = false;
+};
+
+// Lines beyond the log queue are dropped, as on the device.
+void drainLogs() {
+  char line[Log::kMaxLine + 1];
+  while (Log::pop(line)) fprintf(stderr, "%s\n", line);
+}
+
+template <typename Fn>
+void measure(Context& ctx, const char* name, uint32_t iterations, Fn&& fn) {
+  if (!ctx.filter.empty() && std::string(name).find(ctx.filter) == std::string::npos) return;
+
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < iterations; ++i) fn(i);
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  drainLogs();
+
+  double ns = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+  double nsPerOp = ns / iterations;
+  double opsPerSec = nsPerOp > 0 ? 1e9 / nsPerOp : 0;
+
+  const char* verdict = "ok";
+  for (const Budget& b : ctx.budgets) {
+    if (b.name == name && nsPerOp > b.nsPerOp) {
+      verdict = "over_budget";
+      ctx.failed = true;
+    }
+  }
+  printf("{\"bench\":\"%s\",\"iterations\":%u,\"ns_per_op\":%.1f,\"ops_per_sec\":%.0f,\"result\":\"%s\"}\n", name,
+         iterations, nsPerOp, opsPerSec, verdict);
+}
+
+constexpr uint32_t kBaseCount = 200;
+
+// For results a benchmark checks once it has run.
+void verify(Context& ctx, const char* name, bool ok, const char* what) {
+  if (!ctx.filter.empty() && std::string(name).find(ctx.filter) == std::string::npos) return;
+  if (ok) return;
+  ctx.failed = true;
+  printf("{\"bench\":\"%s\",\"result\":\"wrong\",\"check\":\"%s\"}\n", name, what);
+}
+
+// 7-byte UIDs, the common case for NTAG stickers.
+TagId rfidFor(uint32_t i) { return 0x04000010000000ull + i * 7919u; }
+
+bool sameInfo(const Storage::BaseInfo& a, const Storage::BaseInfo& b) {
+  return strcmp(a.paintName, b.paintName) == 0 && strcmp(a.recipeName, b.recipeName) == 0 &&
+         strcmp(a.recipeId, b.recipeId) == 0 && strcmp(a.notes, b.notes) == 0 &&
+         a.motion.withdrawUlPerSec == b.motion.withdrawUlPerSec &&
+         a.motion.dispenseUlPerSec == b.motion.dispenseUlPerSec &&
+         a.motion.accelUlPerSec2 == b.motion.accelUlPerSec2 && a.motion.dwellMs == b.motion.dwellMs;
+}
+
+// Every benchmark base loads back as `info`.
+bool allBasesMatch(const Storage::BaseInfo& info) {
+  for (uint32_t i = 0; i < kBaseCount; ++i) {
+    Storage::BaseInfo out;
+    if (!Storage::loadBase(rfidFor(i), out) || !sameInfo(out, info)) return false;
+  }
+  return true;
+}
+
+void benchStorage(Context& ctx) {
+  Storage::init();
+
+  Storage::BaseInfo info;
+  strlcpy(info.paintName, "Crimson Red", sizeof(info.paintName));
+  strlcpy(info.recipeName, "Warm Sunset Mix", sizeof(info.recipeName));
+  strlcpy(info.recipeId, "2024-05-A", sizeof(info.recipeId));
+  strlcpy(info.notes, "Thin with 5% medium before filling.", sizeof(info.notes));
+
+  // Saves wait for a commit; committing each one measures a save's full
+  // flash cost.
+  bool saved = true;
+  measure(ctx, "storage.saveBase", kBaseCount,
+          [&](uint32_t i) { saved &= Storage::saveBase(rfidFor(i), info) && Storage::flush(); });
+  verify(ctx, "storage.saveBase", saved && Storage::baseCount() >= kBaseCount, "every save accepted");
+  bool loaded = true;
+  measure(ctx, "storage.loadBase", kBaseCount * 5, [&](uint32_t i) {
+    Storage::BaseInfo out;
+    loaded &= Storage::loadBase(rfidFor(i % kBaseCount), out) && sameInfo(out, info);
+  });
+  verify(ctx, "storage.loadBase", loaded, "loaded record matches the saved one");
+  bool missed = true;
+  measure(ctx, "storage.loadBase.miss", kBaseCount * 5, [&](uint32_t i) {
+    Storage::BaseInfo out;
+    missed &= !Storage::loadBase(0x04F00000000000ull + i, out);
+  });
+  verify(ctx, "storage.loadBase.miss", missed, "unknown tag not found");
+  bool listed = true;
+  measure(ctx, "storage.listBaseIds", 50, [&](uint32_t) {
+    TagId ids[64];
+    size_t count = 0;
+    listed &= Storage::listBaseIds(ids, 64, count) && count == 64;
+    for (size_t i = 1; i < count; ++i) listed &= ids[i - 1] < ids[i];
+  });
+  verify(ctx, "storage.listBaseIds", listed, "full page in ascending order");
+  bool visited = true;
+  measure(ctx, "storage.visitBases.page", 50, [&](uint32_t) {
+    size_t seen = 0;
+    Storage::visitBases(0, 64,
+                        [](TagId, const Storage::BaseInfo&, void* n) {
+                          ++*static_cast<size_t*>(n);
+                          return true;
+                        },
+                        &seen);
+    visited &= seen == 64;
+  });
+  verify(ctx, "storage.visitBases.page", visited, "full page visited");
+  // Boot cost: one sequential scan of the record log rebuilds index and cache.
+  Storage::flush();
+  measure(ctx, "storage.init", 20, [](uint32_t) { Storage::init(); });
+  verify(ctx, "storage.init", allBasesMatch(info), "records survive a reopen");
+}
+
+// Collects encoded frames so they can be fed back in through Serial.inject().
+class FrameCapture : public Print {
+ public:
+  size_t write(uint8_t c) override {
+    bytes.push_back(static_cast<char>(c));
+    return 1;
+  }
+  using Print::write;
+  std::string bytes;
+};
+
+std::string encodeFrame(uint8_t type, const char* payload) {
+  FrameCapture out;
+  {
+    SerialFrames::FrameWriter frame(out, type, 1);
+    frame.print(payload);
+  }
+  return out.bytes;
+}
+
+// Finds the first frame of `type` in captured output and returns its
+// payload; log frames may come first.
+bool findFrame(const std::string& bytes, uint8_t type, std::string& payload) {
+  SerialFrames::FrameReader<512> reader;
+  for (char c : bytes) {
+    SerialFrames::Frame frame;
+    SerialFrames::ErrorCode error;
+    if (reader.push(static_cast<uint8_t>(c), frame, error) == decltype(reader)::Result::Ok && frame.type == type &&
+        frame.seq == 1) {
+      payload.assign(reinterpret_cast<const char*>(frame.payload), frame.len);
+      return true;
+    }
+  }
+  return false;
+}
+
+bool startsWith(const std::string& s, const char* prefix) { return s.compare(0, strlen(prefix), prefix) == 0; }
+
+// Runs `line` once more after its benchmark and checks the reply.
+bool replyStartsWith(const char* line, const char* prefix) {
+  Serial.takeOutput();
+  Console::handleLine(line);
+  return startsWith(Serial.takeOutput(), prefix);
+}
+
+// What the web task does with each tag the reader publishes.
+void dock(TagId tag) {
+  CurrentBase::load(tag);
+  CurrentBase::Slot slot = CurrentBase::get();
+  Motion::useBaseProfile(slot.known ? &slot.info.motion : nullptr);
+}
+
+// Dock a base with its own motion profile, then undock it: the global
+// profile has to come back for manual jogs and untagged use.
+void benchDocking(Context& ctx, StepperControl& stepper) {
+  Motion::begin(stepper);
+  Motion::loadCalibration();
+  Motion::setStepsPerMicroliter(100.0f);
+  Motion::setProfile(2000, 8000);
+
+  const TagId tag = rfidFor(kBaseCount + 1);
+  Storage::BaseInfo info;
+  strlcpy(info.paintName, "Slow Base", sizeof(info.paintName));
+  info.motion.withdrawUlPerSec = 5.0f;
+  info.motion.dispenseUlPerSec = 25.0f;
+  info.motion.accelUlPerSec2 = 20.0f;
+  info.motion.dwellMs = 400;
+  Storage::saveBase(tag, info);
+
+  dock(tag);
+  verify(ctx, "motion.dock", stepper.speedLimit(true) == 500 && stepper.speedLimit(false) == 2500 &&
+                                 stepper.acceleration() == 2000 && Motion::settleMs() == 400,
+         "base profile applied");
+  dock(0);
+  verify(ctx, "motion.dock", stepper.speedLimit(true) == 2000 && stepper.speedLimit(false) == 2000 &&
+                                 stepper.maxSpeed() == 2000 && stepper.acceleration() == 8000 &&
+                                 Motion::settleMs() == 0,
+         "global profile restored");
+
+  measure(ctx, "motion.dock", 2000, [&](uint32_t i) { dock(i % 2 ? 0 : tag); });
+  Storage::deleteBase(tag);
+}
+
+void benchConsole(Context& ctx, StepperControl& stepper) {
+  static Shared::WifiManager wifi;
+  static RfidReader rfid;
+  Console::begin(wifi, rfid, stepper);
+
+  Serial.setEcho(false);
+  measure(ctx, "console.rfid.status", 20000, [](uint32_t) { Console::handleLine("rfid.status"); });
+  verify(ctx, "console.rfid.status",
+         replyStartsWith("rfid.status", "{\"cmd\":\"rfid.status\",\"status\":\"ok\",\"data\":{\"tag\":"), "reply");
+  measure(ctx, "console.motion.profile", 20000, [](uint32_t) { Console::handleLine("motion.profile"); });
+  verify(ctx, "console.motion.profile",
+         replyStartsWith("motion.profile",
+                         "{\"cmd\":\"motion.profile\",\"status\":\"ok\",\"data\":{\"max_steps_per_sec\":"),
+         "reply");
+  measure(ctx, "console.unknown", 20000, [](uint32_t) { Console::handleLine("no.such.command arg"); });
+  verify(ctx, "console.unknown",
+         replyStartsWith("no.such.command arg",
+                         "{\"cmd\":\"no.such.command\",\"status\":\"error\",\"message\":\"unknown command\"}\r\n"),
+         "reply");
+  measure(ctx, "console.readLine", 20000, [](uint32_t) {
+    Serial.inject("rfid.status\n");
+    Console::poll();
+  });
+  Serial.takeOutput();
+  Serial.inject("rfid.status\n");
+  Console::poll();
+  verify(ctx, "console.readLine", startsWith(Serial.takeOutput(), "{\"cmd\":\"rfid.status\",\"status\":\"ok\""),
+         "reply");
+
+  // Binary mode: one decoded, dispatched and re-encoded frame per iteration.
+  Serial.inject("proto.binary\n");
+  Console::poll();
+  static const std::string ping = encodeFrame(SerialFrames::Ping, "");
+  static const std::string status = encodeFrame(SerialFrames::Command, "rfid.status");
+  measure(ctx, "console.frame.ping", 20000, [](uint32_t) {
+    Serial.inject(ping.data(), ping.size());
+    Console::poll();
+  });
+  std::string payload;
+  Serial.takeOutput();
+  Serial.inject(ping.data(), ping.size());
+  Console::poll();
+  verify(ctx, "console.frame.ping", findFrame(Serial.takeOutput(), SerialFrames::Pong, payload) && payload.size() == 4,
+         "pong frame");
+  measure(ctx, "console.frame.rfid.status", 20000, [](uint32_t) {
+    Serial.inject(status.data(), status.size());
+    Console::poll();
+  });
+  Serial.takeOutput();
+  Serial.inject(status.data(), status.size());
+  Console::poll();
+  verify(ctx, "console.frame.rfid.status",
+         findFrame(Serial.takeOutput(), SerialFrames::CommandReply, payload) &&
+             startsWith(payload, "{\"cmd\":\"rfid.status\",\"status\":\"ok\""),
+         "reply frame");
+  static const std::string text = encodeFrame(SerialFrames::Command, "proto.text");
+  Serial.inject(text.data(), text.size());
+  Console::poll();
+  Serial.takeOutput();
+  Serial.setEcho(true);
+}
+
+}  // namespace
+
+namespace HostBench {
+
+int run(int argc, char** argv) {
+  Context ctx;
+  for (int i = 0; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--filter" && i + 1 < argc) {
+      ctx.filter = argv[++i];
+    } else if (arg == "--budget" && i + 1 < argc) {
+      std::string spec = argv[++i];
+      size_t eq = spec.find('=');
+      if (eq == std::string::npos) continue;
+      ctx.budgets.push_back({spec.substr(0, eq), strtod(spec.c_str() + eq + 1, nullptr)});
+    }
+  }
+
+  // Queue log lines instead of writing them to stdout; see drainLogs().
+  Log::attach();
+  static StepperControl stepper;
+  stepper.begin();
+  benchStorage(ctx);
+  benchDocking(ctx, stepper);
+  benchConsole(ctx, stepper);
+  drainLogs();
+  return ctx.failed ? 1 : 0;
+}
+
+}  // namespace HostBench
@@ -0,0 +1,99 @@
+/**
+ * @file FreeRtosHost.cpp
+ * @brief Host implementation of the FreeRTOS stand-in. Tasks run on detached
+ *        std::threads; priorities are recorded but not enforced.
+ */
+#include <Arduino.h>
+
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+struct HostTask {
+  TaskFunction_t fn;
+  void* arg;
+  UBaseType_t priority;
+};
+
+struct HostSemaphore {
+  std::recursive_timed_mutex mutex;
+};
+
+namespace {
+// Stands in for "interrupts disabled": ISRs and critical sections all take it.
+std::recursive_mutex g_criticalMutex;
+
+struct TaskExit {};
+
+void runTask(HostTask* task) {
+  try {
+    task->fn(task->arg);
+  } catch (const TaskExit&) {
+  }
+  delete task;
+}
+}  // namespace
+
+void vPortEnterCritical(portMUX_TYPE* mux) {
+  g_criticalMutex.lock();
+  ++mux->count;
+}
+
+void vPortExitCritical(portMUX_TYPE* mux) {
+  --mux->count;
+  g_criticalMutex.unlock();
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char* name, uint32_t stackDepth, void* arg,
+                                   UBaseType_t priority, TaskHandle_t* handle, BaseType_t core) {
+  (void)name;
+  (void)stackDepth;
+  (void)core;
+  HostTask* task = new HostTask{fn, arg, priority};
+  if (handle) *handle = task;
+  std::thread(runTask, task).detach();
+  return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char* name, uint32_t stackDepth, void* arg,
+                       UBaseType_t priority, TaskHandle_t* handle) {
+  return xTaskCreatePinnedToCore(fn, name, stackDepth, arg, priority, handle, tskNO_AFFINITY);
+}
+
+void vTaskDelete(TaskHandle_t task) {
+  // Only self-deletion is supported, which is all the firmware does.
+  if (task == nullptr) throw TaskExit{};
+}
+
+void vTaskDelay(TickType_t ticks) { delay(ticks * portTICK_PERIOD_MS); }
+
+void vTaskDelayUntil(TickType_t* previousWake, TickType_t period) {
+  TickType_t wake = *previousWake + period;
+  TickType_t now = xTaskGetTickCount();
+  if (static_cast<int32_t>(wake - now) > 0) vTaskDelay(wake - now);
+  *previousWake = wake;
+}
+
+TickType_t xTaskGetTickCount() { return millis() / portTICK_PERIOD_MS; }
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task) {
+  (void)task;
+  return 0;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex() { return new HostSemaphore(); }
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks) {
+  if (ticks == portMAX_DELAY) {
+    sem->mutex.lock();
+    return pdTRUE;
+  }
+  return sem->mutex.try_lock_for(std::chrono::milliseconds(ticks * portTICK_PERIOD_MS)) ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem) {
+  sem->mutex.unlock();
+  return pdTRUE;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t sem) { delete sem; }
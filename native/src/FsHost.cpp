@@ -0,0 +1,204 @@
+/**
+ * @file FsHost.cpp
+ * @brief Host implementation of the LittleFS stand-in, mapping flash paths
+ *        onto a host directory.
+ */
+#include <LittleFS.h>
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+LittleFSFS LittleFS;
+
+namespace {
+std::string g_root;
+uint32_t g_opens = 0;
+uint64_t g_bytesWritten = 0;
+
+const std::string& rootDir() {
+  if (g_root.empty()) {
+    const char* tmp = getenv("TMPDIR");
+    std::string templ = std::string(tmp ? tmp : "/tmp") + "/littlefs-XXXXXX";
+    std::vector<char> buf(templ.begin(), templ.end());
+    buf.push_back('\0');
+    if (mkdtemp(buf.data())) g_root = buf.data();
+  }
+  return g_root;
+}
+
+std::string hostPath(const char* path) {
+  std::string p = rootDir();
+  if (!path || path[0] != '/') p += '/';
+  if (path) p += path;
+  return p;
+}
+
+const char* baseName(const std::string& path) {
+  size_t slash = path.rfind('/');
+  return path.c_str() + (slash == std::string::npos ? 0 : slash + 1);
+}
+}  // namespace
+
+namespace fs {
+
+struct FileImpl {
+  std::string path;  // flash path, e.g. "/bases/0000ABCD.json"
+  FILE* fp = nullptr;
+  DIR* dir = nullptr;
+
+  ~FileImpl() {
+    if (fp) fclose(fp);
+    if (dir) closedir(dir);
+  }
+};
+
+size_t File::write(uint8_t c) { return write(&c, 1); }
+
+size_t File::write(const uint8_t* buf, size_t size) {
+  if (!m_impl || !m_impl->fp) return 0;
+  size_t n = fwrite(buf, 1, size, m_impl->fp);
+  g_bytesWritten += n;
+  return n;
+}
+
+int File::available() {
+  if (!m_impl || !m_impl->fp) return 0;
+  long pos = ftell(m_impl->fp);
+  long total = static_cast<long>(size());
+  return total > pos ? static_cast<int>(total - pos) : 0;
+}
+
+int File::read() {
+  if (!m_impl || !m_impl->fp) return -1;
+  int c = fgetc(m_impl->fp);
+  return c == EOF ? -1 : c;
+}
+
+int File::peek() {
+  if (!m_impl || !m_impl->fp) return -1;
+  int c = fgetc(m_impl->fp);
+  if (c == EOF) return -1;
+  ungetc(c, m_impl->fp);
+  return c;
+}
+
+void File::flush() {
+  if (m_impl && m_impl->fp) fflush(m_impl->fp);
+}
+
+size_t File::read(uint8_t* buf, size_t size) {
+  if (!m_impl || !m_impl->fp) return 0;
+  return fread(buf, 1, size, m_impl->fp);
+}
+
+bool File::seek(uint32_t pos, SeekMode mode) {
+  if (!m_impl || !m_impl->fp) return false;
+  int whence = mode == SeekSet ? SEEK_SET : (mode == SeekCur ? SEEK_CUR : SEEK_END);
+  return fseek(m_impl->fp, static_cast<long>(pos), whence) == 0;
+}
+
+size_t File::position() const {
+  if (!m_impl || !m_impl->fp) return 0;
+  return static_cast<size_t>(ftell(m_impl->fp));
+}
+
+size_t File::size() const {
+  if (!m_impl || !m_impl->fp) return 0;
+  fflush(m_impl->fp);
+  struct stat st;
+  if (fstat(fileno(m_impl->fp), &st) != 0) return 0;
+  return static_cast<size_t>(st.st_size);
+}
+
+void File::close() { m_impl.reset(); }
+
+File::operator bool() const { return m_impl && (m_impl->fp || m_impl->dir); }
+
+const char* File::name() const { return m_impl ? baseName(m_impl->path) : ""; }
+
+const char* File::path() const { return m_impl ? m_impl->path.c_str() : ""; }
+
+bool File::isDirectory() const { return m_impl && m_impl->dir; }
+
+File File::openNextFile(const char* mode) {
+  if (!m_impl || !m_impl->dir) return File();
+  while (dirent* entry = readdir(m_impl->dir)) {
+    if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+    std::string child = m_impl->path;
+    if (child.empty() || child.back() != '/') child += '/';
+    child += entry->d_name;
+    return LittleFS.open(child.c_str(), mode);
+  }
+  return File();
+}
+
+File FS::open(const char* path, const char* mode, bool create) {
+  (void)create;
+  ++g_opens;
+  auto impl = std::make_shared<FileImpl>();
+  impl->path = path;
+  std::string host = hostPath(path);
+
+  struct stat st;
+  if (stat(host.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) {
+    impl->dir = opendir(host.c_str());
+    return impl->dir ? File(impl) : File();
+  }
+
+  std::string m = mode ? mode : "r";
+  if (m.find('b') == std::string::npos) m += 'b';
+  impl->fp = fopen(host.c_str(), m.c_str());
+  return impl->fp ? File(impl) : File();
+}
+
+bool FS::exists(const char* path) {
+  struct stat st;
+  return stat(hostPath(path).c_str(), &st) == 0;
+}
+
+bool FS::remove(const char* path) { return ::unlink(hostPath(path).c_str()) == 0; }
+
+bool FS::rename(const char* from, const char* to) {
+  return ::rename(hostPath(from).c_str(), hostPath(to).c_str()) == 0;
+}
+
+bool FS::mkdir(const char* path) {
+  std::string host = hostPath(path);
+  return ::mkdir(host.c_str(), 0755) == 0 || errno == EEXIST;
+}
+
+bool FS::rmdir(const char* path) { return ::rmdir(hostPath(path).c_str()) == 0; }
+
+}  // namespace fs
+
+bool LittleFSFS::begin(bool formatOnFail, const char* basePath, uint8_t maxOpenFiles, const char* partitionLabel) {
+  (void)formatOnFail;
+  (void)basePath;
+  (void)maxOpenFiles;
+  (void)partitionLabel;
+  return !rootDir().empty();
+}
+
+size_t LittleFSFS::totalBytes() { return 1536 * 1024; }
+
+size_t LittleFSFS::usedBytes() { return 0; }
+
+namespace HostFs {
+void setRoot(const char* dir) {
+  g_root = dir;
+  ::mkdir(g_root.c_str(), 0755);
+}
+const char* root() { return rootDir().c_str(); }
+void resetCounters() {
+  g_opens = 0;
+  g_bytesWritten = 0;
+}
+uint32_t opens() { return g_opens; }
+uint64_t bytesWritten() { return g_bytesWritten; }
+}  // namespace HostFs
@@ -0,0 +1,45 @@
+/**
+ * @file HostMain.cpp
+ * @brief Entry point for the host-native build.
+ *
+ * Without arguments the firmware boots as on the device and stdin is fed to
+ * the serial console. "bench" runs the microbenchmarks instead (see Bench.cpp)
+ * and "sim" the step timing simulator (see MotionSim.cpp).
+ */
+#include <Arduino.h>
+
+#include <cstring>
+#include <iostream>
+#include <string>
+
+void setup();
+
+namespace HostBench {
+int run(int argc, char** argv);
+}
+
+namespace HostSim {
+int run(int argc, char** argv);
+}
+
+// Each suite under test/ brings its own main().
+#ifndef PIO_UNIT_TESTING
+int main(int argc, char** argv) {
+  if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+    return HostBench::run(argc - 2, argv + 2);
+  }
+  if (argc > 1 && strcmp(argv[1], "sim") == 0) {
+    return HostSim::run(argc - 2, argv + 2);
+  }
+
+  setup();
+  std::string line;
+  while (std::getline(std::cin, line)) {
+    line += '\n';
+    Serial.inject(line.c_str());
+  }
+  // Give the console task time to drain what is left.
+  delay(500);
+  return 0;
+}
+#endif
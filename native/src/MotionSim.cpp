@@ -0,0 +1,347 @@
+/**
+ * @file MotionSim.cpp
+ * @brief Virtual-time step timing simulator for StepperControl.
+ *
+ * Usage: program sim [--strategy isr|polled] [--phase <name>=<period_us>:<duration_us>[:mask]]...
+ *                    [--steps <n>] [--moves <n>] [--speed <steps/s>] [--accel <steps/s^2>]
+ *                    [--isr-latency-us <n>] [--miss-us <n>] [--max-ms <n>] [--trace <csv>]
+ *                    [--max-jitter-us <n>] [--max-missed <n>]
+ *
+ * Runs the real StepperControl ISR on the virtual clock twice: once
+ * undisturbed, to get the reference step times, and once with the step alarm
+ * held off by the configured blocking phases. The default phases stand in for
+ * the firmware's tasks (RFID poll, HTTP handling, console, a flash append).
+ *
+ * - isr: the step alarm preempts every task, so only phases marked "mask"
+ *   (interrupts or flash cache disabled) hold it off. This is the firmware.
+ * - polled: steps are serviced only between phases, as a superloop would.
+ *
+ * Every rising STEP edge is recorded. Jitter is the difference between each
+ * step interval and the reference interval; an interval longer than the
+ * reference by more than --miss-us counts as missed. Prints one JSON line and
+ * exits non-zero when --max-jitter-us or --max-missed is exceeded.
+ *
+ * The pulse backend is fixed at build time; rebuild with
+ * -DSTEPPER_PULSE_RMT=0 to simulate the GPIO fallback.
+ */
+#include <Arduino.h>
+#include <driver/rmt.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "Pins.hpp"
+#include "StepPulse.hpp"
+#include "StepperControl.hpp"
+
+namespace {
+
+struct Phase {
+  std::string name;
+  uint32_t periodUs;
+  uint32_t durationUs;
+  bool masksIrq;
+};
+
+// Rough costs on the ESP32-C3: a PN532 poll over 400 kHz I2C, an
+// AsyncWebServer request with a JSON body, a console line, and the one-record
+// append a new base or a delete writes at once (with the flash cache off).
+// Batched commits and compaction wait for the plunger to stop, so they are
+// not modelled; add them with --phase flash=1000000:15000:mask.
+const Phase kDefaultPhases[] = {
+    {"rfid", 5000, 1800, false},
+    {"web", 10000, 2500, false},
+    {"console", 5000, 200, false},
+    {"flash", 1000000, 3000, true},
+};
+
+struct Options {
+  bool polled = false;
+  std::vector<Phase> phases{std::begin(kDefaultPhases), std::end(kDefaultPhases)};
+  uint32_t steps = 20000;
+  uint32_t moves = 2;
+  uint32_t speed = 0;
+  uint32_t accel = 0;
+  uint32_t isrLatencyUs = 2;
+  uint32_t missUs = 25;
+  uint32_t maxMs = 60000;
+  std::string trace;
+  double maxJitterUs = -1;
+  long maxMissed = -1;
+};
+
+struct Window {
+  uint64_t start;
+  uint64_t end;
+};
+
+struct Run {
+  std::vector<uint64_t> edges;
+  uint64_t heldOffUs = 0;
+  uint32_t lateServices = 0;
+  uint32_t trains = 0;
+  bool finished = false;
+};
+
+std::vector<uint64_t>* g_edges = nullptr;
+
+void recordEdge(uint64_t atUs) {
+  if (g_edges) g_edges->push_back(atUs);
+}
+
+void onRmtEdge(int pin, uint64_t atUs) {
+  if (pin == Pins::STEPPER_STEP) recordEdge(atUs);
+}
+
+void onGpioWrite(int pin, uint8_t level) {
+  if (pin == Pins::STEPPER_STEP && level == HIGH) recordEdge(HostClock::now());
+}
+
+bool parsePhase(const std::string& spec, Phase& out) {
+  size_t eq = spec.find('=');
+  if (eq == std::string::npos || eq == 0) return false;
+  out.name = spec.substr(0, eq);
+  const char* p = spec.c_str() + eq + 1;
+  char* end = nullptr;
+  out.periodUs = strtoul(p, &end, 10);
+  if (*end != ':') return false;
+  out.durationUs = strtoul(end + 1, &end, 10);
+  out.masksIrq = strcmp(end, ":mask") == 0;
+  return out.periodUs != 0 && (*end == '\0' || out.masksIrq);
+}
+
+void setPhase(Options& opts, const Phase& phase) {
+  auto it = std::find_if(opts.phases.begin(), opts.phases.end(),
+                         [&](const Phase& p) { return p.name == phase.name; });
+  if (it != opts.phases.end()) opts.phases.erase(it);
+  if (phase.durationUs != 0) opts.phases.push_back(phase);
+}
+
+// Lays the phases out on one core from `t0`: each is released every period
+// and runs for its duration, after whatever was already running. Only the
+// phases that can hold off the step alarm under the strategy are kept.
+std::vector<Window> holdOffWindows(const Options& opts, uint64_t t0, uint64_t horizon) {
+  struct Release {
+    uint64_t at;
+    size_t phase;
+  };
+  std::vector<Release> releases;
+  for (size_t i = 0; i < opts.phases.size(); ++i) {
+    const Phase& p = opts.phases[i];
+    if (!opts.polled && !p.masksIrq) continue;
+    for (uint64_t at = t0 + p.periodUs; at < horizon; at += p.periodUs) releases.push_back({at, i});
+  }
+  std::stable_sort(releases.begin(), releases.end(), [](const Release& a, const Release& b) { return a.at < b.at; });
+
+  std::vector<Window> windows;
+  uint64_t cursor = 0;
+  for (const Release& r : releases) {
+    uint64_t start = std::max(r.at, cursor);
+    cursor = start + opts.phases[r.phase].durationUs;
+    if (!windows.empty() && windows.back().end == start) {
+      windows.back().end = cursor;
+    } else {
+      windows.push_back({start, cursor});
+    }
+  }
+  return windows;
+}
+
+// Earliest time an alarm due at `due` gets serviced.
+uint64_t serviceAt(const std::vector<Window>& windows, size_t& next, uint64_t due) {
+  while (next < windows.size() && windows[next].end <= due) ++next;
+  if (next < windows.size() && windows[next].start <= due) return windows[next].end;
+  return due;
+}
+
+Run simulate(StepperControl& stepper, const Options& opts, bool disturbed) {
+  Run run;
+  g_edges = &run.edges;
+
+  // Start on an idle tick so both runs see the same alarm phase.
+  HostTimer::runUntil(HostTimer::nextDue());
+  uint64_t t0 = HostClock::now();
+  uint64_t horizon = t0 + static_cast<uint64_t>(opts.maxMs) * 1000;
+  std::vector<Window> windows;
+  if (disturbed) windows = holdOffWindows(opts, t0, horizon);
+  uint32_t latencyUs = disturbed ? opts.isrLatencyUs : 0;
+  uint32_t trainsBefore = HostRmt::trains();
+
+  size_t window = 0;
+  uint32_t queued = 0;
+  for (;;) {
+    // Feed moves as the queue drains, as Job does; alternate directions.
+    while (queued < opts.moves && stepper.queuedMoves() < StepperControl::kMoveQueueLength) {
+      int32_t steps = static_cast<int32_t>(opts.steps);
+      stepper.queueMove(queued % 2 == 0 ? steps : -steps);
+      ++queued;
+    }
+    if (queued == opts.moves && stepper.queuedMoves() == 0 && !stepper.isMoving() && !run.edges.empty()) {
+      run.finished = true;
+      break;
+    }
+
+    uint64_t due = HostTimer::nextDue();
+    if (due == UINT64_MAX || due >= horizon) break;
+    uint64_t at = serviceAt(windows, window, due);
+    if (at != due) {
+      run.heldOffUs += at - due;
+      ++run.lateServices;
+    }
+    at = std::max(at + latencyUs, HostClock::now());
+    HostClock::set(at);
+    HostTimer::runUntil(at);
+  }
+
+  run.trains = HostRmt::trains() - trainsBefore;
+  g_edges = nullptr;
+  return run;
+}
+
+double percentile(const std::vector<double>& sorted, double p) {
+  if (sorted.empty()) return 0;
+  size_t i = static_cast<size_t>(std::ceil(p * sorted.size()));
+  return sorted[std::min(sorted.size(), std::max<size_t>(i, 1)) - 1];
+}
+
+double ratePerSec(const std::vector<uint64_t>& edges) {
+  if (edges.size() < 2) return 0;
+  return (edges.size() - 1) * 1e6 / static_cast<double>(edges.back() - edges.front());
+}
+
+bool writeTrace(const std::string& path, const Run& ideal, const Run& actual) {
+  FILE* f = fopen(path.c_str(), "w");
+  if (!f) return false;
+  fprintf(f, "step,ideal_us,actual_us\n");
+  size_t n = std::max(ideal.edges.size(), actual.edges.size());
+  for (size_t i = 0; i < n; ++i) {
+    fprintf(f, "%zu,", i);
+    if (i < ideal.edges.size()) fprintf(f, "%llu", static_cast<unsigned long long>(ideal.edges[i] - ideal.edges[0]));
+    fputc(',', f);
+    if (i < actual.edges.size()) fprintf(f, "%llu", static_cast<unsigned long long>(actual.edges[i] - actual.edges[0]));
+    fputc('\n', f);
+  }
+  fclose(f);
+  return true;
+}
+
+}  // namespace
+
+namespace HostSim {
+
+int run(int argc, char** argv) {
+  Options opts;
+  for (int i = 0; i < argc; ++i) {
+    std::string arg = argv[i];
+    const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+    if (!value) {
+      fprintf(stderr, "sim: %s needs a value\n", arg.c_str());
+      return 2;
+    }
+    ++i;
+    if (arg == "--strategy") {
+      opts.polled = strcmp(value, "polled") == 0;
+      if (!opts.polled && strcmp(value, "isr") != 0) {
+        fprintf(stderr, "sim: unknown strategy %s\n", value);
+        return 2;
+      }
+    } else if (arg == "--phase") {
+      Phase phase;
+      if (!parsePhase(value, phase)) {
+        fprintf(stderr, "sim: bad phase %s (want name=period_us:duration_us[:mask])\n", value);
+        return 2;
+      }
+      setPhase(opts, phase);
+    } else if (arg == "--steps") {
+      opts.steps = strtoul(value, nullptr, 10);
+    } else if (arg == "--moves") {
+      opts.moves = strtoul(value, nullptr, 10);
+    } else if (arg == "--speed") {
+      opts.speed = strtoul(value, nullptr, 10);
+    } else if (arg == "--accel") {
+      opts.accel = strtoul(value, nullptr, 10);
+    } else if (arg == "--isr-latency-us") {
+      opts.isrLatencyUs = strtoul(value, nullptr, 10);
+    } else if (arg == "--miss-us") {
+      opts.missUs = strtoul(value, nullptr, 10);
+    } else if (arg == "--max-ms") {
+      opts.maxMs = strtoul(value, nullptr, 10);
+    } else if (arg == "--trace") {
+      opts.trace = value;
+    } else if (arg == "--max-jitter-us") {
+      opts.maxJitterUs = strtod(value, nullptr);
+    } else if (arg == "--max-missed") {
+      opts.maxMissed = strtol(value, nullptr, 10);
+    } else {
+      fprintf(stderr, "sim: unknown option %s\n", arg.c_str());
+      return 2;
+    }
+  }
+  if (opts.steps == 0 || opts.steps > INT32_MAX || opts.moves == 0) {
+    fprintf(stderr, "sim: --steps and --moves must be positive\n");
+    return 2;
+  }
+
+  HostClock::useVirtual(true);
+  HostRmt::setEdgeHook(onRmtEdge);
+  HostGpio::setWriteHook(onGpioWrite);
+
+  static StepperControl stepper;
+  if (!stepper.begin()) return 1;
+  if (opts.speed || opts.accel) {
+    uint32_t speed = opts.speed ? opts.speed : stepper.maxSpeed();
+    stepper.setProfile(speed, opts.accel ? opts.accel : stepper.acceleration());
+    stepper.setSpeed(speed);
+  }
+
+  Run ideal = simulate(stepper, opts, false);
+  stepper.setPosition(0);
+  Run actual = simulate(stepper, opts, true);
+
+  // Compare interval by interval; both runs emit the same step sequence.
+  std::vector<double> jitter;
+  uint32_t missed = 0;
+  double sum = 0;
+  size_t n = std::min(ideal.edges.size(), actual.edges.size());
+  for (size_t i = 1; i < n; ++i) {
+    int64_t want = static_cast<int64_t>(ideal.edges[i] - ideal.edges[i - 1]);
+    int64_t got = static_cast<int64_t>(actual.edges[i] - actual.edges[i - 1]);
+    if (got - want > static_cast<int64_t>(opts.missUs)) ++missed;
+    double err = std::fabs(static_cast<double>(got - want));
+    jitter.push_back(err);
+    sum += err;
+  }
+  std::sort(jitter.begin(), jitter.end());
+  double maxJitter = jitter.empty() ? 0 : jitter.back();
+
+  bool over = (opts.maxJitterUs >= 0 && maxJitter > opts.maxJitterUs) ||
+              (opts.maxMissed >= 0 && missed > static_cast<unsigned long>(opts.maxMissed));
+  bool complete = ideal.finished && actual.finished && ideal.edges.size() == actual.edges.size();
+  const char* verdict = !complete ? "incomplete" : over ? "over_budget" : "ok";
+
+  auto durationMs = [](const Run& r) {
+    return r.edges.size() < 2 ? 0.0 : (r.edges.back() - r.edges.front()) / 1000.0;
+  };
+  printf(
+      "{\"sim\":\"%s\",\"pulse\":\"%s\",\"steps\":%zu,\"expected_steps\":%zu,\"trains\":%u,"
+      "\"jitter_us\":{\"mean\":%.2f,\"p50\":%.0f,\"p99\":%.0f,\"max\":%.0f},"
+      "\"missed_intervals\":%u,\"miss_threshold_us\":%u,\"late_services\":%u,\"held_off_us\":%llu,"
+      "\"achieved_steps_per_sec\":%.1f,\"expected_steps_per_sec\":%.1f,"
+      "\"duration_ms\":%.3f,\"expected_duration_ms\":%.3f,\"result\":\"%s\"}\n",
+      opts.polled ? "polled" : "isr", StepPulse::name(), actual.edges.size(), ideal.edges.size(), actual.trains,
+      jitter.empty() ? 0.0 : sum / jitter.size(), percentile(jitter, 0.5), percentile(jitter, 0.99), maxJitter,
+      missed, opts.missUs, actual.lateServices, static_cast<unsigned long long>(actual.heldOffUs),
+      ratePerSec(actual.edges), ratePerSec(ideal.edges), durationMs(actual), durationMs(ideal), verdict);
+
+  if (!opts.trace.empty() && !writeTrace(opts.trace, ideal, actual)) {
+    fprintf(stderr, "sim: cannot write %s\n", opts.trace.c_str());
+    return 1;
+  }
+  return complete && !over ? 0 : 1;
+}
+
+}  // namespace HostSim
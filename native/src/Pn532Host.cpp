@@ -0,0 +1,84 @@
+/**
+ * @file Pn532Host.cpp
+ * @brief Host implementation of the PN532 and I2C stand-ins.
+ */
+#include <Adafruit_PN532.h>
+
+TwoWire Wire;
+
+namespace {
+uint8_t g_uid[10] = {0};
+uint8_t g_uidLen = 0;
+uint32_t g_callCostUs = 0;
+
+void chargeCallCost() {
+  if (g_callCostUs) delayMicroseconds(g_callCostUs);
+}
+}  // namespace
+
+namespace HostPn532 {
+void present(const uint8_t* uid, uint8_t len) {
+  g_uidLen = len > sizeof(g_uid) ? sizeof(g_uid) : len;
+  memcpy(g_uid, uid, g_uidLen);
+}
+void remove() { g_uidLen = 0; }
+void setCallCostUs(uint32_t us) { g_callCostUs = us; }
+}  // namespace HostPn532
+
+Adafruit_PN532::Adafruit_PN532(uint8_t irq, uint8_t reset, TwoWire* theWire) : m_irq(irq) {
+  (void)reset;
+  (void)theWire;
+}
+
+bool Adafruit_PN532::begin() {
+  pinMode(m_irq, INPUT_PULLUP);
+  return true;
+}
+
+uint32_t Adafruit_PN532::getFirmwareVersion() {
+  chargeCallCost();
+  return 0x32010607;
+}
+
+bool Adafruit_PN532::SAMConfig() {
+  chargeCallCost();
+  return true;
+}
+
+bool Adafruit_PN532::setPassiveActivationRetries(uint8_t maxRetries) {
+  (void)maxRetries;
+  chargeCallCost();
+  return true;
+}
+
+bool Adafruit_PN532::readPassiveTargetID(uint8_t cardbaudrate, uint8_t* uid, uint8_t* uidLength, uint16_t timeout) {
+  (void)cardbaudrate;
+  chargeCallCost();
+  if (g_uidLen == 0) {
+    if (timeout) delay(timeout);
+    return false;
+  }
+  memcpy(uid, g_uid, g_uidLen);
+  *uidLength = g_uidLen;
+  return true;
+}
+
+bool Adafruit_PN532::startPassiveTargetIDDetection(uint8_t cardbaudrate) {
+  (void)cardbaudrate;
+  chargeCallCost();
+  m_detecting = true;
+  // Retries are capped, so the PN532 answers (and drops IRQ) either way.
+  HostGpio::setInput(m_irq, LOW);
+  return true;
+}
+
+bool Adafruit_PN532::readDetectedPassiveTargetID(uint8_t* uid, uint8_t* uidLength) {
+  chargeCallCost();
+  HostGpio::setInput(m_irq, HIGH);
+  if (!m_detecting) return false;
+  m_detecting = false;
+  if (g_uidLen == 0) return false;
+  memcpy(uid, g_uid, g_uidLen);
+  *uidLength = g_uidLen;
+  return true;
+}
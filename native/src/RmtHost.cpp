@@ -0,0 +1,76 @@
+/**
+ * @file RmtHost.cpp
+ * @brief Host implementation of the RMT TX stand-in.
+ */
+#include <driver/rmt.h>
+
+namespace {
+
+struct Channel {
+  int pin = -1;
+  bool configured = false;
+  rmt_item32_t mem[kHostRmtMemWords] = {};
+};
+
+Channel g_channels[RMT_CHANNEL_MAX];
+void (*g_edgeHook)(int, uint64_t) = nullptr;
+uint32_t g_trains = 0;
+uint32_t g_edges = 0;
+
+bool validChannel(rmt_channel_t channel) { return channel >= RMT_CHANNEL_0 && channel < RMT_CHANNEL_MAX; }
+
+}  // namespace
+
+esp_err_t rmt_config(const rmt_config_t* config) {
+  if (!config || !validChannel(config->channel)) return ESP_ERR_INVALID_ARG;
+  Channel& ch = g_channels[config->channel];
+  ch.pin = config->gpio_num;
+  ch.configured = true;
+  pinMode(ch.pin, OUTPUT);
+  return ESP_OK;
+}
+
+esp_err_t rmt_driver_install(rmt_channel_t channel, size_t rx_buf_size, int intr_alloc_flags) {
+  (void)rx_buf_size;
+  (void)intr_alloc_flags;
+  return validChannel(channel) && g_channels[channel].configured ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t rmt_fill_tx_items(rmt_channel_t channel, const rmt_item32_t* item, uint16_t item_num, uint16_t mem_offset) {
+  if (!validChannel(channel) || !item || item_num == 0 || mem_offset + item_num > kHostRmtMemWords) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  for (uint16_t i = 0; i < item_num; ++i) g_channels[channel].mem[mem_offset + i] = item[i];
+  return ESP_OK;
+}
+
+// Plays from the start of the channel's memory up to the first zero
+// duration, as the peripheral does. The line is assumed low at the start.
+esp_err_t rmt_tx_start(rmt_channel_t channel, bool tx_idx_rst) {
+  (void)tx_idx_rst;
+  if (!validChannel(channel) || !g_channels[channel].configured) return ESP_ERR_INVALID_ARG;
+  const Channel& ch = g_channels[channel];
+  ++g_trains;
+  uint64_t at = HostClock::now();
+  uint8_t level = LOW;
+  for (const rmt_item32_t& item : ch.mem) {
+    const uint32_t durations[2] = {item.duration0, item.duration1};
+    const uint8_t levels[2] = {static_cast<uint8_t>(item.level0), static_cast<uint8_t>(item.level1)};
+    for (int half = 0; half < 2; ++half) {
+      if (durations[half] == 0) return ESP_OK;
+      if (levels[half] == HIGH && level == LOW) {
+        ++g_edges;
+        if (g_edgeHook) g_edgeHook(ch.pin, at);
+      }
+      level = levels[half];
+      at += durations[half];
+    }
+  }
+  return ESP_OK;
+}
+
+namespace HostRmt {
+void setEdgeHook(void (*hook)(int, uint64_t)) { g_edgeHook = hook; }
+uint32_t trains() { return g_trains; }
+uint32_t edges() { return g_edges; }
+}  // namespace HostRmt
@@ -0,0 +1,72 @@
+/**
+ * @file WifiHost.cpp
+ * @brief Host implementation of the shared WiFi manager and credential store.
+ *        Credentials live in LittleFS; connections always succeed.
+ */
+#include <LittleFS.h>
+#include <WifiCredentials.hpp>
+#include <WifiManager.hpp>
+
+namespace {
+constexpr const char* kCredentialsPath = "/wifi.txt";
+}
+
+namespace Shared {
+namespace WiFiCredentials {
+
+bool save(const String& ssid, const String& password) {
+  File f = LittleFS.open(kCredentialsPath, "w");
+  if (!f) return false;
+  f.print(ssid);
+  f.print("\n");
+  f.print(password);
+  f.close();
+  return true;
+}
+
+bool load(String& ssid, String& password) {
+  File f = LittleFS.open(kCredentialsPath, "r");
+  if (!f) return false;
+  String text;
+  while (f.available()) text += static_cast<char>(f.read());
+  f.close();
+  int nl = text.indexOf('\n');
+  if (nl <= 0) return false;
+  ssid = text.substring(0, nl);
+  password = text.substring(nl + 1);
+  return true;
+}
+
+bool clear() { return LittleFS.remove(kCredentialsPath) || !LittleFS.exists(kCredentialsPath); }
+
+}  // namespace WiFiCredentials
+
+bool WifiManager::connect(const String& ssid, const String& password) {
+  (void)password;
+  m_ssid = ssid;
+  m_connected = true;
+  m_ap = false;
+  return true;
+}
+
+void WifiManager::startAccessPoint() {
+  m_connected = false;
+  m_ap = true;
+}
+
+String WifiManager::buildStatusJson() const {
+  String json = "{\"connected\":";
+  json += m_connected ? "true" : "false";
+  json += ",\"ap\":";
+  json += m_ap ? "true" : "false";
+  json += ",\"ssid\":\"";
+  json += m_ssid;
+  json += "\",\"ip\":\"";
+  json += m_connected ? "127.0.0.1" : (m_ap ? "192.168.4.1" : "");
+  json += "\"}";
+  return json;
+}
+
+String WifiManager::buildScanJson() { return "{\"networks\":[]}"; }
+
+}  // namespace Shared
@@ -0,0 +1,414 @@
+/**
+ * @file BaseStore.cpp
+ * @brief Single-file, append-only record store for base metadata.
+ */
+#include "BaseStore.hpp"
+
+#include <LittleFS.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "Checksum.hpp"
+#include "Log.hpp"
+
+namespace {
+
+constexpr uint32_t kMagic = 0x53424653;  // "SFBS"
+constexpr uint16_t kVersion = 3;
+constexpr uint16_t kVersionV1 = 1;
+constexpr uint16_t kVersionV2 = 2;
+constexpr size_t kCompactMinDead = 32;
+
+enum : uint8_t { kOpPut = 1, kOpDelete = 2 };
+enum : uint8_t { kFlagLegacyKey = 1 };
+
+struct Header {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t recordSize;
+  uint32_t reserved;
+  uint32_t crc;
+};
+
+struct Record {
+  TagId rfid;
+  uint8_t op;
+  uint8_t flags;
+  uint8_t reserved[2];
+  Storage::BaseInfo info;
+  uint32_t crc;
+};
+
+// BaseInfo before motion profiles (formats v1 and v2).
+struct InfoV2 {
+  char paintName[32];
+  char recipeName[32];
+  char recipeId[24];
+  char notes[96];
+};
+
+// Format v2, keyed by the full tag UID.
+struct RecordV2 {
+  TagId rfid;
+  uint8_t op;
+  uint8_t flags;
+  uint8_t reserved[2];
+  InfoV2 info;
+  uint32_t crc;
+};
+
+// Format v1, keyed by the last four bytes of the UID.
+struct RecordV1 {
+  uint32_t rfid;
+  uint8_t op;
+  uint8_t reserved[3];
+  InfoV2 info;
+  uint32_t crc;
+};
+
+static_assert(sizeof(Header) == 16, "Header layout is part of the file format");
+static_assert(sizeof(Record) == 216, "Record layout is part of the file format");
+static_assert(sizeof(RecordV2) == 200, "v2 record layout is part of the file format");
+static_assert(sizeof(RecordV1) == 196, "v1 record layout is part of the file format");
+
+constexpr size_t kHeaderCrcSpan = offsetof(Header, crc);
+constexpr size_t kRecordCrcSpan = offsetof(Record, crc);
+
+Header makeHeader() {
+  Header h = {};
+  h.magic = kMagic;
+  h.version = kVersion;
+  h.recordSize = sizeof(Record);
+  h.crc = Checksum::crc32(&h, kHeaderCrcSpan);
+  return h;
+}
+
+bool headerValid(const Header& h) {
+  return h.magic == kMagic && h.crc == Checksum::crc32(&h, kHeaderCrcSpan);
+}
+
+bool recordValid(const Record& r) {
+  return (r.op == kOpPut || r.op == kOpDelete) && r.crc == Checksum::crc32(&r, kRecordCrcSpan);
+}
+
+bool readRecord(File& f, uint32_t offset, Record& out) {
+  if (!f.seek(offset)) return false;
+  if (f.read(reinterpret_cast<uint8_t*>(&out), sizeof(out)) != sizeof(out)) return false;
+  return recordValid(out);
+}
+
+Record makeRecord(TagId rfid, uint8_t op, uint8_t flags, const Storage::BaseInfo* info) {
+  Record r = {};
+  r.rfid = rfid;
+  r.op = op;
+  r.flags = flags;
+  if (info) r.info = *info;
+  r.crc = Checksum::crc32(&r, kRecordCrcSpan);
+  return r;
+}
+
+Storage::BaseInfo fromV2(const InfoV2& old) {
+  Storage::BaseInfo info;
+  memcpy(info.paintName, old.paintName, sizeof(info.paintName));
+  memcpy(info.recipeName, old.recipeName, sizeof(info.recipeName));
+  memcpy(info.recipeId, old.recipeId, sizeof(info.recipeId));
+  memcpy(info.notes, old.notes, sizeof(info.notes));
+  return info;
+}
+
+// Converts old records up to a partial one at the tail. Like the normal scan,
+// a full-size record that fails its check is skipped and dropped. Returns
+// false only on a write error.
+template <typename Old>
+bool convertRecords(File& src, File& dst, uint8_t extraFlags, size_t& converted, size_t& skipped) {
+  Old old;
+  while (src.read(reinterpret_cast<uint8_t*>(&old), sizeof(old)) == sizeof(old)) {
+    if ((old.op != kOpPut && old.op != kOpDelete) || old.crc != Checksum::crc32(&old, offsetof(Old, crc))) {
+      ++skipped;
+      continue;
+    }
+    Storage::BaseInfo info = fromV2(old.info);
+    uint8_t flags = extraFlags;
+    if constexpr (sizeof(old.rfid) == sizeof(TagId)) flags |= old.flags;
+    Record r = makeRecord(old.rfid, old.op, flags, old.op == kOpPut ? &info : nullptr);
+    if (dst.write(reinterpret_cast<const uint8_t*>(&r), sizeof(r)) != sizeof(r)) return false;
+    ++converted;
+  }
+  return true;
+}
+
+}  // namespace
+
+bool BaseStore::open(const char* path, Visitor visit, void* ctx) {
+  m_path = path;
+  m_index.clear();
+  m_corrupt = 0;
+  m_dead = 0;
+  m_fileBytes = 0;
+
+  File f = LittleFS.open(m_path, "r");
+  if (!f) return create();
+
+  Header header;
+  if (f.read(reinterpret_cast<uint8_t*>(&header), sizeof(header)) != sizeof(header) || !headerValid(header)) {
+    f.close();
+    Log::printf("[Storage] %s has a bad header; moving it aside.", path);
+    LittleFS.rename(m_path, m_path + ".bad");
+    return create();
+  }
+  if ((header.version == kVersionV1 && header.recordSize == sizeof(RecordV1)) ||
+      (header.version == kVersionV2 && header.recordSize == sizeof(RecordV2))) {
+    if (!upgrade(f, header.version)) {
+      Log::printf("[Storage] Could not upgrade %s to format v%u.", path, kVersion);
+      return false;
+    }
+    return open(path, visit, ctx);
+  }
+  if (header.version != kVersion || header.recordSize != sizeof(Record)) {
+    f.close();
+    Log::printf("[Storage] %s is format v%u, expected v%u.", path, header.version, kVersion);
+    return false;
+  }
+
+  uint32_t offset = sizeof(Header);
+  bool torn = false;
+  Record r;
+  for (;;) {
+    size_t n = f.read(reinterpret_cast<uint8_t*>(&r), sizeof(r));
+    if (n == 0) break;
+    if (n != sizeof(r)) {
+      torn = true;
+      break;
+    }
+    if (!recordValid(r)) {
+      // A full-size record that fails its CRC is damage, not a torn append:
+      // the records after it are still aligned, so skip it and keep going.
+      // It counts as dead and goes away with the next compaction.
+      Log::printf("[Storage] Skipping corrupt record at offset %u.", static_cast<unsigned>(offset));
+      ++m_corrupt;
+      ++m_dead;
+      offset += sizeof(r);
+      continue;
+    }
+    if (r.op == kOpPut) {
+      if (contains(r.rfid)) ++m_dead;
+      if (m_index.put(r.rfid, offset) && visit) visit(r.rfid, &r.info, ctx);
+    } else {
+      if (m_index.erase(r.rfid)) ++m_dead;
+      ++m_dead;
+      if (visit) visit(r.rfid, nullptr, ctx);
+    }
+    offset += sizeof(r);
+  }
+  f.close();
+  m_fileBytes = offset;
+
+  if (torn) {
+    // An interrupted append leaves a partial record at the tail. Rewrite the
+    // valid records so later appends are not stranded behind it.
+    Log::printf("[Storage] Dropping torn record at offset %u.", static_cast<unsigned>(offset));
+    return compact();
+  }
+  if (needsCompaction()) compact();
+  return true;
+}
+
+bool BaseStore::create() {
+  File f = LittleFS.open(m_path, "w");
+  if (!f) return false;
+  Header header = makeHeader();
+  bool ok = f.write(reinterpret_cast<const uint8_t*>(&header), sizeof(header)) == sizeof(header);
+  f.close();
+  m_fileBytes = sizeof(Header);
+  return ok;
+}
+
+// Rewrites an older log record by record into the current format, keeping
+// deletes so the normal scan sees the same history, and renames it over the
+// original. v1 records are marked as stored under a legacy key; v2 bases get
+// an empty motion profile. `src` is positioned after the header and is
+// closed on return.
+bool BaseStore::upgrade(File& src, uint16_t version) {
+  String tmpPath = m_path + ".tmp";
+  File dst = LittleFS.open(tmpPath, "w");
+  if (!dst) {
+    src.close();
+    return false;
+  }
+  Header header = makeHeader();
+  bool ok = dst.write(reinterpret_cast<const uint8_t*>(&header), sizeof(header)) == sizeof(header);
+  size_t converted = 0;
+  size_t skipped = 0;
+  if (ok) {
+    ok = version == kVersionV1 ? convertRecords<RecordV1>(src, dst, kFlagLegacyKey, converted, skipped)
+                               : convertRecords<RecordV2>(src, dst, 0, converted, skipped);
+  }
+  src.close();
+  dst.close();
+  if (!ok || !LittleFS.rename(tmpPath, m_path)) {
+    LittleFS.remove(tmpPath);
+    return false;
+  }
+  Log::printf("[Storage] Upgraded %s from format v%u to v%u (%u records, %u corrupt skipped).", m_path.c_str(),
+              version, kVersion, static_cast<unsigned>(converted), static_cast<unsigned>(skipped));
+  return true;
+}
+
+bool BaseStore::read(TagId rfid, Storage::BaseInfo& out) const {
+  File f;
+  bool ok = read(rfid, out, f);
+  if (f) f.close();
+  return ok;
+}
+
+bool BaseStore::read(TagId rfid, Storage::BaseInfo& out, File& file) const {
+  const uint32_t* offset = m_index.find(rfid);
+  if (!offset) return false;
+  if (!file) file = LittleFS.open(m_path, "r");
+  if (!file) return false;
+  Record r;
+  if (!readRecord(file, *offset, r) || r.rfid != rfid || r.op != kOpPut) return false;
+  out = r.info;
+  return true;
+}
+
+bool BaseStore::put(TagId rfid, const Storage::BaseInfo& info, bool legacyKey) {
+  bool existed = contains(rfid);
+  if (!existed && size() == kMaxRecords) return false;
+  uint32_t offset = m_fileBytes;
+  if (!append(rfid, kOpPut, legacyKey ? kFlagLegacyKey : 0, &info)) return false;
+  if (existed) ++m_dead;
+  m_index.put(rfid, offset);
+  return true;
+}
+
+bool BaseStore::putAll(const Update* updates, size_t count) {
+  size_t added = 0;
+  for (size_t i = 0; i < count; ++i) {
+    if (!contains(updates[i].rfid)) ++added;
+  }
+  if (size() + added > kMaxRecords) return false;
+  if (count == 0) return true;
+  File f = LittleFS.open(m_path, "a");
+  if (!f) return false;
+  uint32_t offset = m_fileBytes;
+  bool ok = true;
+  for (size_t i = 0; ok && i < count; ++i) {
+    Record r = makeRecord(updates[i].rfid, kOpPut, 0, &updates[i].info);
+    ok = f.write(reinterpret_cast<const uint8_t*>(&r), sizeof(r)) == sizeof(r);
+  }
+  f.close();
+  if (!ok) {
+    // The index still points at the old records; rewriting from it drops
+    // whatever part of the batch reached the file.
+    compact();
+    return false;
+  }
+  for (size_t i = 0; i < count; ++i) {
+    m_index.put(updates[i].rfid, offset + i * sizeof(Record));
+  }
+  m_fileBytes += count * sizeof(Record);
+  m_bytesWritten += count * sizeof(Record);
+  m_dead += count - added;
+  return true;
+}
+
+bool BaseStore::erase(TagId rfid) {
+  if (!contains(rfid)) return false;
+  if (!append(rfid, kOpDelete, 0, nullptr)) return false;
+  m_index.erase(rfid);
+  m_dead += 2;
+  return true;
+}
+
+bool BaseStore::readLegacy(TagId rfid, Storage::BaseInfo& out) const {
+  const uint32_t* offset = m_index.find(rfid);
+  if (!offset) return false;
+  File f = LittleFS.open(m_path, "r");
+  if (!f) return false;
+  Record r;
+  bool ok = readRecord(f, *offset, r) && r.rfid == rfid && r.op == kOpPut && (r.flags & kFlagLegacyKey);
+  f.close();
+  if (ok) out = r.info;
+  return ok;
+}
+
+bool BaseStore::rekey(TagId from, TagId to) {
+  Storage::BaseInfo info;
+  if (to == 0 || contains(to) || !readLegacy(from, info)) return false;
+  // Write the new key first: a power cut in between leaves a duplicate, not
+  // a lost record.
+  return put(to, info) && erase(from);
+}
+
+bool BaseStore::append(TagId rfid, uint8_t op, uint8_t flags, const Storage::BaseInfo* info) {
+  Record r = makeRecord(rfid, op, flags, info);
+
+  File f = LittleFS.open(m_path, "a");
+  if (!f) return false;
+  size_t written = f.write(reinterpret_cast<const uint8_t*>(&r), sizeof(r));
+  f.close();
+  if (written != sizeof(r)) {
+    // Do not leave a partial record in front of future appends.
+    compact();
+    return false;
+  }
+  m_fileBytes += sizeof(r);
+  m_bytesWritten += sizeof(r);
+  return true;
+}
+
+// Copies live records into a new file and atomically renames it over the
+// log, so a power cut leaves either the old or the new file intact. Records
+// are written in index order, so a second pass can assign the new offsets
+// once the rename has succeeded.
+bool BaseStore::compact() {
+  String tmpPath = m_path + ".tmp";
+  File src = LittleFS.open(m_path, "r");
+  File dst = LittleFS.open(tmpPath, "w");
+  if (!dst) return false;
+
+  Header header = makeHeader();
+  bool ok = dst.write(reinterpret_cast<const uint8_t*>(&header), sizeof(header)) == sizeof(header);
+  Record r;
+  m_index.forEach([&](TagId, uint32_t& offset) {
+    ok = ok && src && readRecord(src, offset, r) &&
+         dst.write(reinterpret_cast<const uint8_t*>(&r), sizeof(r)) == sizeof(r);
+  });
+  if (src) src.close();
+  dst.close();
+  if (!ok || !LittleFS.rename(tmpPath, m_path)) {
+    LittleFS.remove(tmpPath);
+    return false;
+  }
+
+  uint32_t offset = sizeof(Header);
+  m_index.forEach([&](TagId, uint32_t& slotOffset) {
+    slotOffset = offset;
+    offset += sizeof(Record);
+  });
+  m_fileBytes = offset;
+  m_bytesWritten += offset;
+  m_dead = 0;
+  ++m_compactions;
+  return true;
+}
+
+bool BaseStore::needsCompaction() const { return m_dead >= kCompactMinDead && m_dead > size(); }
+
+size_t BaseStore::list(TagId* out, size_t max, TagId after) const {
+  return m_index.listAfter(after, out, max);
+}
+
+BaseStore::Stats BaseStore::stats() const {
+  Stats s;
+  s.live = size();
+  s.dead = m_dead;
+  s.fileBytes = m_fileBytes;
+  s.compactions = m_compactions;
+  s.corrupt = m_corrupt;
+  s.indexSlots = TagIndex<kMaxRecords>::kSlots;
+  s.maxProbe = m_index.maxProbe();
+  s.bytesWritten = m_bytesWritten;
+  return s;
+}
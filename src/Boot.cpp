@@ -0,0 +1,124 @@
+/**
+ * @file Boot.cpp
+ * @brief Staged startup: which subsystems are up, and how long each took.
+ */
+#include "Boot.hpp"
+
+#include "Log.hpp"
+
+namespace {
+
+const char* const kStageNames[] = {"core", "storage", "rfid", "wifi", "web"};
+constexpr size_t kStageCount = static_cast<size_t>(Boot::Stage::Count);
+static_assert(sizeof(kStageNames) / sizeof(kStageNames[0]) == kStageCount, "stage names");
+
+struct StageInfo {
+  Boot::State state = Boot::State::Pending;
+  uint32_t startMs = 0;
+  uint32_t doneMs = 0;
+};
+
+// Written by setup() and the boot task, read by the console.
+StageInfo g_stages[kStageCount];
+portMUX_TYPE g_mux = portMUX_INITIALIZER_UNLOCKED;
+
+StageInfo& info(Boot::Stage stage) { return g_stages[static_cast<size_t>(stage)]; }
+
+}  // namespace
+
+namespace Boot {
+
+void begin() {
+  portENTER_CRITICAL(&g_mux);
+  StageInfo& core = info(Stage::Core);
+  core.state = State::Running;
+  core.startMs = millis();
+  portEXIT_CRITICAL(&g_mux);
+}
+
+void enter(Stage stage) {
+  portENTER_CRITICAL(&g_mux);
+  StageInfo& s = info(stage);
+  s.state = State::Running;
+  s.startMs = millis();
+  portEXIT_CRITICAL(&g_mux);
+}
+
+void finish(Stage stage, bool ok) {
+  portENTER_CRITICAL(&g_mux);
+  StageInfo& s = info(stage);
+  s.state = ok ? State::Ready : State::Failed;
+  s.doneMs = millis();
+  StageInfo copy = s;
+  portEXIT_CRITICAL(&g_mux);
+  Log::printf("[Boot] %s %s in %u ms (t=%u ms).", stageName(stage), ok ? "ready" : "failed",
+              static_cast<unsigned>(copy.doneMs - copy.startMs), static_cast<unsigned>(copy.doneMs));
+}
+
+State state(Stage stage) {
+  portENTER_CRITICAL(&g_mux);
+  State s = info(stage).state;
+  portEXIT_CRITICAL(&g_mux);
+  return s;
+}
+
+bool ready(uint8_t stages) {
+  for (size_t i = 0; i < kStageCount; ++i) {
+    Stage stage = static_cast<Stage>(i);
+    if ((stages & bit(stage)) && state(stage) != State::Ready) return false;
+  }
+  return true;
+}
+
+Stage firstMissing(uint8_t stages) {
+  for (size_t i = 0; i < kStageCount; ++i) {
+    Stage stage = static_cast<Stage>(i);
+    if ((stages & bit(stage)) && state(stage) != State::Ready) return stage;
+  }
+  return Stage::Count;
+}
+
+const char* stageName(Stage stage) {
+  size_t i = static_cast<size_t>(stage);
+  return i < kStageCount ? kStageNames[i] : "";
+}
+
+const char* stateName(State state) {
+  switch (state) {
+    case State::Pending:
+      return "pending";
+    case State::Running:
+      return "running";
+    case State::Ready:
+      return "ready";
+    case State::Failed:
+      return "failed";
+  }
+  return "";
+}
+
+// {"uptime_ms":..,"stages":{"core":{"state":"ready","start_ms":..,"ms":..},..}}
+// `ms` is the stage's duration so far while it is running.
+void toJson(JsonWriter& out) {
+  StageInfo stages[kStageCount];
+  portENTER_CRITICAL(&g_mux);
+  for (size_t i = 0; i < kStageCount; ++i) stages[i] = g_stages[i];
+  portEXIT_CRITICAL(&g_mux);
+
+  uint32_t now = millis();
+  out.member("uptime_ms", now);
+  out.key("stages").beginObject();
+  for (size_t i = 0; i < kStageCount; ++i) {
+    const StageInfo& s = stages[i];
+    out.key(kStageNames[i]).beginObject();
+    out.member("state", stateName(s.state));
+    if (s.state != State::Pending) {
+      out.member("start_ms", s.startMs);
+      out.member("ms", (s.state == State::Running ? now : s.doneMs) - s.startMs);
+    }
+    out.endObject();
+  }
+  out.endObject();
+}
+
+}  // namespace Boot
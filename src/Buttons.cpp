@@ -0,0 +1,177 @@
+/**
+ * @file Buttons.cpp
+ * @brief Interrupt-driven, debounced jog buttons.
+ */
+#include "Buttons.hpp"
+
+#include "Pins.hpp"
+#include "SpscQueue.hpp"
+#include "StepperControl.hpp"
+
+#ifndef BUTTONS_DEBOUNCE_US
+#define BUTTONS_DEBOUNCE_US 5000
+#endif
+
+#ifndef BUTTONS_HOLD_MS
+#define BUTTONS_HOLD_MS 300
+#endif
+
+// How far a tap moves the plunger, in full steps.
+#ifndef BUTTONS_TAP_FULL_STEPS
+#define BUTTONS_TAP_FULL_STEPS 50
+#endif
+
+namespace {
+
+constexpr uint32_t kDebounceUs = BUTTONS_DEBOUNCE_US;
+constexpr uint32_t kHoldUs = BUTTONS_HOLD_MS * 1000UL;
+constexpr uint32_t kTapSteps = BUTTONS_TAP_FULL_STEPS * StepperControl::kMicrosteps;
+constexpr size_t kButtonCount = static_cast<size_t>(Buttons::Button::Count);
+
+struct Key {
+  int pin;
+  bool pressed;
+  uint32_t edgeUs;
+  uint32_t pressUs;
+  int32_t pressPosition;
+};
+
+StepperControl* g_stepper = nullptr;
+
+// Shared between the GPIO handlers and poll(), guarded by g_mux. Pushes to
+// g_events happen under it too, so the queue sees one producer at a time.
+portMUX_TYPE g_mux = portMUX_INITIALIZER_UNLOCKED;
+Key g_keys[kButtonCount] = {{Pins::BUTTON_WITHDRAW, false, 0, 0, 0}, {Pins::BUTTON_DISPENSE, false, 0, 0, 0}};
+// The button whose jog is running, or Count.
+size_t g_jogKey = kButtonCount;
+uint32_t g_bounces = 0;
+uint32_t g_recovered = 0;
+uint32_t g_dropped = 0;
+
+SpscQueue<Buttons::Event, 16> g_events;
+
+// Owned by poll().
+Buttons::Stats g_stats;
+
+void IRAM_ATTR post(size_t i, bool pressed, uint32_t now, uint32_t heldUs, bool hold) {
+  Buttons::Event e = {static_cast<Buttons::Button>(i), pressed, now, heldUs, hold};
+  if (!g_events.push(e)) ++g_dropped;
+}
+
+// Applies a debounced edge. Called with g_mux held.
+void IRAM_ATTR accept(size_t i, bool pressed, uint32_t now) {
+  Key& key = g_keys[i];
+  key.pressed = pressed;
+  key.edgeUs = now;
+  if (pressed) {
+    key.pressUs = now;
+    key.pressPosition = g_stepper->position();
+    if (g_keys[1 - i].pressed) {
+      // Both down: stop, and stay stopped until one is pressed again.
+      g_stepper->stopFromIsr();
+      g_jogKey = kButtonCount;
+    } else {
+      // Every press starts as a hold; a quick release cuts it to a tap.
+      g_stepper->jogFromIsr(i == static_cast<size_t>(Buttons::Button::Withdraw), StepperControl::kUnlimitedSteps);
+      g_jogKey = i;
+    }
+    post(i, true, now, 0, false);
+    return;
+  }
+
+  uint32_t heldUs = now - key.pressUs;
+  bool hold = heldUs >= kHoldUs;
+  if (g_jogKey == i) {
+    int32_t moved = g_stepper->position() - key.pressPosition;
+    uint32_t done = static_cast<uint32_t>(moved < 0 ? -moved : moved);
+    if (hold || done >= kTapSteps) {
+      g_stepper->stopFromIsr();
+    } else {
+      g_stepper->jogFromIsr(i == static_cast<size_t>(Buttons::Button::Withdraw), kTapSteps - done);
+    }
+    g_jogKey = kButtonCount;
+  }
+  post(i, false, now, heldUs, hold);
+}
+
+void IRAM_ATTR onEdge(size_t i) {
+  uint32_t now = micros();
+  bool pressed = digitalRead(g_keys[i].pin) == LOW;
+  portENTER_CRITICAL_ISR(&g_mux);
+  Key& key = g_keys[i];
+  if (pressed != key.pressed) {
+    if (now - key.edgeUs < kDebounceUs) {
+      ++g_bounces;
+    } else {
+      accept(i, pressed, now);
+    }
+  }
+  portEXIT_CRITICAL_ISR(&g_mux);
+}
+
+void IRAM_ATTR onWithdrawEdge() { onEdge(static_cast<size_t>(Buttons::Button::Withdraw)); }
+void IRAM_ATTR onDispenseEdge() { onEdge(static_cast<size_t>(Buttons::Button::Dispense)); }
+
+}  // namespace
+
+namespace Buttons {
+
+void begin(StepperControl& stepper) {
+  g_stepper = &stepper;
+  // Back-date the last edge so the first real one is not taken for bounce.
+  uint32_t settled = micros() - kDebounceUs;
+  for (Key& key : g_keys) {
+    pinMode(key.pin, INPUT_PULLUP);
+    key.edgeUs = settled;
+  }
+  attachInterrupt(digitalPinToInterrupt(Pins::BUTTON_WITHDRAW), onWithdrawEdge, CHANGE);
+  attachInterrupt(digitalPinToInterrupt(Pins::BUTTON_DISPENSE), onDispenseEdge, CHANGE);
+}
+
+void poll() {
+  if (!g_stepper) return;
+  uint32_t now = micros();
+  portENTER_CRITICAL(&g_mux);
+  for (size_t i = 0; i < kButtonCount; ++i) {
+    // The last edge of a bounce burst is dropped by the handler; pick the
+    // settled level up here once the window has passed. This also catches a
+    // button already held at boot.
+    bool pressed = digitalRead(g_keys[i].pin) == LOW;
+    if (pressed != g_keys[i].pressed && now - g_keys[i].edgeUs >= kDebounceUs) {
+      accept(i, pressed, now);
+      ++g_recovered;
+    }
+  }
+  g_stats.bounces = g_bounces;
+  g_stats.recovered = g_recovered;
+  g_stats.dropped = g_dropped;
+  portEXIT_CRITICAL(&g_mux);
+
+  Event e;
+  while (g_events.pop(e)) {
+    g_stats.lastEventUs = e.atUs;
+    if (e.pressed) {
+      ++g_stats.presses;
+    } else if (e.hold) {
+      ++g_stats.holds;
+    } else {
+      ++g_stats.taps;
+    }
+  }
+}
+
+Stats stats() {
+  portENTER_CRITICAL(&g_mux);
+  Stats copy = g_stats;
+  portEXIT_CRITICAL(&g_mux);
+  return copy;
+}
+
+bool isPressed(Button button) {
+  portENTER_CRITICAL(&g_mux);
+  bool pressed = g_keys[static_cast<size_t>(button)].pressed;
+  portEXIT_CRITICAL(&g_mux);
+  return pressed;
+}
+
+}  // namespace Buttons
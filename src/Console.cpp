@@ -0,0 +1,677 @@
+/**
+ * @file Console.cpp
+ * @brief Serial command console with JSON replies, over plain text lines or
+ *        binary frames (see SerialFrames.hpp).
+ */
+#include "Console.hpp"
+
+#include <string.h>
+
+#include <WifiCredentials.hpp>
+#include <WifiManager.hpp>
+
+#include "Boot.hpp"
+#include "Buttons.hpp"
+#include "ConsoleEngine.hpp"
+#include "CurrentBase.hpp"
+#include "Job.hpp"
+#include "JsonWriter.hpp"
+#include "Log.hpp"
+#include "Metrics.hpp"
+#include "Motion.hpp"
+#include "Recipes.hpp"
+#include "RfidReader.hpp"
+#include "SerialFrames.hpp"
+#include "StepPulse.hpp"
+#include "StepperControl.hpp"
+#include "Storage.hpp"
+
+namespace {
+
+using ConsoleEngine::Args;
+using ConsoleEngine::Reply;
+
+// Longest accepted command line, including arguments.
+constexpr size_t kMaxLine = 160;
+
+constexpr uint32_t kMinBaud = 9600;
+constexpr uint32_t kMaxBaud = 5000000;
+// Telemetry is sent from poll(), so the console task period bounds the rate.
+constexpr uint16_t kMaxTelemetryHz = 200;
+
+enum class Mode : uint8_t { Text, Binary };
+
+Shared::WifiManager* g_wifi = nullptr;
+RfidReader* g_rfid = nullptr;
+StepperControl* g_stepper = nullptr;
+
+ConsoleEngine::LineReader<kMaxLine> g_reader;
+SerialFrames::FrameReader<kMaxLine> g_frames;
+
+// The console always boots in text mode at the boot baud rate, so a reset
+// recovers a host that lost track of the link.
+Mode g_mode = Mode::Text;
+// Replies go to Serial in text mode and into the open reply frame in binary
+// mode.
+Print* g_sink = &Serial;
+
+// A mode or baud change asked for by proto.*; applied once its reply is out.
+bool g_switchPending = false;
+Mode g_switchMode = Mode::Text;
+uint32_t g_switchBaud = 0;
+
+uint16_t g_telemetryHz = 0;
+uint32_t g_lastTelemetryUs = 0;
+uint8_t g_telemetrySeq = 0;
+uint8_t g_logSeq = 0;
+
+uint32_t g_framesIn = 0;
+uint32_t g_framesOut = 0;
+uint32_t g_frameErrors = 0;
+
+void printStructured(const char* cmd, bool ok, const char* message = nullptr, const char* data = nullptr) {
+  Reply reply(*g_sink, cmd, ok, message);
+  if (data && *data) reply.data().print(data);
+}
+
+// Whole-token numeric parsing; a trailing unit or typo is an error.
+bool parseFloat(const char* text, float& out) {
+  if (!text) return false;
+  char* end = nullptr;
+  out = strtof(text, &end);
+  return end != text && *end == '\0';
+}
+
+bool parseInt(const char* text, int32_t& out) {
+  if (!text) return false;
+  char* end = nullptr;
+  long v = strtol(text, &end, 10);
+  if (end == text || *end != '\0' || v < INT32_MIN || v > INT32_MAX) return false;
+  out = static_cast<int32_t>(v);
+  return true;
+}
+
+// Replies with one object whose members `fill` writes to the JsonWriter it
+// is given.
+template <typename Fill>
+void replyObject(const char* cmd, Fill fill) {
+  Reply reply(*g_sink, cmd, true);
+  JsonWriter json(reply.data());
+  json.beginObject();
+  fill(json);
+  json.endObject();
+}
+
+void handleWifiStatus(Args&) {
+  printStructured("wifi.status", true, nullptr, g_wifi->buildStatusJson().c_str());
+}
+
+// The WiFi layer takes Strings, so this (rare) command still allocates.
+void handleWifiSet(Args& args) {
+  const char* ssidArg = args.next();
+  if (!ssidArg) {
+    printStructured("wifi.set", false, "usage: wifi.set <ssid> [password]");
+    return;
+  }
+
+  String ssid = ssidArg;
+  String password = args.rest();
+  if (!Shared::WiFiCredentials::save(ssid, password)) {
+    printStructured("wifi.set", false, "failed to save credentials");
+    return;
+  }
+
+  bool connected = g_wifi->connect(ssid, password);
+  printStructured("wifi.set", connected, connected ? "connected" : "connect failed",
+                  g_wifi->buildStatusJson().c_str());
+}
+
+void handleWifiConnect(Args&) {
+  String ssid;
+  String password;
+  if (!Shared::WiFiCredentials::load(ssid, password)) {
+    printStructured("wifi.connect", false, "no saved credentials");
+    return;
+  }
+  bool connected = g_wifi->connect(ssid, password);
+  printStructured("wifi.connect", connected, connected ? "connected" : "connect failed",
+                  g_wifi->buildStatusJson().c_str());
+}
+
+void handleWifiClear(Args&) {
+  if (!Shared::WiFiCredentials::clear()) {
+    printStructured("wifi.clear", false, "failed to clear credentials");
+    return;
+  }
+  printStructured("wifi.clear", true, "credentials cleared");
+}
+
+void handleWifiAp(Args&) {
+  g_wifi->startAccessPoint();
+  printStructured("wifi.ap", true, "ap started");
+}
+
+void handleWifiScan(Args&) {
+  printStructured("wifi.scan", true, nullptr, g_wifi->buildScanJson().c_str());
+}
+
+void handleRfidStatus(Args& args) {
+  char data[96];
+  snprintf(data, sizeof(data), "{\"tag\":\"%s\",\"last_poll_us\":%u,\"max_poll_us\":%u}",
+           Tags::Hex(g_rfid->currentTag()).str, static_cast<unsigned>(g_rfid->lastPollUs()),
+           static_cast<unsigned>(g_rfid->maxPollUs()));
+  const char* action = args.next();
+  if (action && strcmp(action, "reset") == 0) g_rfid->resetPollStats();
+  printStructured("rfid.status", true, nullptr, data);
+}
+
+void handleMotionProfile(Args& args) {
+  if (!args.empty()) {
+    int32_t maxSpeed = 0;
+    // Without an acceleration the global one is kept.
+    int32_t accel = 0;
+    const char* accelArg = nullptr;
+    if (!parseInt(args.next(), maxSpeed) || maxSpeed <= 0 || ((accelArg = args.next()) && !parseInt(accelArg, accel)) ||
+        accel < 0 || (accelArg && accel == 0) || !args.empty()) {
+      printStructured("motion.profile", false, "usage: motion.profile [<max_steps_per_sec> [<accel_steps_per_sec2>]]");
+      return;
+    }
+    Motion::setProfile(static_cast<uint32_t>(maxSpeed), static_cast<uint32_t>(accel));
+  }
+  char data[160];
+  snprintf(data, sizeof(data),
+           "{\"max_steps_per_sec\":%u,\"accel_steps_per_sec2\":%u,\"ramp_steps\":%u,\"microsteps\":%u,"
+           "\"pulse\":\"%s\"}",
+           static_cast<unsigned>(g_stepper->maxSpeed()), static_cast<unsigned>(g_stepper->acceleration()),
+           static_cast<unsigned>(g_stepper->rampLength()), static_cast<unsigned>(StepperControl::kMicrosteps),
+           StepPulse::name());
+  printStructured("motion.profile", true, nullptr, data);
+}
+
+// Replies with the motion status, or the reason the command was refused.
+void replyMotion(const char* cmd, Motion::Result result) {
+  if (result != Motion::Result::Ok) {
+    printStructured(cmd, false, Motion::describe(result));
+    return;
+  }
+  replyObject(cmd, [](JsonWriter& out) { Motion::toJson(out); });
+}
+
+void handleWithdraw(Args& args) {
+  float ul = 0.0f;
+  if (!parseFloat(args.next(), ul)) {
+    printStructured("withdraw", false, "usage: withdraw <ul>");
+    return;
+  }
+  replyMotion("withdraw", Motion::withdraw(ul));
+}
+
+void handleDispense(Args& args) {
+  float ul = 0.0f;
+  if (!parseFloat(args.next(), ul)) {
+    printStructured("dispense", false, "usage: dispense <ul>");
+    return;
+  }
+  replyMotion("dispense", Motion::dispense(ul));
+}
+
+void handleMove(Args& args) {
+  int32_t steps = 0;
+  if (!parseInt(args.next(), steps)) {
+    printStructured("move", false, "usage: move <steps> (negative dispenses)");
+    return;
+  }
+  replyMotion("move", Motion::move(steps));
+}
+
+void handleStop(Args&) {
+  Motion::stop();
+  replyMotion("stop", Motion::Result::Ok);
+}
+
+void handleMotionStatus(Args&) { replyMotion("motion.status", Motion::Result::Ok); }
+
+void handleMotionZero(Args&) { replyMotion("motion.zero", Motion::zero()); }
+
+// motion.calibrate <steps_per_ul> | <steps> <ul>: the second form takes a
+// measured result, e.g. the steps moved and the volume weighed out.
+void handleMotionCalibrate(Args& args) {
+  float first = 0.0f;
+  float second = 0.0f;
+  const char* secondArg = nullptr;
+  if (!parseFloat(args.next(), first) || ((secondArg = args.next()) && !parseFloat(secondArg, second))) {
+    printStructured("motion.calibrate", false, "usage: motion.calibrate <steps_per_ul> | <steps> <ul>");
+    return;
+  }
+  float stepsPerUl = secondArg ? (second > 0.0f ? first / second : 0.0f) : first;
+  replyMotion("motion.calibrate", Motion::setStepsPerMicroliter(stepsPerUl));
+}
+
+// Job requests are applied by the motion task within a millisecond, so the
+// reply only acknowledges them; job.status shows the outcome.
+void replyJob(const char* cmd, Job::Result result) {
+  bool ok = result == Job::Result::Ok;
+  printStructured(cmd, ok, ok ? "accepted" : Job::describe(result));
+}
+
+// Starts a recipe for the docked base. Progress is reported by job.status.
+void handleJobStart(Args& args) {
+  const char* id = args.next();
+  if (!id) {
+    printStructured("job.start", false, "usage: job.start <recipe_id>");
+    return;
+  }
+  replyJob("job.start", Job::start(id, g_rfid->currentTag()));
+}
+
+void handleJobPause(Args&) { replyJob("job.pause", Job::pause()); }
+
+void handleJobResume(Args&) { replyJob("job.resume", Job::resume()); }
+
+void handleJobAbort(Args&) { replyJob("job.abort", Job::abort()); }
+
+void handleJobStatus(Args&) {
+  replyObject("job.status", [](JsonWriter& out) { Job::toJson(Job::progress(), out); });
+}
+
+void handleRecipeList(Args&) {
+  char ids[Recipes::kMaxRecipes][24];
+  size_t count = Recipes::listIds(ids, Recipes::kMaxRecipes);
+  Reply reply(*g_sink, "recipe.list", true);
+  Print& out = reply.data();
+  out.print('[');
+  for (size_t i = 0; i < count; ++i) {
+    if (i) out.print(',');
+    out.print('"');
+    out.print(ids[i]);
+    out.print('"');
+  }
+  out.print(']');
+}
+
+void handleRecipeShow(Args& args) {
+  Recipes::Recipe recipe;
+  const char* id = args.next();
+  if (!id || !Recipes::find(id, recipe)) {
+    printStructured("recipe.show", false, "unknown recipe");
+    return;
+  }
+  replyObject("recipe.show", [&recipe](JsonWriter& out) { Recipes::toJson(recipe, out); });
+}
+
+void handleRecipeDelete(Args& args) {
+  const char* id = args.next();
+  if (!id || !Recipes::erase(id)) {
+    printStructured("recipe.delete", false, "unknown recipe");
+    return;
+  }
+  printStructured("recipe.delete", true, "deleted");
+}
+
+// recipe.set <id> <step>...: each step is withdraw:<ul>[@<ul_per_s>],
+// dispense:<ul>[@<ul_per_s>] or dwell:<ms>.
+void handleRecipeSet(Args& args) {
+  constexpr const char* kUsage = "usage: recipe.set <id> withdraw:<ul>[@<ul/s>] dwell:<ms> dispense:<ul>[@<ul/s>]";
+  const char* id = args.next();
+  if (!id || strlen(id) >= sizeof(Recipes::Recipe::id)) {
+    printStructured("recipe.set", false, kUsage);
+    return;
+  }
+  Recipes::Recipe recipe;
+  strlcpy(recipe.id, id, sizeof(recipe.id));
+  // Tokens are split in place: "withdraw:100@20" -> "withdraw", "100", "20".
+  while (char* token = args.next()) {
+    if (recipe.stepCount == Recipes::kMaxSteps) {
+      printStructured("recipe.set", false, "too many steps");
+      return;
+    }
+    char* amount = strchr(token, ':');
+    if (!amount) {
+      printStructured("recipe.set", false, kUsage);
+      return;
+    }
+    *amount++ = '\0';
+    char* rate = strchr(amount, '@');
+    if (rate) *rate++ = '\0';
+    Recipes::Step& step = recipe.steps[recipe.stepCount];
+    if (!Recipes::parseAction(token, step.action) || !parseFloat(amount, step.amount) ||
+        (rate && (step.action == Recipes::Action::Dwell || !parseFloat(rate, step.rate)))) {
+      printStructured("recipe.set", false, kUsage);
+      return;
+    }
+    ++recipe.stepCount;
+  }
+  if (!Recipes::put(recipe)) {
+    printStructured("recipe.set", false, "invalid recipe or store full");
+    return;
+  }
+  replyObject("recipe.set", [&recipe](JsonWriter& out) { Recipes::toJson(recipe, out); });
+}
+
+void handleMetrics(Args& args) {
+  const char* action = args.next();
+  if (action && strcmp(action, "reset") == 0) {
+    Metrics::reset();
+    printStructured("metrics", true, "metrics reset");
+    return;
+  }
+  replyObject("metrics", [](JsonWriter& out) { Metrics::toJson(out); });
+}
+
+void handleBootStatus(Args&) {
+  replyObject("boot.status", [](JsonWriter& out) { Boot::toJson(out); });
+}
+
+void handleButtonsStatus(Args&) {
+  Buttons::Stats stats = Buttons::stats();
+  char data[200];
+  snprintf(data, sizeof(data),
+           "{\"withdraw\":%s,\"dispense\":%s,\"presses\":%u,\"taps\":%u,\"holds\":%u,\"bounces\":%u,"
+           "\"recovered\":%u,\"dropped\":%u}",
+           Buttons::isPressed(Buttons::Button::Withdraw) ? "true" : "false",
+           Buttons::isPressed(Buttons::Button::Dispense) ? "true" : "false", static_cast<unsigned>(stats.presses),
+           static_cast<unsigned>(stats.taps), static_cast<unsigned>(stats.holds),
+           static_cast<unsigned>(stats.bounces), static_cast<unsigned>(stats.recovered),
+           static_cast<unsigned>(stats.dropped));
+  printStructured("buttons.status", true, nullptr, data);
+}
+
+void handleStorageStats(Args&) {
+  Storage::CacheStats stats = Storage::cacheStats();
+  Storage::StoreStats store = Storage::storeStats();
+  Storage::WriteStats writes = Storage::writeStats();
+  char data[512];
+  snprintf(data, sizeof(data),
+           "{\"hits\":%u,\"misses\":%u,\"evictions\":%u,\"entries\":%u,\"capacity\":%u,\"bytes\":%u,\"complete\":%s,"
+           "\"store\":{\"live\":%u,\"dead\":%u,\"file_bytes\":%u,\"compactions\":%u,\"corrupt\":%u,"
+           "\"index_slots\":%u,"
+           "\"max_probe\":%u},"
+           "\"writes\":{\"saves\":%u,\"coalesced\":%u,\"unchanged\":%u,\"commits\":%u,\"records\":%u,"
+           "\"pending\":%u,\"write_amplification\":%.2f}}",
+           static_cast<unsigned>(stats.hits), static_cast<unsigned>(stats.misses),
+           static_cast<unsigned>(stats.evictions), static_cast<unsigned>(stats.entries), static_cast<unsigned>(stats.capacity),
+           static_cast<unsigned>(stats.bytes), stats.complete ? "true" : "false", static_cast<unsigned>(store.live),
+           static_cast<unsigned>(store.dead), static_cast<unsigned>(store.fileBytes),
+           static_cast<unsigned>(store.compactions), static_cast<unsigned>(store.corrupt),
+           static_cast<unsigned>(store.indexSlots),
+           static_cast<unsigned>(store.maxProbe), static_cast<unsigned>(writes.saves),
+           static_cast<unsigned>(writes.coalesced), static_cast<unsigned>(writes.unchanged),
+           static_cast<unsigned>(writes.commits), static_cast<unsigned>(writes.recordsWritten),
+           static_cast<unsigned>(writes.pending), static_cast<double>(writes.writeAmplification));
+  printStructured("storage.stats", true, nullptr, data);
+}
+
+// Commits coalesced base edits now instead of after the quiet window. Refused
+// while the plunger moves, since flash writes hold off the step ISR.
+void handleStorageFlush(Args&) {
+  if (g_stepper->isMoving() || g_stepper->queuedMoves() != 0) {
+    printStructured("storage.flush", false, Motion::describe(Motion::Result::Busy));
+  } else if (Storage::flush()) {
+    printStructured("storage.flush", true);
+  } else {
+    printStructured("storage.flush", false, "write failed");
+  }
+}
+
+// Reports the docked base from the prefetch slot, without reading storage.
+void handleBaseCurrent(Args&) {
+  replyObject("base.current", [](JsonWriter& out) { CurrentBase::toJson(CurrentBase::get(), out); });
+}
+
+const char* modeName(Mode mode) { return mode == Mode::Binary ? "binary" : "text"; }
+
+// proto.binary / proto.text [baud]: the reply goes out in the current mode
+// and at the current baud; the switch happens right after it.
+void requestMode(const char* cmd, Mode mode, Args& args) {
+  uint32_t baud = Serial.baudRate();
+  if (const char* baudArg = args.next()) {
+    int32_t requested = 0;
+    if (!parseInt(baudArg, requested) || requested < static_cast<int32_t>(kMinBaud) ||
+        requested > static_cast<int32_t>(kMaxBaud)) {
+      printStructured(cmd, false, "baud must be 9600..5000000");
+      return;
+    }
+    baud = static_cast<uint32_t>(requested);
+  }
+  g_switchPending = true;
+  g_switchMode = mode;
+  g_switchBaud = baud;
+  char data[48];
+  snprintf(data, sizeof(data), "{\"mode\":\"%s\",\"baud\":%u}", modeName(mode), static_cast<unsigned>(baud));
+  printStructured(cmd, true, nullptr, data);
+}
+
+void handleProtoBinary(Args& args) { requestMode("proto.binary", Mode::Binary, args); }
+
+void handleProtoText(Args& args) { requestMode("proto.text", Mode::Text, args); }
+
+void handleProtoTelemetry(Args& args) {
+  int32_t hz = 0;
+  if (!parseInt(args.next(), hz) || hz < 0 || hz > kMaxTelemetryHz) {
+    printStructured("proto.telemetry", false, "usage: proto.telemetry <0..200 hz>");
+    return;
+  }
+  g_telemetryHz = static_cast<uint16_t>(hz);
+  g_lastTelemetryUs = micros();
+  char data[32];
+  snprintf(data, sizeof(data), "{\"telemetry_hz\":%u}", static_cast<unsigned>(g_telemetryHz));
+  printStructured("proto.telemetry", true, nullptr, data);
+}
+
+void handleProtoStatus(Args&) {
+  char data[192];
+  snprintf(data, sizeof(data),
+           "{\"mode\":\"%s\",\"baud\":%u,\"telemetry_hz\":%u,\"frames_in\":%u,\"frames_out\":%u,"
+           "\"frame_errors\":%u,\"log_dropped\":%u}",
+           modeName(g_mode), static_cast<unsigned>(Serial.baudRate()), static_cast<unsigned>(g_telemetryHz),
+           static_cast<unsigned>(g_framesIn), static_cast<unsigned>(g_framesOut),
+           static_cast<unsigned>(g_frameErrors), static_cast<unsigned>(Log::dropped()));
+  printStructured("proto.status", true, nullptr, data);
+}
+
+// Boot stages a command waits for (see Boot.hpp). Stepper, buttons and the
+// console itself are up before the console first polls.
+constexpr uint8_t kNeedsStorage = Boot::bit(Boot::Stage::Storage);
+constexpr uint8_t kNeedsWifi = Boot::bit(Boot::Stage::Wifi);
+
+// Sorted by name; isSorted() below rejects a misplaced entry at compile time.
+// Add new commands here.
+constexpr ConsoleEngine::Command kCommands[] = {
+    {"base.current", handleBaseCurrent},
+    {"boot.status", handleBootStatus},
+    {"buttons.status", handleButtonsStatus},
+    {"dispense", handleDispense, kNeedsStorage},
+    {"job.abort", handleJobAbort},
+    {"job.pause", handleJobPause},
+    {"job.resume", handleJobResume},
+    {"job.start", handleJobStart, kNeedsStorage},
+    {"job.status", handleJobStatus},
+    {"metrics", handleMetrics},
+    {"motion.calibrate", handleMotionCalibrate, kNeedsStorage},
+    {"motion.profile", handleMotionProfile},
+    {"motion.status", handleMotionStatus},
+    {"motion.zero", handleMotionZero},
+    {"move", handleMove},
+    {"proto.binary", handleProtoBinary},
+    {"proto.status", handleProtoStatus},
+    {"proto.telemetry", handleProtoTelemetry},
+    {"proto.text", handleProtoText},
+    {"recipe.delete", handleRecipeDelete, kNeedsStorage},
+    {"recipe.list", handleRecipeList, kNeedsStorage},
+    {"recipe.set", handleRecipeSet, kNeedsStorage},
+    {"recipe.show", handleRecipeShow, kNeedsStorage},
+    {"rfid.status", handleRfidStatus},
+    {"stop", handleStop},
+    {"storage.flush", handleStorageFlush, kNeedsStorage},
+    {"storage.stats", handleStorageStats, kNeedsStorage},
+    {"wifi.ap", handleWifiAp, kNeedsWifi},
+    {"wifi.clear", handleWifiClear, kNeedsWifi},
+    {"wifi.connect", handleWifiConnect, kNeedsWifi},
+    {"wifi.scan", handleWifiScan, kNeedsWifi},
+    {"wifi.set", handleWifiSet, kNeedsWifi},
+    {"wifi.status", handleWifiStatus},
+    {"withdraw", handleWithdraw, kNeedsStorage},
+};
+static_assert(ConsoleEngine::isSorted(kCommands), "kCommands must be sorted by name");
+
+void dispatch(char* line) {
+  Args args(line);
+  const char* cmd = args.next();
+  if (!cmd) return;
+  if (const ConsoleEngine::Command* command = ConsoleEngine::find(kCommands, cmd)) {
+    if (Boot::ready(command->needs)) {
+      command->run(args);
+      return;
+    }
+    Boot::Stage missing = Boot::firstMissing(command->needs);
+    char message[32];
+    snprintf(message, sizeof(message), "%s %s", Boot::stageName(missing),
+             Boot::state(missing) == Boot::State::Failed ? "failed" : "not ready");
+    printStructured(cmd, false, message);
+  } else {
+    printStructured(cmd, false, "unknown command");
+  }
+}
+
+void applySwitch() {
+  if (!g_switchPending) return;
+  g_switchPending = false;
+  Serial.flush();
+  if (g_switchBaud != Serial.baudRate()) Serial.updateBaudRate(g_switchBaud);
+  g_mode = g_switchMode;
+  g_lastTelemetryUs = micros();
+}
+
+void sendError(uint8_t seq, SerialFrames::ErrorCode code, uint8_t type) {
+  SerialFrames::FrameWriter frame(Serial, SerialFrames::Error, seq);
+  frame.u8(code);
+  frame.u8(type);
+  ++g_frameErrors;
+  ++g_framesOut;
+}
+
+void handleFrame(const SerialFrames::Frame& frame) {
+  ++g_framesIn;
+  switch (frame.type) {
+    case SerialFrames::Command: {
+      if (frame.len >= kMaxLine) {
+        sendError(frame.seq, SerialFrames::TooLong, frame.type);
+        return;
+      }
+      char line[kMaxLine];
+      memcpy(line, frame.payload, frame.len);
+      line[frame.len] = '\0';
+      SerialFrames::FrameWriter reply(Serial, SerialFrames::CommandReply, frame.seq);
+      g_sink = &reply;
+      dispatch(line);
+      g_sink = &Serial;
+      ++g_framesOut;
+      return;
+    }
+    case SerialFrames::Ping: {
+      SerialFrames::FrameWriter reply(Serial, SerialFrames::Pong, frame.seq);
+      reply.u32(millis());
+      ++g_framesOut;
+      return;
+    }
+    default:
+      sendError(frame.seq, SerialFrames::UnknownType, frame.type);
+      return;
+  }
+}
+
+void sendTelemetry() {
+  if (g_telemetryHz == 0) return;
+  uint32_t now = micros();
+  uint32_t period = 1000000UL / g_telemetryHz;
+  if (now - g_lastTelemetryUs < period) return;
+  // Keep the cadence, but do not burst to catch up after a stall.
+  g_lastTelemetryUs = (now - g_lastTelemetryUs < 2 * period) ? g_lastTelemetryUs + period : now;
+
+  SerialFrames::TelemetryFrame t;
+  t.millis = millis();
+  t.positionSteps = g_stepper->position();
+  t.stepsRemaining = g_stepper->stepsRemaining();
+  uint32_t interval = g_stepper->currentIntervalUs();
+  t.intervalUs = static_cast<uint16_t>(interval > UINT16_MAX ? UINT16_MAX : interval);
+  t.rfid = g_rfid->currentTag();
+  t.flags = (g_stepper->isMoving() ? SerialFrames::kFlagMoving : 0) |
+            (g_stepper->isWithdrawing() ? SerialFrames::kFlagWithdrawing : 0) |
+            (t.rfid != 0 ? SerialFrames::kFlagTag : 0);
+  t.missedDeadlines = Metrics::missedStepDeadlines();
+
+  SerialFrames::FrameWriter frame(Serial, SerialFrames::Telemetry, g_telemetrySeq++);
+  SerialFrames::writeTelemetry(frame, t);
+  ++g_framesOut;
+}
+
+// Only this task writes to Serial, so queued log lines never land inside a
+// reply or frame.
+void writeLogs() {
+  char line[Log::kMaxLine + 1];
+  while (Log::pop(line)) {
+    if (g_mode == Mode::Binary) {
+      SerialFrames::FrameWriter frame(Serial, SerialFrames::LogLine, g_logSeq++);
+      frame.print(line);
+      ++g_framesOut;
+    } else {
+      Serial.println(line);
+    }
+  }
+}
+
+void pollText() {
+  while (g_mode == Mode::Text && Serial.available()) {
+    char* line = g_reader.push(static_cast<char>(Serial.read()));
+    if (line) dispatch(line);
+    if (g_reader.overflowed()) printStructured("console", false, "line too long");
+    applySwitch();
+  }
+}
+
+void pollBinary() {
+  while (g_mode == Mode::Binary && Serial.available()) {
+    SerialFrames::Frame frame;
+    SerialFrames::ErrorCode error;
+    switch (g_frames.push(static_cast<uint8_t>(Serial.read()), frame, error)) {
+      case decltype(g_frames)::Result::Ok:
+        handleFrame(frame);
+        break;
+      case decltype(g_frames)::Result::Error:
+        sendError(frame.seq, error, frame.type);
+        break;
+      case decltype(g_frames)::Result::None:
+        break;
+    }
+    applySwitch();
+  }
+  if (g_mode == Mode::Binary) sendTelemetry();
+}
+
+}  // namespace
+
+namespace Console {
+
+void begin(Shared::WifiManager& wifi, RfidReader& rfid, StepperControl& stepper) {
+  g_wifi = &wifi;
+  g_rfid = &rfid;
+  g_stepper = &stepper;
+  Log::attach();
+}
+
+void handleLine(const char* line) {
+  char buf[kMaxLine];
+  strlcpy(buf, line, sizeof(buf));
+  dispatch(buf);
+}
+
+// A mode switch takes effect between bytes, so whatever follows the switching
+// command is read by the other decoder.
+void poll() {
+  pollText();
+  pollBinary();
+  pollText();
+  writeLogs();
+}
+
+}  // namespace Console
@@ -0,0 +1,90 @@
+/**
+ * @file CurrentBase.cpp
+ * @brief Hot slot holding the metadata of the currently docked base.
+ */
+#include "CurrentBase.hpp"
+
+namespace {
+
+CurrentBase::Slot g_slot;
+// Bumped on every change to the slot, so a prefetch that raced with a save
+// does not overwrite the newer record.
+uint32_t g_generation = 0;
+bool g_changed = false;
+portMUX_TYPE g_mux = portMUX_INITIALIZER_UNLOCKED;
+
+}  // namespace
+
+namespace CurrentBase {
+
+void load(TagId rfid) {
+  portENTER_CRITICAL(&g_mux);
+  g_slot.rfid = rfid;
+  g_slot.known = false;
+  g_slot.info = Storage::BaseInfo();
+  uint32_t generation = ++g_generation;
+  portEXIT_CRITICAL(&g_mux);
+
+  Storage::BaseInfo info;
+  if (rfid == 0 || !Storage::loadBase(rfid, info)) return;
+
+  portENTER_CRITICAL(&g_mux);
+  if (g_generation == generation) {
+    g_slot.known = true;
+    g_slot.info = info;
+  }
+  portEXIT_CRITICAL(&g_mux);
+}
+
+void onSaved(TagId rfid, const Storage::BaseInfo& info) {
+  portENTER_CRITICAL(&g_mux);
+  if (g_slot.rfid == rfid && rfid != 0) {
+    g_slot.known = true;
+    g_slot.info = info;
+    ++g_generation;
+    g_changed = true;
+  }
+  portEXIT_CRITICAL(&g_mux);
+}
+
+void onDeleted(TagId rfid) {
+  portENTER_CRITICAL(&g_mux);
+  if (g_slot.rfid == rfid && rfid != 0) {
+    g_slot.known = false;
+    g_slot.info = Storage::BaseInfo();
+    ++g_generation;
+    g_changed = true;
+  }
+  portEXIT_CRITICAL(&g_mux);
+}
+
+bool takeChanged() {
+  portENTER_CRITICAL(&g_mux);
+  bool changed = g_changed;
+  g_changed = false;
+  portEXIT_CRITICAL(&g_mux);
+  return changed;
+}
+
+Slot get() {
+  portENTER_CRITICAL(&g_mux);
+  Slot copy = g_slot;
+  portEXIT_CRITICAL(&g_mux);
+  return copy;
+}
+
+void toJson(const Slot& slot, JsonWriter& out) {
+  out.member("rfid", slot.rfid ? Tags::Hex(slot.rfid).str : "");
+  out.member("known", slot.known);
+  if (!slot.known) return;
+  out.member("paint_name", slot.info.paintName);
+  out.member("recipe_name", slot.info.recipeName);
+  out.member("recipe_id", slot.info.recipeId);
+  out.member("notes", slot.info.notes);
+  out.member("withdraw_ul_s", slot.info.motion.withdrawUlPerSec);
+  out.member("dispense_ul_s", slot.info.motion.dispenseUlPerSec);
+  out.member("accel_ul_s2", slot.info.motion.accelUlPerSec2);
+  out.member("dwell_ms", slot.info.motion.dwellMs);
+}
+
+}  // namespace CurrentBase
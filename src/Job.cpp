@@ -0,0 +1,397 @@
+/**
+ * @file Job.cpp
+ * @brief Runs a recipe's withdraw, dwell and dispense steps on the device.
+ *
+ * Only tick() touches the running job and the stepper. start/pause/resume/
+ * abort leave a request in a one-entry mailbox and return; tick() applies it
+ * within one motion period and publishes a progress snapshot.
+ */
+#include "Job.hpp"
+
+#include <string.h>
+
+#include "Log.hpp"
+#include "Motion.hpp"
+#include "StepperControl.hpp"
+
+namespace {
+
+enum class Request : uint8_t { None, Start, Pause, Resume, Abort };
+
+StepperControl* g_stepper = nullptr;
+
+// Shared with other tasks, guarded by g_mux.
+portMUX_TYPE g_mux = portMUX_INITIALIZER_UNLOCKED;
+Request g_request = Request::None;
+Recipes::Recipe g_pendingRecipe;
+TagId g_pendingRfid = 0;
+const char* g_pendingReason = "";
+Job::Progress g_progress;
+uint32_t g_startMs = 0;
+uint32_t g_endMs = 0;
+
+// Owned by tick().
+struct Run {
+  Recipes::Recipe recipe;
+  Job::State state = Job::State::Idle;
+  TagId rfid = 0;
+  uint8_t step = 0;
+  const char* reason = "";
+  uint32_t startMs = 0;
+  uint32_t endMs = 0;
+  // Current step: whether it has begun, the target position of a move, and
+  // the remaining time of a dwell.
+  bool stepBegun = false;
+  bool moveQueued = false;
+  int32_t target = 0;
+  uint32_t dwellUntilMs = 0;
+  uint32_t dwellLeftMs = 0;
+  // Waiting out the docked base's settle time after a move.
+  bool settling = false;
+  uint32_t settleUntilMs = 0;
+};
+Run g_run;
+
+bool active(Job::State state) { return state == Job::State::Running || state == Job::State::Paused; }
+
+void publish() {
+  portENTER_CRITICAL(&g_mux);
+  g_progress.state = g_run.state;
+  memcpy(g_progress.recipeId, g_run.recipe.id, sizeof(g_progress.recipeId));
+  g_progress.rfid = g_run.rfid;
+  g_progress.step = g_run.step;
+  g_progress.stepCount = g_run.recipe.stepCount;
+  g_progress.action =
+      g_run.step < g_run.recipe.stepCount ? g_run.recipe.steps[g_run.step].action : Recipes::Action::Dwell;
+  g_progress.reason = g_run.reason;
+  ++g_progress.generation;
+  g_startMs = g_run.startMs;
+  g_endMs = g_run.endMs;
+  portEXIT_CRITICAL(&g_mux);
+}
+
+void restoreSpeed() { g_stepper->setSpeed(g_stepper->maxSpeed()); }
+
+void finish(Job::State state, const char* reason) {
+  if (g_run.moveQueued) g_stepper->cancelMoves();
+  g_run.moveQueued = false;
+  g_run.state = state;
+  g_run.reason = reason;
+  g_run.endMs = millis();
+  restoreSpeed();
+}
+
+void nextStep() {
+  ++g_run.step;
+  g_run.stepBegun = false;
+  g_run.moveQueued = false;
+  if (g_run.step >= g_run.recipe.stepCount) finish(Job::State::Done, "");
+}
+
+bool stepperIdle() { return !g_stepper->isMoving() && g_stepper->queuedMoves() == 0; }
+
+// Starts the current step once the plunger is at rest.
+void beginStep() {
+  const Recipes::Step& step = g_run.recipe.steps[g_run.step];
+  if (step.action == Recipes::Action::Dwell) {
+    // Recipes::put() bounds the dwell; clamp anyway, as the cast is undefined
+    // past UINT32_MAX.
+    float ms = step.amount < Recipes::kMaxDwellMs ? step.amount : Recipes::kMaxDwellMs;
+    g_run.dwellLeftMs = ms > 0.0f ? static_cast<uint32_t>(ms) : 0;
+    g_run.dwellUntilMs = millis() + g_run.dwellLeftMs;
+    g_run.stepBegun = true;
+    return;
+  }
+  if (!stepperIdle()) return;
+  int32_t steps = 0;
+  if (Motion::toSteps(step.amount, steps) != Motion::Result::Ok) {
+    finish(Job::State::Aborted, "volume out of range");
+    return;
+  }
+  // The stepper caps the speed at its maximum anyway; capping before the cast
+  // keeps a fast rate on a fine calibration in range.
+  uint32_t speed = g_stepper->maxSpeed();
+  float wanted = step.rate * Motion::stepsPerMicroliter();
+  if (step.rate > 0.0f && wanted < static_cast<float>(speed)) speed = static_cast<uint32_t>(wanted);
+  g_stepper->setSpeed(speed > 0 ? speed : 1);
+  g_run.target = g_stepper->position() + (step.action == Recipes::Action::Withdraw ? steps : -steps);
+  g_run.stepBegun = true;
+}
+
+// Gives the paint the docked base's settle time before the next step.
+void moveDone() {
+  uint32_t settle = Motion::settleMs();
+  if (settle == 0) {
+    nextStep();
+    return;
+  }
+  g_run.settling = true;
+  g_run.settleUntilMs = millis() + settle;
+}
+
+// Queues whatever is left of the current move, or checks it has finished.
+void advanceMove() {
+  if (!g_run.moveQueued) {
+    if (!stepperIdle()) return;
+    int32_t left = g_run.target - g_stepper->position();
+    if (left == 0) {
+      moveDone();
+      return;
+    }
+    if (!g_stepper->queueMove(left)) return;
+    g_run.moveQueued = true;
+    return;
+  }
+  if (!stepperIdle()) return;
+  g_run.moveQueued = false;
+  if (g_stepper->position() == g_run.target) {
+    moveDone();
+  } else {
+    // Cut short by a jog button or a stop command.
+    g_run.state = Job::State::Paused;
+    g_run.reason = "interrupted";
+  }
+}
+
+void advance() {
+  if (g_run.settling) {
+    if (static_cast<int32_t>(millis() - g_run.settleUntilMs) < 0) return;
+    g_run.settling = false;
+    nextStep();
+    return;
+  }
+  if (!g_run.stepBegun) {
+    beginStep();
+    if (!g_run.stepBegun || g_run.state != Job::State::Running) return;
+  }
+  if (g_run.recipe.steps[g_run.step].action == Recipes::Action::Dwell) {
+    if (static_cast<int32_t>(millis() - g_run.dwellUntilMs) >= 0) nextStep();
+  } else {
+    advanceMove();
+  }
+}
+
+void pauseRun() {
+  if (g_run.state != Job::State::Running) return;
+  if (g_run.moveQueued) {
+    g_stepper->cancelMoves();
+    g_run.moveQueued = false;
+  }
+  if (g_run.stepBegun && g_run.recipe.steps[g_run.step].action == Recipes::Action::Dwell) {
+    int32_t left = static_cast<int32_t>(g_run.dwellUntilMs - millis());
+    g_run.dwellLeftMs = left > 0 ? static_cast<uint32_t>(left) : 0;
+  }
+  g_run.state = Job::State::Paused;
+  g_run.reason = "paused";
+}
+
+void resumeRun() {
+  if (g_run.state != Job::State::Paused) return;
+  if (g_run.stepBegun && g_run.recipe.steps[g_run.step].action == Recipes::Action::Dwell) {
+    g_run.dwellUntilMs = millis() + g_run.dwellLeftMs;
+  }
+  g_run.state = Job::State::Running;
+  g_run.reason = "";
+}
+
+void startRun(const Recipes::Recipe& recipe, TagId rfid) {
+  if (active(g_run.state)) finish(Job::State::Aborted, "replaced");
+  g_run = Run();
+  g_run.recipe = recipe;
+  g_run.rfid = rfid;
+  g_run.state = Job::State::Running;
+  g_run.startMs = millis();
+}
+
+bool needsCalibration(const Recipes::Recipe& recipe) {
+  for (size_t i = 0; i < recipe.stepCount; ++i) {
+    if (recipe.steps[i].action != Recipes::Action::Dwell) return true;
+  }
+  return false;
+}
+
+Job::Result post(Request request, Job::State required) {
+  Job::Result result = Job::Result::Ok;
+  portENTER_CRITICAL(&g_mux);
+  // A pending start or abort is not overridden by a pause or resume.
+  bool pending = g_request == Request::Start || g_request == Request::Abort;
+  if (pending || g_progress.state != required) {
+    result = required == Job::State::Paused ? Job::Result::NotPaused : Job::Result::NotRunning;
+  } else {
+    g_request = request;
+  }
+  portEXIT_CRITICAL(&g_mux);
+  return result;
+}
+
+}  // namespace
+
+namespace Job {
+
+void begin(StepperControl& stepper) { g_stepper = &stepper; }
+
+Result start(const char* recipeId, TagId rfid) {
+  // Nothing could undock a job without a base, so it would run unchecked.
+  if (rfid == 0) return Result::NoBase;
+  Recipes::Recipe recipe;
+  if (!Recipes::find(recipeId, recipe)) return Result::UnknownRecipe;
+  if (needsCalibration(recipe) && Motion::stepsPerMicroliter() <= 0.0f) return Result::NotCalibrated;
+  Result result = Result::Ok;
+  portENTER_CRITICAL(&g_mux);
+  if (g_request == Request::Start || active(g_progress.state)) {
+    result = Result::Busy;
+  } else {
+    g_request = Request::Start;
+    g_pendingRecipe = recipe;
+    g_pendingRfid = rfid;
+  }
+  portEXIT_CRITICAL(&g_mux);
+  return result;
+}
+
+Result pause() { return post(Request::Pause, State::Running); }
+
+Result resume() { return post(Request::Resume, State::Paused); }
+
+Result abort() {
+  Result result = Result::Ok;
+  portENTER_CRITICAL(&g_mux);
+  if (g_request == Request::Start) {
+    g_request = Request::None;
+  } else if (active(g_progress.state)) {
+    g_request = Request::Abort;
+    g_pendingReason = "aborted";
+  } else {
+    result = Result::NotRunning;
+  }
+  portEXIT_CRITICAL(&g_mux);
+  return result;
+}
+
+void onDocked(TagId rfid, const char* recipeId) {
+  portENTER_CRITICAL(&g_mux);
+  bool ours = (g_request == Request::Start && g_pendingRfid == rfid) ||
+              (g_request != Request::Start && active(g_progress.state) && g_progress.rfid == rfid);
+  if (!ours) {
+    if (g_request == Request::Start) {
+      g_request = Request::None;
+    } else if (active(g_progress.state)) {
+      g_request = Request::Abort;
+      g_pendingReason = "base removed";
+    }
+  }
+  portEXIT_CRITICAL(&g_mux);
+  if (ours || rfid == 0 || !recipeId || !*recipeId) return;
+
+  Result result = start(recipeId, rfid);
+  if (result == Result::Busy) {
+    // The previous job's abort has not been applied yet; replace it.
+    Recipes::Recipe recipe;
+    if (!Recipes::find(recipeId, recipe)) return;
+    portENTER_CRITICAL(&g_mux);
+    g_request = Request::Start;
+    g_pendingRecipe = recipe;
+    g_pendingRfid = rfid;
+    portEXIT_CRITICAL(&g_mux);
+  } else if (result != Result::Ok && result != Result::UnknownRecipe) {
+    Log::printf("[Job] Not starting recipe %s: %s.", recipeId, describe(result));
+  }
+}
+
+void tick() {
+  if (!g_stepper) return;
+  static Recipes::Recipe recipe;
+  portENTER_CRITICAL(&g_mux);
+  Request request = g_request;
+  g_request = Request::None;
+  const char* reason = g_pendingReason;
+  TagId rfid = g_pendingRfid;
+  if (request == Request::Start) {
+    recipe = g_pendingRecipe;
+    // Counts as running from here on, so a second start() is refused.
+    g_progress.state = State::Running;
+  }
+  portEXIT_CRITICAL(&g_mux);
+
+  State before = g_run.state;
+  uint8_t beforeStep = g_run.step;
+  bool changed = request != Request::None;
+  switch (request) {
+    case Request::Start:
+      startRun(recipe, rfid);
+      break;
+    case Request::Pause:
+      pauseRun();
+      break;
+    case Request::Resume:
+      resumeRun();
+      break;
+    case Request::Abort:
+      if (active(g_run.state)) finish(State::Aborted, reason);
+      break;
+    case Request::None:
+      break;
+  }
+
+  if (g_run.state == State::Running) advance();
+  if (changed || g_run.state != before || g_run.step != beforeStep) publish();
+}
+
+Progress progress() {
+  portENTER_CRITICAL(&g_mux);
+  Progress p = g_progress;
+  uint32_t startMs = g_startMs;
+  uint32_t endMs = g_endMs;
+  portEXIT_CRITICAL(&g_mux);
+  if (p.state != State::Idle) p.elapsedMs = (active(p.state) ? millis() : endMs) - startMs;
+  return p;
+}
+
+const char* stateName(State state) {
+  switch (state) {
+    case State::Idle:
+      return "idle";
+    case State::Running:
+      return "running";
+    case State::Paused:
+      return "paused";
+    case State::Done:
+      return "done";
+    case State::Aborted:
+      return "aborted";
+  }
+  return "";
+}
+
+const char* describe(Result result) {
+  switch (result) {
+    case Result::Ok:
+      return "ok";
+    case Result::NoBase:
+      return "no base docked";
+    case Result::UnknownRecipe:
+      return "unknown recipe";
+    case Result::NotCalibrated:
+      return "not calibrated";
+    case Result::Busy:
+      return "a job is already running";
+    case Result::NotRunning:
+      return "no job running";
+    case Result::NotPaused:
+      return "job is not paused";
+  }
+  return "";
+}
+
+void toJson(const Progress& p, JsonWriter& out) {
+  out.member("state", stateName(p.state));
+  out.member("recipe_id", p.recipeId);
+  out.member("rfid", p.rfid != 0 ? Tags::Hex(p.rfid).str : "");
+  out.member("step", p.step);
+  out.member("steps", p.stepCount);
+  if (p.state == State::Running || p.state == State::Paused) out.member("action", Recipes::actionName(p.action));
+  out.member("elapsed_ms", p.elapsedMs);
+  out.member("reason", p.reason);
+}
+
+}  // namespace Job
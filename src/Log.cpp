@@ -0,0 +1,74 @@
+/**
+ * @file Log.cpp
+ * @brief Diagnostic log lines from any task, written out by the console.
+ */
+#include "Log.hpp"
+
+#include <stdarg.h>
+
+namespace {
+
+constexpr size_t kLines = LOG_QUEUE_LINES;
+
+// Any task may log, so the ring is guarded by a lock held only for a copy.
+char g_lines[kLines][Log::kMaxLine + 1];
+size_t g_head = 0;
+size_t g_count = 0;
+uint32_t g_dropped = 0;
+bool g_attached = false;
+portMUX_TYPE g_mux = portMUX_INITIALIZER_UNLOCKED;
+
+}  // namespace
+
+namespace Log {
+
+void printf(const char* format, ...) {
+  char line[kMaxLine + 1];
+  va_list args;
+  va_start(args, format);
+  int n = vsnprintf(line, sizeof(line), format, args);
+  va_end(args);
+  if (n < 0) return;
+  size_t len = strnlen(line, kMaxLine);
+  while (len > 0 && line[len - 1] == '\n') line[--len] = '\0';
+
+  portENTER_CRITICAL(&g_mux);
+  bool attached = g_attached;
+  if (attached) {
+    if (g_count == kLines) {
+      ++g_dropped;
+    } else {
+      memcpy(g_lines[(g_head + g_count) % kLines], line, len + 1);
+      ++g_count;
+    }
+  }
+  portEXIT_CRITICAL(&g_mux);
+  if (!attached) Serial.println(line);
+}
+
+void attach() {
+  portENTER_CRITICAL(&g_mux);
+  g_attached = true;
+  portEXIT_CRITICAL(&g_mux);
+}
+
+bool pop(char (&line)[kMaxLine + 1]) {
+  portENTER_CRITICAL(&g_mux);
+  bool any = g_count != 0;
+  if (any) {
+    memcpy(line, g_lines[g_head], sizeof(line));
+    g_head = (g_head + 1) % kLines;
+    --g_count;
+  }
+  portEXIT_CRITICAL(&g_mux);
+  return any;
+}
+
+uint32_t dropped() {
+  portENTER_CRITICAL(&g_mux);
+  uint32_t n = g_dropped;
+  portEXIT_CRITICAL(&g_mux);
+  return n;
+}
+
+}  // namespace Log
@@ -0,0 +1,142 @@
+/**
+ * @file Metrics.cpp
+ * @brief Per-phase latency histograms, task loop periods and step-deadline
+ *        counters.
+ */
+#include "Metrics.hpp"
+
+namespace {
+// A step whose alarm was serviced this late counts as a missed deadline.
+constexpr uint32_t kStepLateUs = 25;
+
+const char* const kPhaseNames[] = {"console", "rfid", "buttons", "web", "flash"};
+const char* const kTaskNames[] = {"motion", "rfid", "web", "console"};
+
+constexpr size_t kPhaseCount = static_cast<size_t>(Metrics::Phase::Count);
+constexpr size_t kTaskCount = static_cast<size_t>(Metrics::Task::Count);
+static_assert(sizeof(kPhaseNames) / sizeof(kPhaseNames[0]) == kPhaseCount, "phase names");
+static_assert(sizeof(kTaskNames) / sizeof(kTaskNames[0]) == kTaskCount, "task names");
+
+uint32_t g_cyclesPerUs = 160;
+Metrics::Histogram g_phases[kPhaseCount];
+// Serializes phase samples; see Metrics.hpp.
+portMUX_TYPE g_phaseMux = portMUX_INITIALIZER_UNLOCKED;
+Metrics::Histogram g_periods[kTaskCount];
+uint32_t g_lastMarkUs[kTaskCount] = {};
+Metrics::Histogram g_stepLatency;
+volatile uint32_t g_stepsLate = 0;
+uint32_t g_sinceMs = 0;
+}  // namespace
+
+namespace Metrics {
+
+void IRAM_ATTR Histogram::record(uint32_t us) {
+  size_t bucket = 0;
+  uint32_t v = us;
+  while (v && bucket + 1 < kBuckets) {
+    v >>= 1;
+    ++bucket;
+  }
+  ++m_buckets[bucket];
+  ++m_count;
+  m_sum += us;
+  if (us > m_max) m_max = us;
+}
+
+void Histogram::reset() {
+  memset(m_buckets, 0, sizeof(m_buckets));
+  m_count = 0;
+  m_max = 0;
+  m_sum = 0;
+}
+
+// Upper bound of the bucket holding the pct-th percentile sample, clamped to
+// the observed maximum.
+uint32_t Histogram::percentileUs(uint8_t pct) const {
+  if (m_count == 0) return 0;
+  uint64_t rank = (static_cast<uint64_t>(m_count) * pct + 99) / 100;
+  uint64_t seen = 0;
+  for (size_t i = 0; i < kBuckets; ++i) {
+    seen += m_buckets[i];
+    if (seen >= rank) {
+      uint32_t upper = (i == 0) ? 0 : (1UL << i) - 1;
+      return (i + 1 == kBuckets || upper > m_max) ? m_max : upper;
+    }
+  }
+  return m_max;
+}
+
+void Histogram::toJson(JsonWriter& out) const {
+  out.member("count", m_count);
+  out.member("mean_us", meanUs());
+  out.member("p99_us", percentileUs(99));
+  out.member("max_us", m_max);
+}
+
+void begin() {
+  g_cyclesPerUs = ESP.getCpuFreqMHz();
+  if (g_cyclesPerUs == 0) g_cyclesPerUs = 1;
+  reset();
+}
+
+void reset() {
+  portENTER_CRITICAL(&g_phaseMux);
+  for (Histogram& h : g_phases) h.reset();
+  portEXIT_CRITICAL(&g_phaseMux);
+  for (Histogram& h : g_periods) h.reset();
+  memset(g_lastMarkUs, 0, sizeof(g_lastMarkUs));
+  g_stepLatency.reset();
+  g_stepsLate = 0;
+  g_sinceMs = millis();
+}
+
+void recordPhase(Phase phase, uint32_t cycles) {
+  uint32_t us = cycles / g_cyclesPerUs;
+  portENTER_CRITICAL(&g_phaseMux);
+  g_phases[static_cast<size_t>(phase)].record(us);
+  portEXIT_CRITICAL(&g_phaseMux);
+}
+
+void markPeriod(Task task) {
+  size_t i = static_cast<size_t>(task);
+  uint32_t now = micros();
+  if (g_lastMarkUs[i] != 0) g_periods[i].record(now - g_lastMarkUs[i]);
+  g_lastMarkUs[i] = now;
+}
+
+void IRAM_ATTR recordStepLatency(uint32_t us) {
+  g_stepLatency.record(us);
+  if (us > kStepLateUs) g_stepsLate = g_stepsLate + 1;
+}
+
+uint32_t missedStepDeadlines() { return g_stepsLate; }
+
+void toJson(JsonWriter& out) {
+  out.member("window_ms", millis() - g_sinceMs);
+
+  out.key("phases").beginObject();
+  for (size_t i = 0; i < kPhaseCount; ++i) {
+    out.key(kPhaseNames[i]).beginObject();
+    g_phases[i].toJson(out);
+    out.endObject();
+  }
+  out.endObject();
+
+  out.key("periods").beginObject();
+  for (size_t i = 0; i < kTaskCount; ++i) {
+    out.key(kTaskNames[i]).beginObject();
+    g_periods[i].toJson(out);
+    out.endObject();
+  }
+  out.endObject();
+
+  out.key("steps").beginObject();
+  out.key("latency").beginObject();
+  g_stepLatency.toJson(out);
+  out.endObject();
+  out.member("late_threshold_us", kStepLateUs);
+  out.member("missed_deadlines", g_stepsLate);
+  out.endObject();
+}
+
+}  // namespace Metrics
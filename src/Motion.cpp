@@ -0,0 +1,292 @@
+/**
+ * @file Motion.cpp
+ * @brief Volumetric move commands and the persisted steps-per-microliter
+ *        calibration.
+ */
+#include "Motion.hpp"
+
+#include <LittleFS.h>
+#include <math.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "Checksum.hpp"
+#include "Log.hpp"
+#include "Metrics.hpp"
+#include "StepperControl.hpp"
+
+namespace {
+
+constexpr const char* kConfigPath = "/motion.cfg";
+constexpr const char* kConfigTmpPath = "/motion.cfg.tmp";
+constexpr uint32_t kConfigMagic = 0x4D434653;  // "SFCM"
+
+// Bounds on a single move and on the calibration, to catch typos before the
+// plunger hits an end stop.
+constexpr int32_t kMaxMoveSteps = 1000000;
+constexpr float kMinStepsPerUl = 0.001f;
+constexpr float kMaxStepsPerUl = 10000.0f;
+
+struct Config {
+  uint32_t magic;
+  float stepsPerUl;
+  // The STEPPER_MICROSTEPS the calibration was made at.
+  uint32_t microsteps;
+  uint32_t crc;
+};
+
+// Before microsteps were recorded; written by firmware that ran at full steps.
+struct ConfigV1 {
+  uint32_t magic;
+  float stepsPerUl;
+  uint32_t crc;
+};
+
+constexpr size_t kConfigCrcSpan = offsetof(Config, crc);
+constexpr size_t kConfigV1CrcSpan = offsetof(ConfigV1, crc);
+
+StepperControl* g_stepper = nullptr;
+float g_stepsPerUl = 0.0f;
+// The calibration changed since it was last written; guarded by
+// g_profileMutex.
+bool g_configDirty = false;
+bool g_saveFailed = false;
+
+// Profile state, guarded by g_profileMutex: the console, the web task and
+// HTTP handlers all change it.
+SemaphoreHandle_t g_profileMutex = nullptr;
+uint32_t g_maxStepsPerSec = 0;
+uint32_t g_accelStepsPerSec2 = 0;
+Storage::MotionProfile g_base;
+bool g_hasBase = false;
+// What the stepper's ramp was last built for.
+uint32_t g_builtTop = 0;
+uint32_t g_builtAccel = 0;
+volatile uint32_t g_settleMs = 0;
+
+class ProfileLock {
+ public:
+  ProfileLock() {
+    if (g_profileMutex) xSemaphoreTake(g_profileMutex, portMAX_DELAY);
+  }
+  ~ProfileLock() {
+    if (g_profileMutex) xSemaphoreGive(g_profileMutex);
+  }
+};
+
+// Steps per second (or per second squared) for a base setting; 0 when unset
+// or not yet calibrated.
+uint32_t rateSteps(float perSec) {
+  if (!(perSec > 0.0f) || g_stepsPerUl <= 0.0f) return 0;
+  float steps = roundf(perSec * g_stepsPerUl);
+  if (steps > 4.0e9f) return UINT32_MAX;
+  return steps < 1.0f ? 1 : static_cast<uint32_t>(steps);
+}
+
+// Call with the profile lock held.
+void applyProfile() {
+  uint32_t withdraw = g_hasBase ? rateSteps(g_base.withdrawUlPerSec) : 0;
+  uint32_t dispense = g_hasBase ? rateSteps(g_base.dispenseUlPerSec) : 0;
+  uint32_t accel = g_hasBase ? rateSteps(g_base.accelUlPerSec2) : 0;
+  if (accel == 0) accel = g_accelStepsPerSec2;
+  uint32_t top = g_maxStepsPerSec;
+  if (withdraw > top) top = withdraw;
+  if (dispense > top) top = dispense;
+  // Docking re-applies the profile; only rebuild the ramp when it changed.
+  if (top != g_builtTop || accel != g_builtAccel) {
+    g_stepper->setProfile(top, accel);
+    g_builtTop = top;
+    g_builtAccel = accel;
+  }
+  g_stepper->setDirectionLimits(withdraw ? withdraw : g_maxStepsPerSec, dispense ? dispense : g_maxStepsPerSec);
+  g_stepper->setSpeed(g_stepper->maxSpeed());
+  g_settleMs = g_hasBase ? g_base.dwellMs : 0;
+}
+
+bool loadConfig(float& stepsPerUl, uint32_t& microsteps) {
+  File f = LittleFS.open(kConfigPath, "r");
+  if (!f) return false;
+  Config cfg;
+  size_t n = f.read(reinterpret_cast<uint8_t*>(&cfg), sizeof(cfg));
+  f.close();
+  if (n == sizeof(Config) && cfg.magic == kConfigMagic && cfg.crc == Checksum::crc32(&cfg, kConfigCrcSpan) &&
+      cfg.microsteps != 0) {
+    stepsPerUl = cfg.stepsPerUl;
+    microsteps = cfg.microsteps;
+    return true;
+  }
+  ConfigV1 v1;
+  memcpy(&v1, &cfg, sizeof(v1));
+  if (n == sizeof(ConfigV1) && v1.magic == kConfigMagic && v1.crc == Checksum::crc32(&v1, kConfigV1CrcSpan)) {
+    stepsPerUl = v1.stepsPerUl;
+    microsteps = StepperControl::kLegacyMicrosteps;
+    return true;
+  }
+  return false;
+}
+
+// Written to a temporary file and renamed, so a power cut keeps the old value.
+bool saveConfig(float stepsPerUl) {
+  Config cfg = {};
+  cfg.magic = kConfigMagic;
+  cfg.stepsPerUl = stepsPerUl;
+  cfg.microsteps = StepperControl::kMicrosteps;
+  cfg.crc = Checksum::crc32(&cfg, kConfigCrcSpan);
+  File f = LittleFS.open(kConfigTmpPath, "w");
+  if (!f) return false;
+  bool ok = f.write(reinterpret_cast<const uint8_t*>(&cfg), sizeof(cfg)) == sizeof(cfg);
+  f.close();
+  if (!ok || !LittleFS.rename(kConfigTmpPath, kConfigPath)) {
+    LittleFS.remove(kConfigTmpPath);
+    return false;
+  }
+  return true;
+}
+
+Motion::Result queueVolume(float microliters, int sign) {
+  int32_t steps = 0;
+  Motion::Result result = Motion::toSteps(microliters, steps);
+  if (result != Motion::Result::Ok) return result;
+  return Motion::move(sign * steps);
+}
+
+}  // namespace
+
+namespace Motion {
+
+const char* describe(Result result) {
+  switch (result) {
+    case Result::Ok:
+      return "ok";
+    case Result::QueueFull:
+      return "move queue full";
+    case Result::NotCalibrated:
+      return "not calibrated";
+    case Result::BadArgument:
+      return "out of range";
+    case Result::Busy:
+      return "stepper is moving";
+  }
+  return "";
+}
+
+void begin(StepperControl& stepper) {
+  g_stepper = &stepper;
+  g_maxStepsPerSec = stepper.maxSpeed();
+  g_accelStepsPerSec2 = stepper.acceleration();
+  g_builtTop = g_maxStepsPerSec;
+  g_builtAccel = g_accelStepsPerSec2;
+  if (!g_profileMutex) g_profileMutex = xSemaphoreCreateMutex();
+}
+
+void loadCalibration() {
+  float stepsPerUl = 0.0f;
+  uint32_t microsteps = 0;
+  if (loadConfig(stepsPerUl, microsteps)) {
+    // A calibration made at other straps would over- or under-dose by their
+    // ratio; rescale it and keep the result.
+    if (microsteps != StepperControl::kMicrosteps) {
+      stepsPerUl = stepsPerUl * StepperControl::kMicrosteps / microsteps;
+      Log::printf("[Motion] Calibration was made at 1/%u microstepping; rescaled for 1/%u.",
+                  static_cast<unsigned>(microsteps), static_cast<unsigned>(StepperControl::kMicrosteps));
+    }
+    ProfileLock lock;
+    g_configDirty = microsteps != StepperControl::kMicrosteps;
+    g_stepsPerUl = stepsPerUl;
+    applyProfile();
+    Log::printf("[Motion] %.4f steps/uL.", static_cast<double>(g_stepsPerUl));
+  } else {
+    Log::printf("[Motion] Not calibrated; volumetric moves disabled.");
+  }
+}
+
+Result toSteps(float microliters, int32_t& steps) {
+  if (g_stepsPerUl <= 0.0f) return Result::NotCalibrated;
+  if (!(microliters > 0.0f)) return Result::BadArgument;
+  float rounded = roundf(microliters * g_stepsPerUl);
+  if (rounded < 1.0f || rounded > static_cast<float>(kMaxMoveSteps)) return Result::BadArgument;
+  steps = static_cast<int32_t>(rounded);
+  return Result::Ok;
+}
+
+Result withdraw(float microliters) { return queueVolume(microliters, 1); }
+
+Result dispense(float microliters) { return queueVolume(microliters, -1); }
+
+Result move(int32_t steps) {
+  if (steps == 0 || steps > kMaxMoveSteps || steps < -kMaxMoveSteps) return Result::BadArgument;
+  return g_stepper->queueMove(steps) ? Result::Ok : Result::QueueFull;
+}
+
+void stop() { g_stepper->cancelMoves(); }
+
+Result zero() { return g_stepper->setPosition(0) ? Result::Ok : Result::Busy; }
+
+float stepsPerMicroliter() { return g_stepsPerUl; }
+
+Result setStepsPerMicroliter(float stepsPerUl) {
+  if (!(stepsPerUl >= kMinStepsPerUl && stepsPerUl <= kMaxStepsPerUl)) return Result::BadArgument;
+  ProfileLock lock;
+  g_stepsPerUl = stepsPerUl;
+  g_configDirty = true;
+  applyProfile();
+  return Result::Ok;
+}
+
+void tick(bool motionIdle) {
+  if (!motionIdle) return;
+  float stepsPerUl;
+  {
+    ProfileLock lock;
+    if (!g_configDirty) return;
+    stepsPerUl = g_stepsPerUl;
+  }
+  bool ok;
+  {
+    Metrics::PhaseTimer timer(Metrics::Phase::Flash);
+    ok = saveConfig(stepsPerUl);
+  }
+  if (!ok && !g_saveFailed) Log::printf("[Motion] Failed to save the calibration; retrying.");
+  g_saveFailed = !ok;
+  ProfileLock lock;
+  // A newer calibration set meanwhile still needs its own write.
+  if (ok && g_stepsPerUl == stepsPerUl) g_configDirty = false;
+}
+
+void setProfile(uint32_t maxStepsPerSec, uint32_t accelStepsPerSec2) {
+  if (maxStepsPerSec == 0) return;
+  ProfileLock lock;
+  g_maxStepsPerSec = maxStepsPerSec;
+  if (accelStepsPerSec2 != 0) g_accelStepsPerSec2 = accelStepsPerSec2;
+  applyProfile();
+}
+
+void useBaseProfile(const Storage::MotionProfile* profile) {
+  ProfileLock lock;
+  g_hasBase = profile != nullptr;
+  g_base = profile ? *profile : Storage::MotionProfile();
+  applyProfile();
+}
+
+uint32_t settleMs() { return g_settleMs; }
+
+void toJson(JsonWriter& out) {
+  int32_t position = g_stepper->position();
+  out.member("position_steps", position);
+  if (g_stepsPerUl > 0.0f) {
+    out.member("position_ul", position / g_stepsPerUl);
+  } else {
+    out.key("position_ul").null();
+  }
+  out.member("steps_per_ul", g_stepsPerUl);
+  out.member("microsteps", StepperControl::kMicrosteps);
+  out.member("max_steps_per_sec", g_stepper->maxSpeed());
+  out.member("base_profile", g_hasBase);
+  out.member("settle_ms", g_settleMs);
+  out.member("moving", g_stepper->isMoving());
+  out.member("steps_remaining", g_stepper->stepsRemaining());
+  out.member("queued", g_stepper->queuedMoves());
+  out.member("queue_capacity", StepperControl::kMoveQueueLength);
+}
+
+}  // namespace Motion
@@ -0,0 +1,294 @@
+/**
+ * @file Recipes.cpp
+ * @brief Fill recipes kept in RAM and persisted to one LittleFS file.
+ *
+ * The file is a header followed by one CRC-checked record per recipe. It is
+ * small and changes rarely, so it is rewritten whole through a temporary file
+ * and a rename. Changes take effect in RAM at once and reach the file from
+ * tick() once the plunger is at rest, since flash writes hold off the step
+ * ISR.
+ */
+#include "Recipes.hpp"
+
+#include <LittleFS.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "Checksum.hpp"
+#include "Log.hpp"
+#include "Metrics.hpp"
+
+namespace {
+
+constexpr const char* kPath = "/recipes.db";
+constexpr const char* kTmpPath = "/recipes.db.tmp";
+constexpr uint32_t kMagic = 0x52434653;  // "SFCR"
+constexpr uint16_t kVersion = 1;
+
+struct Header {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t recordSize;
+  uint32_t count;
+  uint32_t crc;
+};
+
+struct Record {
+  Recipes::Recipe recipe;
+  uint32_t crc;
+};
+
+static_assert(sizeof(Recipes::Step) == 12, "Step layout is part of the file format");
+static_assert(sizeof(Recipes::Recipe) == 220, "Recipe layout is part of the file format");
+
+constexpr size_t kHeaderCrcSpan = offsetof(Header, crc);
+constexpr size_t kRecordCrcSpan = offsetof(Record, crc);
+
+// Sorted by id.
+Recipes::Recipe g_recipes[Recipes::kMaxRecipes];
+size_t g_count = 0;
+// Changed since the file was last written.
+bool g_dirty = false;
+bool g_saveFailed = false;
+SemaphoreHandle_t g_mutex = nullptr;
+
+class Lock {
+ public:
+  Lock() {
+    if (g_mutex) xSemaphoreTake(g_mutex, portMAX_DELAY);
+  }
+  ~Lock() {
+    if (g_mutex) xSemaphoreGive(g_mutex);
+  }
+};
+
+size_t lowerBound(const char* id) {
+  size_t lo = 0;
+  size_t hi = g_count;
+  while (lo < hi) {
+    size_t mid = (lo + hi) / 2;
+    if (strcmp(g_recipes[mid].id, id) < 0) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+bool validId(const char* id) {
+  size_t len = strnlen(id, sizeof(Recipes::Recipe::id));
+  if (len == 0 || len == sizeof(Recipes::Recipe::id)) return false;
+  for (size_t i = 0; i < len; ++i) {
+    char c = id[i];
+    bool ok = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '-' || c == '_' ||
+              c == '.';
+    if (!ok) return false;
+  }
+  return true;
+}
+
+bool validRecipe(const Recipes::Recipe& r) {
+  if (!validId(r.id) || r.stepCount == 0 || r.stepCount > Recipes::kMaxSteps) return false;
+  for (size_t i = 0; i < r.stepCount; ++i) {
+    const Recipes::Step& s = r.steps[i];
+    if (s.action != Recipes::Action::Withdraw && s.action != Recipes::Action::Dwell &&
+        s.action != Recipes::Action::Dispense) {
+      return false;
+    }
+    float maxAmount = s.action == Recipes::Action::Dwell ? Recipes::kMaxDwellMs : Recipes::kMaxStepUl;
+    if (!(s.amount > 0.0f && s.amount <= maxAmount) || !(s.rate >= 0.0f && s.rate <= Recipes::kMaxRateUlPerSec)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool saveAll() {
+  File f = LittleFS.open(kTmpPath, "w");
+  if (!f) return false;
+  Header h = {};
+  h.magic = kMagic;
+  h.version = kVersion;
+  h.recordSize = sizeof(Record);
+  h.count = g_count;
+  h.crc = Checksum::crc32(&h, kHeaderCrcSpan);
+  bool ok = f.write(reinterpret_cast<const uint8_t*>(&h), sizeof(h)) == sizeof(h);
+  for (size_t i = 0; ok && i < g_count; ++i) {
+    Record rec;
+    rec.recipe = g_recipes[i];
+    rec.crc = Checksum::crc32(&rec, kRecordCrcSpan);
+    ok = f.write(reinterpret_cast<const uint8_t*>(&rec), sizeof(rec)) == sizeof(rec);
+  }
+  f.close();
+  if (!ok || !LittleFS.rename(kTmpPath, kPath)) {
+    LittleFS.remove(kTmpPath);
+    return false;
+  }
+  return true;
+}
+
+void loadAll() {
+  g_count = 0;
+  File f = LittleFS.open(kPath, "r");
+  if (!f) return;
+  Header h;
+  if (f.read(reinterpret_cast<uint8_t*>(&h), sizeof(h)) != sizeof(h) || h.magic != kMagic ||
+      h.crc != Checksum::crc32(&h, kHeaderCrcSpan) || h.recordSize != sizeof(Record)) {
+    f.close();
+    Log::printf("[Recipes] Ignoring unreadable recipe file.");
+    return;
+  }
+  for (uint32_t i = 0; i < h.count && g_count < Recipes::kMaxRecipes; ++i) {
+    Record rec;
+    if (f.read(reinterpret_cast<uint8_t*>(&rec), sizeof(rec)) != sizeof(rec)) break;
+    if (rec.crc != Checksum::crc32(&rec, kRecordCrcSpan) || !validRecipe(rec.recipe)) continue;
+    size_t at = lowerBound(rec.recipe.id);
+    if (at < g_count && strcmp(g_recipes[at].id, rec.recipe.id) == 0) continue;
+    memmove(&g_recipes[at + 1], &g_recipes[at], (g_count - at) * sizeof(Recipes::Recipe));
+    g_recipes[at] = rec.recipe;
+    ++g_count;
+  }
+  f.close();
+}
+
+}  // namespace
+
+namespace Recipes {
+
+bool init() {
+  if (!g_mutex) g_mutex = xSemaphoreCreateMutex();
+  Lock lock;
+  loadAll();
+  g_dirty = false;
+  Log::printf("[Recipes] %u recipes.", static_cast<unsigned>(g_count));
+  return true;
+}
+
+bool find(const char* id, Recipe& out) {
+  if (!id || !*id) return false;
+  Lock lock;
+  size_t i = lowerBound(id);
+  if (i >= g_count || strcmp(g_recipes[i].id, id) != 0) return false;
+  out = g_recipes[i];
+  return true;
+}
+
+bool put(const Recipe& recipe) {
+  if (!validRecipe(recipe)) return false;
+  Lock lock;
+  size_t i = lowerBound(recipe.id);
+  if (i >= g_count || strcmp(g_recipes[i].id, recipe.id) != 0) {
+    if (g_count == kMaxRecipes) return false;
+    memmove(&g_recipes[i + 1], &g_recipes[i], (g_count - i) * sizeof(Recipe));
+    ++g_count;
+  }
+  g_recipes[i] = recipe;
+  g_dirty = true;
+  return true;
+}
+
+bool erase(const char* id) {
+  Lock lock;
+  size_t i = lowerBound(id);
+  if (i >= g_count || strcmp(g_recipes[i].id, id) != 0) return false;
+  memmove(&g_recipes[i], &g_recipes[i + 1], (g_count - i - 1) * sizeof(Recipe));
+  --g_count;
+  g_dirty = true;
+  return true;
+}
+
+void tick(bool motionIdle) {
+  if (!motionIdle) return;
+  Lock lock;
+  if (!g_dirty) return;
+  bool ok;
+  {
+    Metrics::PhaseTimer timer(Metrics::Phase::Flash);
+    ok = saveAll();
+  }
+  g_dirty = !ok;
+  // Retried on every tick; only say so once per failure streak.
+  if (!ok && !g_saveFailed) Log::printf("[Recipes] Failed to save recipes; retrying.");
+  g_saveFailed = !ok;
+}
+
+size_t count() {
+  Lock lock;
+  return g_count;
+}
+
+size_t listIds(char (*out)[24], size_t max) {
+  Lock lock;
+  size_t n = g_count < max ? g_count : max;
+  for (size_t i = 0; i < n; ++i) memcpy(out[i], g_recipes[i].id, sizeof(out[i]));
+  return n;
+}
+
+const char* actionName(Action action) {
+  switch (action) {
+    case Action::Withdraw:
+      return "withdraw";
+    case Action::Dwell:
+      return "dwell";
+    case Action::Dispense:
+      return "dispense";
+  }
+  return "";
+}
+
+bool parseAction(const char* name, Action& out) {
+  if (!name) return false;
+  if (strcmp(name, "withdraw") == 0) {
+    out = Action::Withdraw;
+  } else if (strcmp(name, "dwell") == 0) {
+    out = Action::Dwell;
+  } else if (strcmp(name, "dispense") == 0) {
+    out = Action::Dispense;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+void toJson(const Recipe& recipe, JsonWriter& out) {
+  out.member("id", recipe.id);
+  out.key("steps").beginArray();
+  for (size_t i = 0; i < recipe.stepCount; ++i) {
+    const Step& s = recipe.steps[i];
+    out.beginObject();
+    out.member("action", actionName(s.action));
+    if (s.action == Action::Dwell) {
+      out.member("ms", s.amount);
+    } else {
+      out.member("ul", s.amount);
+      out.member("rate_ul_s", s.rate);
+    }
+    out.endObject();
+  }
+  out.endArray();
+}
+
+const char* fromJson(JsonObjectConst in, Recipe& out) {
+  JsonArrayConst steps = in["steps"].as<JsonArrayConst>();
+  if (steps.isNull() || steps.size() == 0) return "steps required";
+  if (steps.size() > kMaxSteps) return "too many steps";
+  out.stepCount = 0;
+  for (JsonVariantConst item : steps) {
+    JsonObjectConst step = item.as<JsonObjectConst>();
+    Step& s = out.steps[out.stepCount];
+    s = Step();
+    if (!parseAction(step["action"] | "", s.action)) return "unknown action";
+    s.amount = s.action == Action::Dwell ? (step["ms"] | 0.0f) : (step["ul"] | 0.0f);
+    s.rate = s.action == Action::Dwell ? 0.0f : (step["rate_ul_s"] | 0.0f);
+    if (!(s.amount > 0.0f) || !(s.rate >= 0.0f)) return "amounts must be positive";
+    if (s.amount > (s.action == Action::Dwell ? kMaxDwellMs : kMaxStepUl) || s.rate > kMaxRateUlPerSec) {
+      return "amount or rate too large";
+    }
+    ++out.stepCount;
+  }
+  if (!validId(out.id)) return "invalid recipe id";
+  return nullptr;
+}
+
+}  // namespace Recipes
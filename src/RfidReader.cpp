@@ -7,21 +7,21 @@
 #include <Adafruit_PN532.h>
 #include <Wire.h>
 
+#include "Log.hpp"
 #include "Pins.hpp"
 
 namespace {
 Adafruit_PN532 nfc(Pins::PN532_IRQ, Pins::PN532_RST, &Wire);
-constexpr uint16_t kReadTimeoutMs = 120;
-
-uint32_t uidToRfid(const uint8_t* uid, uint8_t len) {
-  if (len == 0) return 0;
-  uint32_t value = 0;
-  uint8_t start = len > 4 ? len - 4 : 0;
-  for (uint8_t i = start; i < len; ++i) {
-    value = (value << 8) | uid[i];
-  }
-  return value;
-}
+constexpr uint32_t kPollIntervalMs = 200;
+constexpr uint32_t kDetectTimeoutMs = 150;
+// InListPassiveTarget gives up after this many activation attempts and
+// answers "no target", so the IRQ still falls when the field is empty.
+constexpr uint8_t kPassiveActivationRetries = 0x10;
+// ISO 14443-3 UIDs are 4, 7 or 10 bytes.
+constexpr uint8_t kMaxUidLength = 10;
+// Consecutive polls without a tag before the docked one counts as removed.
+// A tag at the edge of the field can miss a single poll.
+constexpr uint8_t kMissesToUndock = 3;
 }  // namespace
 
 bool RfidReader::begin() {
@@ -32,25 +32,86 @@ bool RfidReader::begin() {
   nfc.begin();
   uint32_t verdata = nfc.getFirmwareVersion();
   if (!verdata) {
-    Serial.println(F("[RFID] PN532 not found on I2C. Check wiring and DIP switches."));
+    Log::printf("[RFID] PN532 not found on I2C. Check wiring and DIP switches.");
     return false;
   }
 
-  Serial.print(F("[RFID] PN532 found. IC: 0x"));
-  Serial.println((verdata >> 24) & 0xFF, HEX);
+  Log::printf("[RFID] PN532 found. IC: 0x%X", static_cast<unsigned>((verdata >> 24) & 0xFF));
   nfc.SAMConfig();
+  nfc.setPassiveActivationRetries(kPassiveActivationRetries);
+  m_state = State::Idle;
+  m_stateSinceMs = millis();
   return true;
 }
 
+TagId RfidReader::currentTag() const {
+  portENTER_CRITICAL(&m_mux);
+  TagId tag = m_currentTag;
+  portEXIT_CRITICAL(&m_mux);
+  return tag;
+}
+
 void RfidReader::poll() {
-  uint8_t uid[7] = {0};
-  uint8_t uidLength = 0;
-  bool success = nfc.readPassiveTargetID(PN532_MIFARE_ISO14443A, uid, &uidLength, kReadTimeoutMs);
-  if (!success) return;
-
-  uint32_t tag = uidToRfid(uid, uidLength);
-  if (tag != 0 && tag != m_currentTag) {
-    m_currentTag = tag;
-    Serial.printf("[RFID] Tag detected: 0x%08X\n", m_currentTag);
+  uint32_t startUs = micros();
+  step(millis());
+  m_lastPollUs = micros() - startUs;
+  if (m_lastPollUs > m_maxPollUs) m_maxPollUs = m_lastPollUs;
+}
+
+void RfidReader::step(uint32_t nowMs) {
+  switch (m_state) {
+    case State::Offline:
+      return;
+
+    case State::Idle:
+      if (nowMs - m_stateSinceMs < kPollIntervalMs) return;
+      if (nfc.startPassiveTargetIDDetection(PN532_MIFARE_ISO14443A)) {
+        m_state = State::Waiting;
+      }
+      m_stateSinceMs = nowMs;
+      return;
+
+    case State::Waiting: {
+      if (digitalRead(Pins::PN532_IRQ) != LOW) {
+        // A new command aborts the pending one, so a lost response just
+        // costs one poll interval.
+        if (nowMs - m_stateSinceMs >= kDetectTimeoutMs) {
+          m_state = State::Idle;
+          missedPoll();
+        }
+        return;
+      }
+
+      m_state = State::Idle;
+      uint8_t uid[kMaxUidLength] = {0};
+      uint8_t uidLength = 0;
+      if (!nfc.readDetectedPassiveTargetID(uid, &uidLength)) {
+        missedPoll();
+        return;
+      }
+
+      TagId tag = Tags::fromUid(uid, uidLength);
+      if (tag == 0) {
+        missedPoll();
+        return;
+      }
+      m_misses = 0;
+      if (tag != m_currentTag) {
+        portENTER_CRITICAL(&m_mux);
+        m_currentTag = tag;
+        portEXIT_CRITICAL(&m_mux);
+        Log::printf("[RFID] Tag detected: 0x%s", Tags::Hex(tag).str);
+      }
+      return;
+    }
   }
 }
+
+void RfidReader::missedPoll() {
+  if (m_currentTag == 0 || ++m_misses < kMissesToUndock) return;
+  m_misses = 0;
+  Log::printf("[RFID] Tag removed: 0x%s", Tags::Hex(m_currentTag).str);
+  portENTER_CRITICAL(&m_mux);
+  m_currentTag = 0;
+  portEXIT_CRITICAL(&m_mux);
+}
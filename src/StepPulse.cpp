@@ -0,0 +1,103 @@
+/**
+ * @file StepPulse.cpp
+ * @brief STEP pin output for StepperControl: RMT pulse trains, or a portable
+ *        digitalWrite fallback.
+ */
+#include "StepPulse.hpp"
+
+#if STEPPER_PULSE_RMT
+#include <driver/rmt.h>
+#endif
+
+#include "Log.hpp"
+
+namespace {
+
+int g_pin = -1;
+uint32_t g_pulseUs = 0;
+
+#if STEPPER_PULSE_RMT
+constexpr rmt_channel_t kChannel = RMT_CHANNEL_0;
+// RMT durations are 15 bits; the 80 divider makes them microseconds.
+constexpr uint8_t kClockDivider = 80;
+constexpr uint32_t kMaxDurationUs = 32767;
+
+// Built by the step ISR; one spare slot for the end marker.
+rmt_item32_t g_train[StepPulse::kMaxTrain + 1];
+size_t g_trainLen = 0;
+uint32_t g_trainUs = 0;
+uint32_t g_startUs = 0;
+uint32_t g_playUs = 0;
+#endif
+
+}  // namespace
+
+namespace StepPulse {
+
+#if STEPPER_PULSE_RMT
+
+bool begin(int pin, uint32_t pulseUs) {
+  g_pin = pin;
+  g_pulseUs = pulseUs;
+  rmt_config_t config = RMT_DEFAULT_CONFIG_TX(static_cast<gpio_num_t>(pin), kChannel);
+  config.clk_div = kClockDivider;
+  config.tx_config.idle_output_en = true;
+  config.tx_config.idle_level = RMT_IDLE_LEVEL_LOW;
+  if (rmt_config(&config) != ESP_OK || rmt_driver_install(kChannel, 0, 0) != ESP_OK) {
+    Log::printf("[Stepper] Failed to set up the RMT channel.");
+    return false;
+  }
+  return true;
+}
+
+const char* name() { return "rmt"; }
+
+void IRAM_ATTR add(uint32_t intervalUs) {
+  if (g_trainLen >= kMaxTrain) return;
+  uint32_t low = intervalUs > g_pulseUs ? intervalUs - g_pulseUs : 1;
+  if (low > kMaxDurationUs) low = kMaxDurationUs;
+  rmt_item32_t& item = g_train[g_trainLen++];
+  item.level0 = 1;
+  item.duration0 = g_pulseUs;
+  item.level1 = 0;
+  item.duration1 = low;
+  g_trainUs += g_pulseUs + low;
+}
+
+// The step ISR is not allocated in IRAM by the core's timer driver, so it is
+// held off during flash writes and may call into the (flash-resident) RMT
+// driver here. Storage defers its batched commits and compaction until the
+// plunger is at rest for the same reason.
+void IRAM_ATTR start() {
+  if (g_trainLen == 0) return;
+  rmt_item32_t& last = g_train[g_trainLen - 1];
+  g_trainUs -= last.duration1 - 1;
+  last.duration1 = 1;
+  g_train[g_trainLen].val = 0;
+  rmt_fill_tx_items(kChannel, g_train, g_trainLen + 1, 0);
+  rmt_tx_start(kChannel, true);
+  g_startUs = micros();
+  g_playUs = g_trainUs;
+  g_trainLen = 0;
+  g_trainUs = 0;
+}
+
+bool IRAM_ATTR busy() { return micros() - g_startUs < g_playUs; }
+
+#else
+
+bool begin(int pin, uint32_t pulseUs) {
+  g_pin = pin;
+  g_pulseUs = pulseUs;
+  pinMode(pin, OUTPUT);
+  digitalWrite(pin, LOW);
+  return true;
+}
+
+const char* name() { return "gpio"; }
+
+void IRAM_ATTR write(bool high) { digitalWrite(g_pin, high ? HIGH : LOW); }
+
+#endif
+
+}  // namespace StepPulse
@@ -0,0 +1,325 @@
+/**
+ * @file StepperControl.cpp
+ * @brief Hardware-timer step generation for the A4988 plunger driver.
+ */
+#include "StepperControl.hpp"
+
+#include <math.h>
+
+#include "Log.hpp"
+#include "Metrics.hpp"
+#include "Pins.hpp"
+#include "StepPulse.hpp"
+
+#ifndef STEPPER_TRAIN_US
+#define STEPPER_TRAIN_US 500
+#endif
+
+namespace {
+// 3750 full steps/s at 15000 full steps/s^2, the plunger speed before
+// microstepping, kept for any strap setting: 60000 steps/s at 1/16.
+constexpr uint32_t kDefaultMaxStepsPerSec =
+    3750UL * StepperControl::kMicrosteps / StepperControl::kLegacyMicrosteps;
+constexpr uint32_t kDefaultAccelStepsPerSec2 =
+    15000UL * StepperControl::kMicrosteps / StepperControl::kLegacyMicrosteps;
+static_assert(static_cast<uint64_t>(kDefaultMaxStepsPerSec) * kDefaultMaxStepsPerSec /
+                      (2 * kDefaultAccelStepsPerSec2) <
+                  StepperControl::kMaxRampSteps,
+              "STEPPER_RAMP_STEPS too short to reach the default speed");
+constexpr uint32_t kMinIntervalUs = StepPulse::kMinIntervalUs;
+constexpr uint32_t kStepPulseWidthUs = 3;
+// Longest pulse train per alarm; bounds how late a stop or a new move is
+// picked up.
+constexpr uint32_t kTrainUs = STEPPER_TRAIN_US;
+// Re-check interval when an alarm finds the previous train still playing.
+constexpr uint32_t kTrainBusyUs = 2;
+constexpr uint32_t kDirSetupUs = 5;
+constexpr uint32_t kIdleTickUs = 250;
+constexpr bool kWithdrawDirHigh = true;
+
+constexpr uint8_t kTimerIndex = 0;
+constexpr uint16_t kTimerDivider = 80;  // 80 MHz APB -> 1 us ticks
+
+StepperControl* g_instance = nullptr;
+
+// Interval before step i when accelerating from rest at constant
+// acceleration: t(i) = sqrt(2i / a), so interval(i) = t(i + 1) - t(i).
+size_t buildRamp(uint16_t* table, size_t capacity, uint32_t minIntervalUs, uint32_t accel) {
+  double prev = 0.0;
+  size_t len = 0;
+  while (len < capacity) {
+    double t = sqrt(2.0 * static_cast<double>(len + 1) / accel);
+    double interval = (t - prev) * 1e6;
+    prev = t;
+    if (interval > UINT16_MAX) interval = UINT16_MAX;
+    if (interval <= minIntervalUs) {
+      table[len++] = static_cast<uint16_t>(minIntervalUs);
+      break;
+    }
+    table[len++] = static_cast<uint16_t>(interval);
+  }
+  return len;
+}
+}  // namespace
+
+bool StepperControl::begin() {
+  if (!StepPulse::begin(Pins::STEPPER_STEP, kStepPulseWidthUs)) return false;
+  pinMode(Pins::STEPPER_DIR, OUTPUT);
+  digitalWrite(Pins::STEPPER_DIR, kWithdrawDirHigh ? LOW : HIGH);
+  m_withdraw = false;
+  m_dirApplied = false;
+  setProfile(kDefaultMaxStepsPerSec, kDefaultAccelStepsPerSec2);
+  setSpeed(kDefaultMaxStepsPerSec);
+
+  g_instance = this;
+  m_timer = timerBegin(kTimerIndex, kTimerDivider, true);
+  if (!m_timer) {
+    Log::printf("[Stepper] Failed to allocate step timer.");
+    return false;
+  }
+  timerAttachInterrupt(m_timer, &StepperControl::onTimer, true);
+  timerAlarmWrite(m_timer, kIdleTickUs, true);
+  timerAlarmEnable(m_timer);
+  return true;
+}
+
+void StepperControl::setProfile(uint32_t maxStepsPerSec, uint32_t accelStepsPerSec2) {
+  if (maxStepsPerSec == 0 || accelStepsPerSec2 == 0) return;
+  uint32_t minInterval = 1000000UL / maxStepsPerSec;
+  if (minInterval < kMinIntervalUs) minInterval = kMinIntervalUs;
+
+  uint16_t* spare = (m_ramp == m_rampTables[0]) ? m_rampTables[1] : m_rampTables[0];
+  size_t len = buildRamp(spare, kMaxRampSteps, minInterval, accelStepsPerSec2);
+
+  // Resume on the new ramp at the first entry no slower than the current
+  // speed, so a profile change mid-move does not jerk the plunger.
+  portENTER_CRITICAL(&m_mux);
+  size_t index = 0;
+  if (m_active) {
+    uint16_t current = m_ramp[m_rampIndex];
+    while (index + 1 < len && spare[index] > current) ++index;
+  }
+  m_ramp = spare;
+  m_rampLen = len;
+  m_rampIndex = index;
+  if (m_targetIntervalUs < minInterval) m_targetIntervalUs = minInterval;
+  portEXIT_CRITICAL(&m_mux);
+
+  m_maxStepsPerSec = 1000000UL / spare[len - 1];
+  m_accelStepsPerSec2 = accelStepsPerSec2;
+}
+
+void StepperControl::setDirectionLimits(uint32_t withdrawStepsPerSec, uint32_t dispenseStepsPerSec) {
+  m_limitIntervalUs[1] = withdrawStepsPerSec ? 1000000UL / withdrawStepsPerSec : 0;
+  m_limitIntervalUs[0] = dispenseStepsPerSec ? 1000000UL / dispenseStepsPerSec : 0;
+}
+
+void StepperControl::setDirection(bool withdraw) {
+  m_withdraw = withdraw;
+}
+
+void StepperControl::setSpeed(uint32_t stepsPerSec) {
+  if (stepsPerSec == 0) return;
+  uint32_t interval = 1000000UL / stepsPerSec;
+  uint32_t minInterval = m_rampLen ? m_ramp[m_rampLen - 1] : kMinIntervalUs;
+  if (interval < minInterval) interval = minInterval;
+  m_targetIntervalUs = interval;
+}
+
+void StepperControl::setMoving(bool moving) {
+  portENTER_CRITICAL(&m_mux);
+  if (moving && !m_run) m_budget = kUnlimitedSteps;
+  m_run = moving;
+  portEXIT_CRITICAL(&m_mux);
+}
+
+void StepperControl::moveSteps(uint32_t steps) {
+  portENTER_CRITICAL(&m_mux);
+  m_budget = steps;
+  m_run = steps != 0;
+  portEXIT_CRITICAL(&m_mux);
+}
+
+void StepperControl::halt() {
+  portENTER_CRITICAL(&m_mux);
+  m_moveTail = m_moveHead;
+  m_run = false;
+  m_budget = 0;
+  m_active = false;
+  m_rampIndex = 0;
+  portEXIT_CRITICAL(&m_mux);
+}
+
+bool StepperControl::queueMove(int32_t steps) {
+  if (steps == 0) return false;
+  portENTER_CRITICAL(&m_mux);
+  bool ok = m_moveHead - m_moveTail < kMoveQueueLength;
+  if (ok) m_moves[m_moveHead++ % kMoveQueueLength] = steps;
+  portEXIT_CRITICAL(&m_mux);
+  return ok;
+}
+
+void StepperControl::cancelMoves() {
+  portENTER_CRITICAL(&m_mux);
+  m_moveTail = m_moveHead;
+  m_run = false;
+  portEXIT_CRITICAL(&m_mux);
+}
+
+void IRAM_ATTR StepperControl::jogFromIsr(bool withdraw, uint32_t steps) {
+  portENTER_CRITICAL_ISR(&m_mux);
+  m_moveTail = m_moveHead;
+  m_withdraw = withdraw;
+  m_budget = steps;
+  m_run = steps != 0;
+  portEXIT_CRITICAL_ISR(&m_mux);
+}
+
+void IRAM_ATTR StepperControl::stopFromIsr() {
+  portENTER_CRITICAL_ISR(&m_mux);
+  m_moveTail = m_moveHead;
+  m_run = false;
+  portEXIT_CRITICAL_ISR(&m_mux);
+}
+
+size_t StepperControl::queuedMoves() const {
+  portENTER_CRITICAL(&m_mux);
+  size_t n = m_moveHead - m_moveTail;
+  portEXIT_CRITICAL(&m_mux);
+  return n;
+}
+
+bool StepperControl::setPosition(int32_t steps) {
+  portENTER_CRITICAL(&m_mux);
+  bool idle = !m_active && !(m_run && m_budget != 0) && m_moveHead == m_moveTail;
+  if (idle) m_position = steps;
+  portEXIT_CRITICAL(&m_mux);
+  return idle;
+}
+
+void IRAM_ATTR StepperControl::onTimer() {
+  if (g_instance) g_instance->service();
+}
+
+void IRAM_ATTR StepperControl::scheduleNext(uint32_t us) {
+  timerAlarmWrite(m_timer, us, true);
+}
+
+// Picks the interval until the next step from the ramp table. Decelerates
+// when stopping, when the remaining budget equals the steps needed to brake,
+// or when the target speed dropped below the current one.
+uint32_t IRAM_ATTR StepperControl::nextInterval(bool cruise) {
+  uint32_t target = m_targetIntervalUs;
+  uint32_t limit = m_limitIntervalUs[m_dirApplied ? 1 : 0];
+  if (target < limit) target = limit;
+  uint32_t remaining = m_budget;
+  uint32_t interval = m_ramp[m_rampIndex];
+  bool brake = !cruise || (remaining != kUnlimitedSteps && remaining <= m_rampIndex) || interval < target;
+  if (brake) {
+    if (m_rampIndex > 0) --m_rampIndex;
+  } else if (interval > target && m_rampIndex + 1 < m_rampLen) {
+    ++m_rampIndex;
+  }
+  return interval < target ? target : interval;
+}
+
+// Loads the next queued move into the run state. Called from the ISR at rest.
+bool IRAM_ATTR StepperControl::startQueuedMove() {
+  if (m_moveHead == m_moveTail) return false;
+  int32_t steps = m_moves[m_moveTail++ % kMoveQueueLength];
+  m_withdraw = steps > 0;
+  m_budget = steps > 0 ? static_cast<uint32_t>(steps) : static_cast<uint32_t>(-static_cast<int64_t>(steps));
+  m_run = true;
+  return true;
+}
+
+// Steps are taken in trains of up to StepPulse::kMaxTrain, cut short at
+// kTrainUs, at the end of the move, or when a brake reaches rest. Returns the
+// time until the step after the train.
+uint32_t IRAM_ATTR StepperControl::emitSteps(bool cruise) {
+  uint32_t span = 0;
+  size_t count = 0;
+  do {
+    m_position = m_position + (m_dirApplied ? 1 : -1);
+    if (m_budget != kUnlimitedSteps) --m_budget;
+    uint32_t interval = nextInterval(cruise);
+#if STEPPER_PULSE_RMT
+    StepPulse::add(interval);
+#endif
+    m_nextIntervalUs = interval;
+    span += interval;
+    ++count;
+  } while (count < StepPulse::kMaxTrain && span < kTrainUs && m_budget != 0 && (cruise || m_rampIndex > 0));
+  return span;
+}
+
+// With the fallback backend each step is split across two alarms: the rising
+// edge, then the falling edge one pulse width later, so the ISR never
+// busy-waits. With RMT one alarm starts a whole train.
+void IRAM_ATTR StepperControl::service() {
+  // The alarm auto-reloads the counter to zero, so its value here is how
+  // late this interrupt is being serviced.
+  uint32_t latencyUs = static_cast<uint32_t>(timerRead(m_timer));
+  portENTER_CRITICAL_ISR(&m_mux);
+#if STEPPER_PULSE_RMT
+  // Late service of the previous alarm can leave its train still playing.
+  if (StepPulse::busy()) {
+    scheduleNext(kTrainBusyUs);
+    portEXIT_CRITICAL_ISR(&m_mux);
+    return;
+  }
+#else
+  if (m_pulseHigh) {
+    StepPulse::write(false);
+    m_pulseHigh = false;
+    uint32_t interval = m_nextIntervalUs;
+    scheduleNext(interval > kStepPulseWidthUs ? interval - kStepPulseWidthUs : 1);
+    portEXIT_CRITICAL_ISR(&m_mux);
+    return;
+  }
+#endif
+
+  bool wantRun = m_run && m_budget != 0;
+  bool reverse = m_withdraw != m_dirApplied;
+
+  if (m_active && (m_budget == 0 || ((!wantRun || reverse) && m_rampIndex == 0))) {
+    m_active = false;
+    if (m_budget == 0) m_run = false;
+  }
+
+  if (!m_active) {
+    if (!wantRun && startQueuedMove()) {
+      wantRun = true;
+      reverse = m_withdraw != m_dirApplied;
+    }
+    if (!wantRun) {
+      scheduleNext(kIdleTickUs);
+      portEXIT_CRITICAL_ISR(&m_mux);
+      return;
+    }
+    // The A4988 needs DIR stable before the next rising STEP edge, and
+    // direction only ever changes from rest.
+    if (reverse) {
+      digitalWrite(Pins::STEPPER_DIR, (m_withdraw == kWithdrawDirHigh) ? HIGH : LOW);
+      m_dirApplied = m_withdraw;
+      scheduleNext(kDirSetupUs);
+      portEXIT_CRITICAL_ISR(&m_mux);
+      return;
+    }
+    m_active = true;
+    m_rampIndex = 0;
+  }
+
+  Metrics::recordStepLatency(latencyUs);
+  uint32_t span = emitSteps(wantRun && !reverse);
+#if STEPPER_PULSE_RMT
+  StepPulse::start();
+  scheduleNext(span);
+#else
+  (void)span;
+  StepPulse::write(true);
+  m_pulseHigh = true;
+  scheduleNext(kStepPulseWidthUs);
+#endif
+  portEXIT_CRITICAL_ISR(&m_mux);
+}
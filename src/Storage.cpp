@@ -1,35 +1,270 @@
 /**
  * @file Storage.cpp
  * @brief LittleFS persistence for base syringe metadata.
+ *
+ * Base records are kept in a BaseStore log and cached in RAM, sorted by tag
+ * key, up to a fixed memory cap; past it, the least recently used record
+ * makes room for the new one. Reads are served from the cache. The store's
+ * index knows every RFID on flash, so a miss for an unknown tag never touches
+ * the filesystem.
+ *
+ * Saves, deletes and moves of legacy records wait in a small pending table,
+ * which reads, counts and listings consult before the cache and the index, and
+ * are committed as one batch by tick(). The log format makes every commit
+ * crash-safe on its own: records carry a CRC, a torn tail is dropped on the
+ * next open, and compaction goes through a temporary file and a rename.
  */
 #include "Storage.hpp"
 
 #include <ArduinoJson.h>
 #include <LittleFS.h>
 #include <cstring>
+#include <utility>
+
+#include "BaseStore.hpp"
+#include "Log.hpp"
+#include "Metrics.hpp"
+
+#ifndef STORAGE_CACHE_BYTES
+#define STORAGE_CACHE_BYTES (32 * 1024)
+#endif
 
 namespace {
-String basePath(uint32_t rfid) {
-  char buf[16];
-  snprintf(buf, sizeof(buf), "%08X", rfid);
-  String path = "/bases/";
-  path += buf;
-  path += ".json";
-  return path;
+
+struct CacheEntry {
+  TagId rfid;
+  Storage::BaseInfo info;
+  // g_useClock when the entry was last loaded or written.
+  uint32_t lastUse;
+};
+
+constexpr size_t kCacheCapacity = STORAGE_CACHE_BYTES / sizeof(CacheEntry);
+static_assert(kCacheCapacity > 0, "STORAGE_CACHE_BYTES too small for one entry");
+
+CacheEntry g_cache[kCacheCapacity];
+size_t g_cacheCount = 0;
+uint32_t g_useClock = 0;
+uint32_t g_hits = 0;
+uint32_t g_misses = 0;
+uint32_t g_evictions = 0;
+
+constexpr const char* kStorePath = "/bases.db";
+constexpr const char* kLegacyDir = "/bases";
+
+BaseStore g_store;
+SemaphoreHandle_t g_mutex = nullptr;
+
+// Edits not yet on flash, at most one per tag. Each replaces the tag's record,
+// which may not exist yet, or deletes it (g_pendingErase).
+constexpr size_t kMaxPending = 8;
+BaseStore::Update g_pending[kMaxPending];
+bool g_pendingErase[kMaxPending];
+size_t g_pendingCount = 0;
+uint32_t g_pendingSinceMs = 0;
+uint32_t g_lastEditMs = 0;
+
+Storage::WriteStats g_writes;
+
+class Lock {
+ public:
+  Lock() {
+    if (g_mutex) xSemaphoreTake(g_mutex, portMAX_DELAY);
+  }
+  ~Lock() {
+    if (g_mutex) xSemaphoreGive(g_mutex);
+  }
+};
+
+// Index of the first entry with rfid >= key.
+size_t lowerBound(TagId rfid) {
+  size_t lo = 0;
+  size_t hi = g_cacheCount;
+  while (lo < hi) {
+    size_t mid = (lo + hi) / 2;
+    if (g_cache[mid].rfid < rfid) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
 }
-}  // namespace
 
-namespace Storage {
+// Does not count as a use; listings walk the cache without reordering it.
+CacheEntry* cacheFind(TagId rfid) {
+  size_t i = lowerBound(rfid);
+  return (i < g_cacheCount && g_cache[i].rfid == rfid) ? &g_cache[i] : nullptr;
+}
 
-bool init() {
-  if (!LittleFS.begin(true)) return false;
-  LittleFS.mkdir("/bases");
+void cacheRemoveAt(size_t i) {
+  memmove(&g_cache[i], &g_cache[i + 1], (g_cacheCount - i - 1) * sizeof(CacheEntry));
+  --g_cacheCount;
+}
+
+// A linear scan, but only on a miss that already costs a flash read.
+void cacheEvict() {
+  size_t victim = 0;
+  for (size_t i = 1; i < g_cacheCount; ++i) {
+    if (static_cast<int32_t>(g_cache[i].lastUse - g_cache[victim].lastUse) < 0) victim = i;
+  }
+  cacheRemoveAt(victim);
+  ++g_evictions;
+}
+
+void cachePut(TagId rfid, const Storage::BaseInfo& info) {
+  size_t i = lowerBound(rfid);
+  if (i >= g_cacheCount || g_cache[i].rfid != rfid) {
+    if (g_cacheCount == kCacheCapacity) {
+      cacheEvict();
+      i = lowerBound(rfid);
+    }
+    memmove(&g_cache[i + 1], &g_cache[i], (g_cacheCount - i) * sizeof(CacheEntry));
+    g_cache[i].rfid = rfid;
+    ++g_cacheCount;
+  }
+  g_cache[i].info = info;
+  g_cache[i].lastUse = ++g_useClock;
+}
+
+void cacheErase(TagId rfid) {
+  size_t i = lowerBound(rfid);
+  if (i < g_cacheCount && g_cache[i].rfid == rfid) cacheRemoveAt(i);
+}
+
+// Index of the pending edit for `rfid`, or kMaxPending.
+size_t pendingIndex(TagId rfid) {
+  for (size_t i = 0; i < g_pendingCount; ++i) {
+    if (g_pending[i].rfid == rfid) return i;
+  }
+  return kMaxPending;
+}
+
+// The pending record for `rfid`, or nullptr if none or it is being deleted.
+const Storage::BaseInfo* pendingFind(TagId rfid) {
+  size_t i = pendingIndex(rfid);
+  return i != kMaxPending && !g_pendingErase[i] ? &g_pending[i].info : nullptr;
+}
+
+// Queues a new record for `rfid`, or its deletion for nullptr, replacing any
+// edit already pending for it. Fails when every slot holds another tag.
+bool pendingSet(TagId rfid, const Storage::BaseInfo* info, uint32_t now) {
+  size_t i = pendingIndex(rfid);
+  if (i != kMaxPending) {
+    ++g_writes.coalesced;
+  } else {
+    if (g_pendingCount == kMaxPending) return false;
+    if (g_pendingCount == 0) g_pendingSinceMs = now;
+    i = g_pendingCount++;
+    g_pending[i].rfid = rfid;
+  }
+  if (info) g_pending[i].info = *info;
+  g_pendingErase[i] = info == nullptr;
+  g_lastEditMs = now;
   return true;
 }
 
-bool loadBase(uint32_t rfid, BaseInfo& out) {
-  if (rfid == 0) return false;
-  File f = LittleFS.open(basePath(rfid), "r");
+void pendingDrop(TagId rfid) {
+  size_t i = pendingIndex(rfid);
+  if (i == kMaxPending) return;
+  --g_pendingCount;
+  g_pending[i] = g_pending[g_pendingCount];
+  g_pendingErase[i] = g_pendingErase[g_pendingCount];
+}
+
+// Whether `rfid` has a record once pending edits are applied.
+bool live(TagId rfid) {
+  size_t i = pendingIndex(rfid);
+  return i != kMaxPending ? !g_pendingErase[i] : g_store.contains(rfid);
+}
+
+size_t liveCount() {
+  size_t count = g_store.size();
+  for (size_t i = 0; i < g_pendingCount; ++i) {
+    bool stored = g_store.contains(g_pending[i].rfid);
+    if (g_pendingErase[i] && stored) --count;
+    if (!g_pendingErase[i] && !stored) ++count;
+  }
+  return count;
+}
+
+// Sorted live RFIDs greater than `after`: the store's, less pending deletes,
+// plus new tags that are still pending.
+size_t listLive(TagId* out, size_t max, TagId after) {
+  size_t n = 0;
+  TagId cursor = after;
+  while (n < max) {
+    size_t got = g_store.list(out + n, max - n, cursor);
+    if (got == 0) break;
+    cursor = out[n + got - 1];
+    for (size_t i = n, end = n + got; i < end; ++i) {
+      size_t p = pendingIndex(out[i]);
+      if (p == kMaxPending || !g_pendingErase[p]) out[n++] = out[i];
+    }
+  }
+  for (size_t p = 0; p < g_pendingCount; ++p) {
+    TagId rfid = g_pending[p].rfid;
+    if (g_pendingErase[p] || rfid <= after || g_store.contains(rfid)) continue;
+    size_t i = n;
+    while (i > 0 && out[i - 1] > rfid) --i;
+    // Past the end of a full page; the next page picks it up.
+    if (i == max) continue;
+    size_t shifted = (n < max ? n : max - 1) - i;
+    memmove(&out[i + 1], &out[i], shifted * sizeof(TagId));
+    out[i] = rfid;
+    if (n < max) ++n;
+  }
+  return n;
+}
+
+// Writes every pending edit in one batch: replacements first, so a moved
+// legacy record reaches its new key before the old one is deleted. Edits
+// that did not make it stay pending, and the next attempt waits for another
+// quiet window.
+bool commitPending() {
+  if (g_pendingCount == 0) return true;
+  size_t puts = 0;
+  for (size_t i = 0; i < g_pendingCount; ++i) {
+    if (g_pendingErase[i]) continue;
+    std::swap(g_pending[i], g_pending[puts]);
+    std::swap(g_pendingErase[i], g_pendingErase[puts]);
+    ++puts;
+  }
+  size_t done = 0;
+  bool ok;
+  {
+    Metrics::PhaseTimer timer(Metrics::Phase::Flash);
+    ok = g_store.putAll(g_pending, puts);
+    if (ok) done = puts;
+    while (ok && done < g_pendingCount) {
+      TagId rfid = g_pending[done].rfid;
+      ok = !g_store.contains(rfid) || g_store.erase(rfid);
+      if (ok) ++done;
+    }
+  }
+  if (done) {
+    ++g_writes.commits;
+    g_writes.recordsWritten += done;
+  }
+  for (size_t i = done; i < g_pendingCount; ++i) {
+    g_pending[i - done] = g_pending[i];
+    g_pendingErase[i - done] = g_pendingErase[i];
+  }
+  g_pendingCount -= done;
+  if (!ok) g_lastEditMs = millis();
+  return ok;
+}
+
+bool sameInfo(const Storage::BaseInfo& a, const Storage::BaseInfo& b) {
+  return strcmp(a.paintName, b.paintName) == 0 && strcmp(a.recipeName, b.recipeName) == 0 &&
+         strcmp(a.recipeId, b.recipeId) == 0 && strcmp(a.notes, b.notes) == 0 &&
+         a.motion.withdrawUlPerSec == b.motion.withdrawUlPerSec &&
+         a.motion.dispenseUlPerSec == b.motion.dispenseUlPerSec &&
+         a.motion.accelUlPerSec2 == b.motion.accelUlPerSec2 && a.motion.dwellMs == b.motion.dwellMs;
+}
+
+// Reads one per-tag JSON file written by firmware before the record store.
+bool readLegacyFile(const String& path, Storage::BaseInfo& out) {
+  File f = LittleFS.open(path, "r");
   if (!f) return false;
 
   JsonDocument doc;
@@ -44,50 +279,243 @@ bool loadBase(uint32_t rfid, BaseInfo& out) {
   return true;
 }
 
-bool saveBase(uint32_t rfid, const BaseInfo& info) {
-  if (rfid == 0) return false;
-  File f = LittleFS.open(basePath(rfid), "w");
-  if (!f) return false;
+// Moves /bases/*.json into the record store and removes the originals. A file
+// is only deleted once its record has been appended, so an interrupted
+// migration resumes on the next boot.
+void migrateLegacyFiles() {
+  File root = LittleFS.open(kLegacyDir);
+  if (!root || !root.isDirectory()) return;
 
-  JsonDocument doc;
-  doc["paint_name"] = info.paintName;
-  doc["recipe_name"] = info.recipeName;
-  doc["recipe_id"] = info.recipeId;
-  doc["notes"] = info.notes;
+  size_t imported = 0;
+  File file = root.openNextFile();
+  while (file) {
+    String name = file.name();
+    bool isDir = file.isDirectory();
+    file.close();
+    int slash = name.lastIndexOf('/');
+    if (slash >= 0) name = name.substring(slash + 1);
+    if (!isDir && name.endsWith(".json")) {
+      String path = String(kLegacyDir) + "/" + name;
+      TagId rfid = strtoul(name.substring(0, name.length() - 5).c_str(), nullptr, 16);
+      Storage::BaseInfo info;
+      if (rfid != 0 && readLegacyFile(path, info) && g_store.put(rfid, info, true)) {
+        cachePut(rfid, info);
+        LittleFS.remove(path);
+        ++imported;
+      }
+    }
+    file = root.openNextFile();
+  }
+  root.close();
+  LittleFS.rmdir(kLegacyDir);
+  if (imported) Log::printf("[Storage] Imported %u legacy base files.", static_cast<unsigned>(imported));
+}
 
-  bool ok = serializeJson(doc, f) != 0;
-  f.close();
-  return ok;
+// A 7-byte tag may still own a record that older firmware stored under its
+// last four UID bytes. Reading it is enough to answer; moving it to the full
+// key is queued like any edit, since tags are read while the plunger moves.
+// With no room to queue the move, it is retried on a later load.
+bool claimLegacy(TagId rfid, Storage::BaseInfo& out) {
+  if (Tags::isLegacyWidth(rfid) || g_store.contains(rfid)) return false;
+  TagId legacy = Tags::legacyKey(rfid);
+  size_t p = pendingIndex(legacy);
+  if (p != kMaxPending && g_pendingErase[p]) return false;
+  if (!g_store.readLegacy(legacy, out)) return false;
+  if (p != kMaxPending) out = g_pending[p].info;
+  size_t needed = p == kMaxPending ? 2 : 1;
+  if (kMaxPending - g_pendingCount < needed) return true;
+  uint32_t now = millis();
+  pendingSet(rfid, &out, now);
+  pendingSet(legacy, nullptr, now);
+  cacheErase(legacy);
+  cachePut(rfid, out);
+  Log::printf("[Storage] Moving legacy record %s to %s.", Tags::Hex(legacy).str, Tags::Hex(rfid).str);
+  return true;
 }
 
-bool deleteBase(uint32_t rfid) {
+// Replays the record log into the cache while the store scans it at boot.
+void replayIntoCache(TagId rfid, const Storage::BaseInfo* info, void*) {
+  if (info) {
+    cachePut(rfid, *info);
+  } else {
+    cacheErase(rfid);
+  }
+}
+
+}  // namespace
+
+namespace Storage {
+
+bool init() {
+  if (!g_mutex) g_mutex = xSemaphoreCreateMutex();
+  if (!LittleFS.begin(true)) return false;
+
+  Lock lock;
+  commitPending();
+  g_pendingCount = 0;
+  g_cacheCount = 0;
+  if (!g_store.open(kStorePath, replayIntoCache)) return false;
+  if (LittleFS.exists(kLegacyDir)) migrateLegacyFiles();
+  g_hits = 0;
+  g_misses = 0;
+  g_evictions = 0;
+  Log::printf("[Storage] %u bases, %u cached (capacity %u).", static_cast<unsigned>(g_store.size()),
+              static_cast<unsigned>(g_cacheCount), static_cast<unsigned>(kCacheCapacity));
+  return true;
+}
+
+bool loadBase(TagId rfid, BaseInfo& out) {
   if (rfid == 0) return false;
-  return LittleFS.remove(basePath(rfid));
+  Lock lock;
+  size_t p = pendingIndex(rfid);
+  if (p != kMaxPending) {
+    if (g_pendingErase[p]) return false;
+    ++g_hits;
+    out = g_pending[p].info;
+    return true;
+  }
+  if (CacheEntry* entry = cacheFind(rfid)) {
+    ++g_hits;
+    entry->lastUse = ++g_useClock;
+    out = entry->info;
+    return true;
+  }
+  ++g_misses;
+  if (!g_store.read(rfid, out)) return claimLegacy(rfid, out);
+  cachePut(rfid, out);
+  return true;
 }
 
-bool listBaseIds(uint32_t* out, size_t max, size_t& count) {
-  count = 0;
-  File root = LittleFS.open("/bases");
-  if (!root || !root.isDirectory()) return false;
+bool saveBase(TagId rfid, const BaseInfo& info) {
+  if (rfid == 0) return false;
+  Lock lock;
+  ++g_writes.saves;
+  if (live(rfid)) {
+    const CacheEntry* entry = cacheFind(rfid);
+    if (entry && sameInfo(entry->info, info)) {
+      ++g_writes.unchanged;
+      return true;
+    }
+  } else if (liveCount() >= BaseStore::kMaxRecords) {
+    return false;
+  }
+  if (!pendingSet(rfid, &info, millis())) return false;
+  cachePut(rfid, info);
+  return true;
+}
 
-  File file = root.openNextFile();
-  while (file) {
-    if (!file.isDirectory()) {
-      String name = file.name();
-      int slash = name.lastIndexOf('/');
-      if (slash >= 0) name = name.substring(slash + 1);
-      if (name.endsWith(".json")) {
-        String hex = name.substring(0, name.length() - 5);
-        uint32_t val = strtoul(hex.c_str(), nullptr, 16);
-        if (val != 0 && count < max) {
-          out[count++] = val;
+bool deleteBase(TagId rfid) {
+  if (rfid == 0) return false;
+  Lock lock;
+  if (!live(rfid)) return false;
+  if (g_store.contains(rfid)) {
+    if (!pendingSet(rfid, nullptr, millis())) return false;
+  } else {
+    pendingDrop(rfid);
+  }
+  cacheErase(rfid);
+  return true;
+}
+
+bool listBaseIds(TagId* out, size_t max, size_t& count, TagId after) {
+  Lock lock;
+  count = listLive(out, max, after);
+  return true;
+}
+
+size_t baseCount() {
+  Lock lock;
+  return liveCount();
+}
+
+size_t visitBases(TagId after, size_t max, BaseVisitor visit, void* ctx) {
+  constexpr size_t kBatch = 32;
+  TagId ids[kBatch];
+  size_t visited = 0;
+  Lock lock;
+  File file;
+  bool stopped = false;
+  while (!stopped && visited < max) {
+    size_t want = max - visited < kBatch ? max - visited : kBatch;
+    size_t n = listLive(ids, want, after);
+    if (n == 0) break;
+    for (size_t i = 0; i < n; ++i) {
+      BaseInfo info;
+      const BaseInfo* record = pendingFind(ids[i]);
+      if (!record) {
+        const CacheEntry* entry = cacheFind(ids[i]);
+        if (entry) {
+          record = &entry->info;
+        } else if (g_store.read(ids[i], info, file)) {
+          record = &info;
         }
       }
+      if (!record) continue;
+      if (!visit(ids[i], *record, ctx)) {
+        stopped = true;
+        break;
+      }
+      ++visited;
     }
-    file.close();
-    file = root.openNextFile();
+    after = ids[n - 1];
   }
-  return true;
+  if (file) file.close();
+  return visited;
+}
+
+CacheStats cacheStats() {
+  Lock lock;
+  CacheStats stats;
+  stats.hits = g_hits;
+  stats.misses = g_misses;
+  stats.evictions = g_evictions;
+  stats.entries = g_cacheCount;
+  stats.capacity = kCacheCapacity;
+  stats.bytes = sizeof(g_cache);
+  stats.complete = g_cacheCount == liveCount();
+  return stats;
+}
+
+StoreStats storeStats() {
+  Lock lock;
+  BaseStore::Stats s = g_store.stats();
+  StoreStats stats;
+  stats.live = s.live;
+  stats.dead = s.dead;
+  stats.fileBytes = s.fileBytes;
+  stats.compactions = s.compactions;
+  stats.corrupt = s.corrupt;
+  stats.indexSlots = s.indexSlots;
+  stats.maxProbe = s.maxProbe;
+  return stats;
+}
+
+WriteStats writeStats() {
+  Lock lock;
+  WriteStats stats = g_writes;
+  stats.pending = g_pendingCount;
+  uint32_t logical = (g_writes.saves - g_writes.unchanged) * sizeof(BaseInfo);
+  stats.writeAmplification = logical ? static_cast<float>(g_store.stats().bytesWritten) / logical : 0.0f;
+  return stats;
+}
+
+void tick(bool motionIdle) {
+  if (!motionIdle) return;
+  Lock lock;
+  uint32_t now = millis();
+  if (g_pendingCount != 0 &&
+      (now - g_lastEditMs >= STORAGE_COALESCE_MS || now - g_pendingSinceMs >= STORAGE_MAX_DELAY_MS)) {
+    commitPending();
+  }
+  if (g_store.needsCompaction()) {
+    Metrics::PhaseTimer timer(Metrics::Phase::Flash);
+    g_store.compact();
+  }
+}
+
+bool flush() {
+  Lock lock;
+  return commitPending();
 }
 
 }  // namespace Storage
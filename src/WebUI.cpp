@@ -1,312 +1,760 @@
 /**
  * @file WebUI.cpp
  * @brief Embedded HTTP server for base syringe metadata.
+ *
+ * Runs on ESPAsyncWebServer: requests are handled on the AsyncTCP task as
+ * data arrives, so slow clients never block the firmware tasks and several
+ * browsers can be connected at once.
  */
 #include "WebUI.hpp"
 
 #include <ArduinoJson.h>
-#include <WebServer.h>
-
+#include <ESPAsyncWebServer.h>
+
+#include <memory>
+
+#include "CurrentBase.hpp"
+#include "IndexHtml.h"  // generated from web/index.html by tools/embed_ui.py
+#include "Job.hpp"
+#include "JsonWriter.hpp"
+#include "Log.hpp"
+#include "Metrics.hpp"
+#include "Motion.hpp"
+#include "Recipes.hpp"
 #include "Storage.hpp"
 
 namespace {
 
-WebServer server(80);
-uint32_t g_currentRfid = 0;
-
-constexpr size_t kMaxBaseList = 64;
-
-const char kIndexHtml[] PROGMEM = R"HTML(
-<!DOCTYPE html>
-<html lang="en">
-<head>
-  <meta charset="UTF-8" />
-  <meta name="viewport" content="width=device-width, initial-scale=1" />
-  <title>Syringe Base Metadata</title>
-  <style>
-    body { font-family: Arial, sans-serif; margin: 24px; background: #f7f7f7; }
-    h1 { margin: 0 0 12px; }
-    .panel { background: white; padding: 16px; border-radius: 8px; box-shadow: 0 1px 3px rgba(0,0,0,0.12); }
-    .row { display: flex; gap: 16px; flex-wrap: wrap; }
-    .col { flex: 1 1 280px; }
-    ul { list-style: none; padding: 0; margin: 0; }
-    li { padding: 6px 8px; border-bottom: 1px solid #eee; cursor: pointer; }
-    li:hover { background: #f0f0f0; }
-    label { display: block; margin-top: 8px; font-weight: 600; }
-    input[type="text"], textarea { width: 100%; padding: 6px; box-sizing: border-box; }
-    textarea { min-height: 90px; resize: vertical; }
-    button { margin: 6px 6px 0 0; padding: 6px 10px; }
-    .muted { color: #666; font-size: 0.9em; }
-    .badge { padding: 2px 8px; background: #eef; border-radius: 12px; font-size: 0.9em; }
-  </style>
-</head>
-<body>
-  <h1>Single Syringe Base Metadata</h1>
-  <div class="row">
-    <div class="col panel">
-      <h3>Known Bases</h3>
-      <button id="refresh">Refresh</button>
-      <ul id="baseList"></ul>
-    </div>
-    <div class="col panel">
-      <h3>Editor</h3>
-      <div class="muted">Current tag: <span id="currentTag" class="badge">--</span></div>
-      <button id="useCurrent">Use Current Tag</button>
-      <label>RFID (hex)</label>
-      <input id="rfid" type="text" placeholder="e.g. 1A2B3C4D" />
-      <label>Paint Color</label>
-      <input id="paintName" type="text" placeholder="e.g. Crimson Red" />
-      <label>Recipe Name</label>
-      <input id="recipeName" type="text" placeholder="e.g. Warm Sunset Mix" />
-      <label>Recipe ID</label>
-      <input id="recipeId" type="text" placeholder="e.g. 2024-05-A" />
-      <label>Notes</label>
-      <textarea id="notes" placeholder="Any extra metadata..."></textarea>
-      <div id="status" class="muted"></div>
-      <button id="save">Save</button>
-      <button id="del">Delete</button>
-    </div>
-  </div>
-  <script>
-    const baseListEl = document.getElementById('baseList');
-    const rfidEl = document.getElementById('rfid');
-    const paintEl = document.getElementById('paintName');
-    const recipeNameEl = document.getElementById('recipeName');
-    const recipeIdEl = document.getElementById('recipeId');
-    const notesEl = document.getElementById('notes');
-    const statusEl = document.getElementById('status');
-    const currentTagEl = document.getElementById('currentTag');
-
-    function setStatus(msg, ok = true) {
-      statusEl.textContent = msg;
-      statusEl.style.color = ok ? '#2b6' : '#c33';
-    }
+AsyncWebServer server(80);
+// Server-sent events: "tag", "current", "stepper", "base" and "job".
+AsyncEventSource events("/api/events");
+
+// Written by the web task, read by request handlers on the AsyncTCP task.
+// The tag key is 64 bits, so it is read and written under g_tagMux.
+TagId g_currentRfid = 0;
+portMUX_TYPE g_tagMux = portMUX_INITIALIZER_UNLOCKED;
+volatile bool g_stepperMoving = false;
+volatile bool g_stepperWithdrawing = false;
+uint32_t g_jobGeneration = 0;
+
+// Page sizes for GET /api/bases?full=1.
+constexpr size_t kDefaultPageSize = 32;
+constexpr size_t kMaxPageSize = 64;
+// IDs emitted per piece when listing IDs only.
+constexpr size_t kIdsPerPiece = 32;
+
+// Request bodies larger than this are refused with 413 before buffering.
+constexpr size_t kMaxBodyBytes = 1024;
+// Listing responses in flight at once; each holds one piece buffer.
+constexpr size_t kMaxOpenStreams = 4;
+// Largest single piece: one base record with every character escaped as
+// \uXXXX (184 * 6), the motion profile, keys and punctuation.
+constexpr size_t kPieceBytes = 1408;
+
+// Bounds on a base's motion profile, to catch typos before they reach the
+// plunger.
+constexpr float kMaxBaseUlPerSec = Recipes::kMaxRateUlPerSec;
+constexpr float kMaxBaseUlPerSec2 = 1000000.0f;
+constexpr uint32_t kMaxBaseDwellMs = 60000;
+
+// Open event streams; further subscribers are refused.
+constexpr size_t kMaxEventClients = 4;
+
+// Browsers revalidate on every load; an unchanged page costs a bodiless 304
+// instead of the full transfer, and a reflashed UI is picked up immediately.
+constexpr const char* kIndexCacheControl = "no-cache";
+
+// Only touched from the AsyncTCP task.
+size_t g_openStreams = 0;
+
+TagId currentRfid() {
+  portENTER_CRITICAL(&g_tagMux);
+  TagId rfid = g_currentRfid;
+  portEXIT_CRITICAL(&g_tagMux);
+  return rfid;
+}
 
-    function clearForm() {
-      paintEl.value = '';
-      recipeNameEl.value = '';
-      recipeIdEl.value = '';
-      notesEl.value = '';
-    }
+String toHex(TagId rfid) { return String(Tags::Hex(rfid).str); }
 
-    async function refreshList() {
-      const resp = await fetch('/api/bases');
-      const data = await resp.json();
-      baseListEl.innerHTML = '';
-      (data.bases || []).forEach(tag => {
-        const li = document.createElement('li');
-        li.textContent = tag;
-        li.onclick = () => loadBase(tag);
-        baseListEl.appendChild(li);
-      });
-      setStatus('Loaded base list.');
-    }
+// Event payloads are small fixed-shape objects formatted in place.
+void formatTag(char* buf, size_t len, TagId rfid) {
+  if (rfid != 0) {
+    snprintf(buf, len, "{\"rfid\":\"%s\"}", Tags::Hex(rfid).str);
+  } else {
+    snprintf(buf, len, "{\"rfid\":\"\"}");
+  }
+}
+
+void formatStepper(char* buf, size_t len, bool moving, bool withdrawing) {
+  snprintf(buf, len, "{\"moving\":%s,\"direction\":\"%s\"}", moving ? "true" : "false",
+           withdrawing ? "withdraw" : "dispense");
+}
+
+void publishBase(TagId rfid, const char* action) {
+  char buf[64];
+  snprintf(buf, sizeof(buf), "{\"rfid\":\"%s\",\"action\":\"%s\"}", Tags::Hex(rfid).str, action);
+  events.send(buf, "base", millis());
+}
+
+// Print sink that appends to a String, for event payloads.
+class StringPrint : public Print {
+ public:
+  explicit StringPrint(String& s) : m_s(s) {}
+  size_t write(uint8_t c) override {
+    m_s += static_cast<char>(c);
+    return 1;
+  }
+  using Print::write;
+
+ private:
+  String& m_s;
+};
+
+// Formats one object whose members `fill` writes.
+template <typename Fill>
+String formatObject(Fill fill) {
+  String body;
+  StringPrint out(body);
+  JsonWriter json(out);
+  json.beginObject();
+  fill(json);
+  json.endObject();
+  return body;
+}
 
-    async function loadBase(tag) {
-      rfidEl.value = tag;
-      const resp = await fetch(`/api/bases/${tag}`);
-      if (!resp.ok) {
-        clearForm();
-        setStatus('Base not found.', false);
-        return;
+// The docked base's record, from the hot slot. Sent to one client, or to all
+// when `client` is null.
+void publishCurrent(AsyncEventSourceClient* client = nullptr) {
+  String body = formatObject([](JsonWriter& out) { CurrentBase::toJson(CurrentBase::get(), out); });
+  if (client) {
+    client->send(body.c_str(), "current", millis());
+  } else {
+    events.send(body.c_str(), "current", millis());
+  }
+}
+
+void publishJob(AsyncEventSourceClient* client = nullptr) {
+  String body = formatObject([](JsonWriter& out) { Job::toJson(Job::progress(), out); });
+  if (client) {
+    client->send(body.c_str(), "job", millis());
+  } else {
+    events.send(body.c_str(), "job", millis());
+  }
+}
+
+// New subscribers get the current state straight away instead of waiting
+// for the next change.
+void onEventsConnect(AsyncEventSourceClient* client) {
+  char buf[64];
+  formatTag(buf, sizeof(buf), currentRfid());
+  client->send(buf, "tag", millis(), 1000);
+  publishCurrent(client);
+  formatStepper(buf, sizeof(buf), g_stepperMoving, g_stepperWithdrawing);
+  client->send(buf, "stepper", millis());
+  publishJob(client);
+}
+
+void sendJson(AsyncWebServerRequest* request, const JsonDocument& doc) {
+  AsyncResponseStream* response = request->beginResponseStream("application/json");
+  serializeJson(doc, *response);
+  request->send(response);
+}
+
+// Streams one object whose members `fill` writes.
+template <typename Fill>
+void sendObject(AsyncWebServerRequest* request, Fill fill) {
+  AsyncResponseStream* response = request->beginResponseStream("application/json");
+  JsonWriter json(*response);
+  json.beginObject();
+  fill(json);
+  json.endObject();
+  request->send(response);
+}
+
+void addBaseRecord(JsonObject obj, TagId rfid, const Storage::BaseInfo& info) {
+  obj["rfid"] = toHex(rfid);
+  obj["paint_name"] = info.paintName;
+  obj["recipe_name"] = info.recipeName;
+  obj["recipe_id"] = info.recipeId;
+  obj["notes"] = info.notes;
+  obj["withdraw_ul_s"] = info.motion.withdrawUlPerSec;
+  obj["dispense_ul_s"] = info.motion.dispenseUlPerSec;
+  obj["accel_ul_s2"] = info.motion.accelUlPerSec2;
+  obj["dwell_ms"] = info.motion.dwellMs;
+}
+
+void writeBaseRecord(Print& out, TagId rfid, const Storage::BaseInfo& info) {
+  JsonDocument doc;
+  addBaseRecord(doc.to<JsonObject>(), rfid, info);
+  serializeJson(doc, out);
+}
+
+// Fixed-size Print sink for one piece of a streamed body.
+class PieceBuffer : public Print {
+ public:
+  size_t write(uint8_t c) override { return write(&c, 1); }
+  size_t write(const uint8_t* data, size_t size) override {
+    size_t n = kPieceBytes - m_len < size ? kPieceBytes - m_len : size;
+    memcpy(m_buf + m_len, data, n);
+    m_len += n;
+    return n;
+  }
+  using Print::write;
+
+  const char* data() const { return m_buf; }
+  size_t length() const { return m_len; }
+  void clear() { m_len = 0; }
+
+ private:
+  char m_buf[kPieceBytes];
+  size_t m_len = 0;
+};
+
+// Produces a chunked response body one bounded piece at a time, without
+// holding the storage lock between pieces. The AsyncTCP task pulls pieces as
+// the socket drains, so a long listing never needs more than one piece of
+// memory per connection.
+class BodySource {
+ public:
+  BodySource() { ++g_openStreams; }
+  virtual ~BodySource() { --g_openStreams; }
+
+  size_t fill(uint8_t* buf, size_t maxLen) {
+    size_t written = 0;
+    while (written < maxLen) {
+      if (m_pos == m_piece.length()) {
+        if (m_done) break;
+        m_piece.clear();
+        m_pos = 0;
+        m_done = !next(m_piece);
+        continue;
       }
-      const data = await resp.json();
-      paintEl.value = data.paint_name || '';
-      recipeNameEl.value = data.recipe_name || '';
-      recipeIdEl.value = data.recipe_id || '';
-      notesEl.value = data.notes || '';
-      setStatus('Loaded base metadata.');
+      size_t n = m_piece.length() - m_pos;
+      if (n > maxLen - written) n = maxLen - written;
+      memcpy(buf + written, m_piece.data() + m_pos, n);
+      m_pos += n;
+      written += n;
     }
+    return written;
+  }
 
-    async function saveBase() {
-      const rfid = rfidEl.value.trim();
-      if (!rfid) return setStatus('RFID is required.', false);
-      const body = {
-        paint_name: paintEl.value.trim(),
-        recipe_name: recipeNameEl.value.trim(),
-        recipe_id: recipeIdEl.value.trim(),
-        notes: notesEl.value.trim()
-      };
-      const resp = await fetch(`/api/bases/${rfid}`, {
-        method: 'PUT',
-        headers: { 'Content-Type': 'application/json' },
-        body: JSON.stringify(body)
-      });
-      if (resp.ok) {
-        setStatus('Saved base metadata.');
-        refreshList();
-      } else {
-        const msg = await resp.text();
-        setStatus(`Save failed: ${msg}`, false);
-      }
+ protected:
+  // Appends the next piece of the body; returns false after the last one.
+  virtual bool next(Print& out) = 0;
+
+ private:
+  PieceBuffer m_piece;
+  size_t m_pos = 0;
+  bool m_done = false;
+};
+
+void sendStream(AsyncWebServerRequest* request, BodySource* source) {
+  std::shared_ptr<BodySource> body(source);
+  request->send(request->beginChunkedResponse(
+      "application/json", [body](uint8_t* buf, size_t maxLen, size_t) { return body->fill(buf, maxLen); }));
+}
+
+// {"bases":["<hex>",...]}
+class IdListSource : public BodySource {
+ protected:
+  bool next(Print& out) override {
+    if (!m_started) {
+      out.print("{\"bases\":[");
+      m_started = true;
+      return true;
+    }
+    TagId ids[kIdsPerPiece];
+    size_t count = 0;
+    Storage::listBaseIds(ids, kIdsPerPiece, count, m_after);
+    for (size_t i = 0; i < count; ++i) {
+      if (m_any) out.print(',');
+      m_any = true;
+      out.printf("\"%s\"", Tags::Hex(ids[i]).str);
     }
+    if (count == kIdsPerPiece) {
+      m_after = ids[count - 1];
+      return true;
+    }
+    out.print("]}");
+    return false;
+  }
 
-    async function deleteBase() {
-      const rfid = rfidEl.value.trim();
-      if (!rfid) return setStatus('RFID is required.', false);
-      if (!confirm('Delete this base?')) return;
-      const resp = await fetch(`/api/bases/${rfid}`, { method: 'DELETE' });
-      if (resp.ok) {
-        setStatus('Deleted base.');
-        clearForm();
-        refreshList();
-      } else {
-        const msg = await resp.text();
-        setStatus(`Delete failed: ${msg}`, false);
-      }
+ private:
+  bool m_started = false;
+  bool m_any = false;
+  TagId m_after = 0;
+};
+
+// {"bases":[{record},...],"next_cursor":"<hex>"|"","total":n}. Each piece
+// holds as many records as fit, read by one Storage::visitBases() call.
+class PageSource : public BodySource {
+ public:
+  PageSource(TagId after, size_t limit) : m_after(after), m_limit(limit) {}
+
+ protected:
+  bool next(Print& out) override {
+    if (!m_started) {
+      out.print("{\"bases\":[");
+      m_started = true;
+      return true;
     }
 
-    async function refreshCurrentTag() {
-      const resp = await fetch('/api/rfid');
-      if (!resp.ok) return;
-      const data = await resp.json();
-      currentTagEl.textContent = data.rfid || '--';
+    if (m_sent < m_limit && !m_exhausted) {
+      Visit visit = {&out, m_sent > 0, m_after, kPieceBytes, false};
+      size_t want = m_limit - m_sent;
+      size_t n = Storage::visitBases(m_after, want, writeRecord, &visit);
+      m_sent += n;
+      if (n > 0) m_after = visit.last;
+      if (n < want && !visit.full) m_exhausted = true;
+      // The closing part goes in a piece of its own.
+      if (n > 0) return true;
     }
 
-    document.getElementById('refresh').onclick = refreshList;
-    document.getElementById('save').onclick = saveBase;
-    document.getElementById('del').onclick = deleteBase;
-    document.getElementById('useCurrent').onclick = () => {
-      const tag = currentTagEl.textContent;
-      if (tag && tag !== '--') {
-        rfidEl.value = tag;
-        loadBase(tag);
-      }
-    };
+    bool more = false;
+    if (!m_exhausted) {
+      TagId probe = 0;
+      size_t count = 0;
+      Storage::listBaseIds(&probe, 1, count, m_after);
+      more = count > 0;
+    }
 
-    refreshList();
-    refreshCurrentTag();
-    setInterval(refreshCurrentTag, 2000);
-  </script>
-</body>
-</html>
-)HTML";
+    if (more) {
+      out.printf("],\"next_cursor\":\"%s\"", Tags::Hex(m_after).str);
+    } else {
+      out.print("],\"next_cursor\":\"\"");
+    }
+    out.printf(",\"total\":%u}", static_cast<unsigned>(Storage::baseCount()));
+    return false;
+  }
 
-String toHex(uint32_t rfid) {
-  char buf[16];
-  snprintf(buf, sizeof(buf), "%08X", rfid);
-  return String(buf);
-}
+ private:
+  struct Visit {
+    Print* out;
+    bool comma;
+    TagId last;
+    // Bytes left in the piece; a piece always takes at least one record.
+    size_t room;
+    bool full;
+  };
+
+  static bool writeRecord(TagId rfid, const Storage::BaseInfo& info, void* ctx) {
+    Visit* visit = static_cast<Visit*>(ctx);
+    JsonDocument doc;
+    addBaseRecord(doc.to<JsonObject>(), rfid, info);
+    size_t len = measureJson(doc) + (visit->comma ? 1 : 0);
+    if (len > visit->room && visit->room != kPieceBytes) {
+      visit->full = true;
+      return false;
+    }
+    if (visit->comma) visit->out->print(',');
+    serializeJson(doc, *visit->out);
+    visit->room = len < visit->room ? visit->room - len : 0;
+    visit->comma = true;
+    visit->last = rfid;
+    return true;
+  }
 
-bool parseHex(const String& hexStr, uint32_t& out) {
-  if (hexStr.length() == 0) return false;
-  out = strtoul(hexStr.c_str(), nullptr, 16);
-  return out != 0;
+  bool m_started = false;
+  bool m_exhausted = false;
+  TagId m_after;
+  size_t m_limit;
+  size_t m_sent = 0;
+};
+
+bool streamSlotFree(AsyncWebServerRequest* request) {
+  if (g_openStreams < kMaxOpenStreams) return true;
+  request->send(503, "text/plain", "Busy");
+  return false;
 }
 
-void sendJson(const JsonDocument& doc) {
-  String body;
-  serializeJson(doc, body);
-  server.send(200, "application/json", body);
+void handleListBases(AsyncWebServerRequest* request) {
+  if (!streamSlotFree(request)) return;
+  sendStream(request, new IdListSource());
 }
 
-void handleListBases() {
-  uint32_t ids[kMaxBaseList];
-  size_t count = 0;
-  if (!Storage::listBaseIds(ids, kMaxBaseList, count)) {
-    server.send(500, "text/plain", "Failed to list bases");
-    return;
+// GET /api/bases?full=1[&cursor=<hex>][&limit=<n>]: full records in RFID
+// order. `next_cursor` is the cursor for the following page, or "" at the end.
+void handleListBasesFull(AsyncWebServerRequest* request) {
+  TagId after = 0;
+  if (const AsyncWebParameter* cursor = request->getParam("cursor")) {
+    if (cursor->value().length() > 0 && !Tags::parse(cursor->value().c_str(), after)) {
+      request->send(400, "text/plain", "Invalid cursor");
+      return;
+    }
   }
-
-  JsonDocument doc;
-  JsonArray arr = doc["bases"].to<JsonArray>();
-  for (size_t i = 0; i < count; ++i) {
-    arr.add(toHex(ids[i]));
+  size_t limit = kDefaultPageSize;
+  if (const AsyncWebParameter* param = request->getParam("limit")) {
+    long requested = param->value().toInt();
+    if (requested <= 0) {
+      request->send(400, "text/plain", "Invalid limit");
+      return;
+    }
+    limit = static_cast<size_t>(requested) < kMaxPageSize ? static_cast<size_t>(requested) : kMaxPageSize;
   }
-  sendJson(doc);
+
+  if (!streamSlotFree(request)) return;
+  sendStream(request, new PageSource(after, limit));
 }
 
-void handleGetBase(uint32_t rfid) {
+void handleGetBase(AsyncWebServerRequest* request, TagId rfid) {
   Storage::BaseInfo info;
   if (!Storage::loadBase(rfid, info)) {
-    server.send(404, "text/plain", "Base not found");
+    request->send(404, "text/plain", "Base not found");
     return;
   }
 
-  JsonDocument doc;
-  doc["rfid"] = toHex(rfid);
-  doc["paint_name"] = info.paintName;
-  doc["recipe_name"] = info.recipeName;
-  doc["recipe_id"] = info.recipeId;
-  doc["notes"] = info.notes;
-  sendJson(doc);
+  AsyncResponseStream* response = request->beginResponseStream("application/json");
+  writeBaseRecord(*response, rfid, info);
+  request->send(response);
 }
 
-void handlePutBase(uint32_t rfid) {
-  if (!server.hasArg("plain")) {
-    server.send(400, "text/plain", "Missing body");
-    return;
-  }
+// Collects a request body into a buffer owned by the request. Bodies over
+// kMaxBodyBytes are dropped here and refused by the request handler.
+void onBody(AsyncWebServerRequest* request, uint8_t* data, size_t len, size_t index, size_t total) {
+  if (total > kMaxBodyBytes) return;
+  if (index == 0) request->_tempObject = calloc(total + 1, 1);
+  char* buf = static_cast<char*>(request->_tempObject);
+  if (!buf || index + len > total) return;
+  memcpy(buf + index, data, len);
+}
 
-  JsonDocument doc;
-  DeserializationError err = deserializeJson(doc, server.arg("plain"));
+// Parses the body collected by onBody, or answers the request with the
+// matching error and returns false.
+bool parseBody(AsyncWebServerRequest* request, JsonDocument& doc) {
+  if (request->contentLength() > kMaxBodyBytes) {
+    request->send(413, "text/plain", "Body too large");
+    return false;
+  }
+  const char* body = static_cast<const char*>(request->_tempObject);
+  if (!body) {
+    request->send(400, "text/plain", "Missing body");
+    return false;
+  }
+  DeserializationError err = deserializeJson(doc, body);
   if (err) {
-    server.send(400, "text/plain", "Invalid JSON");
-    return;
+    request->send(400, "text/plain", "Invalid JSON");
+    return false;
   }
+  return true;
+}
+
+// Missing fields are 0, i.e. use the global profile.
+bool parseMotionProfile(const JsonDocument& doc, Storage::MotionProfile& out) {
+  out.withdrawUlPerSec = doc["withdraw_ul_s"] | 0.0f;
+  out.dispenseUlPerSec = doc["dispense_ul_s"] | 0.0f;
+  out.accelUlPerSec2 = doc["accel_ul_s2"] | 0.0f;
+  long dwell = doc["dwell_ms"] | 0L;
+  if (dwell < 0 || dwell > static_cast<long>(kMaxBaseDwellMs)) return false;
+  out.dwellMs = static_cast<uint32_t>(dwell);
+  return out.withdrawUlPerSec >= 0.0f && out.withdrawUlPerSec <= kMaxBaseUlPerSec && out.dispenseUlPerSec >= 0.0f &&
+         out.dispenseUlPerSec <= kMaxBaseUlPerSec && out.accelUlPerSec2 >= 0.0f &&
+         out.accelUlPerSec2 <= kMaxBaseUlPerSec2;
+}
+
+void handlePutBase(AsyncWebServerRequest* request, TagId rfid) {
+  JsonDocument doc;
+  if (!parseBody(request, doc)) return;
 
   Storage::BaseInfo info;
   strlcpy(info.paintName, doc["paint_name"] | "", sizeof(info.paintName));
   strlcpy(info.recipeName, doc["recipe_name"] | "", sizeof(info.recipeName));
   strlcpy(info.recipeId, doc["recipe_id"] | "", sizeof(info.recipeId));
   strlcpy(info.notes, doc["notes"] | "", sizeof(info.notes));
+  if (!parseMotionProfile(doc, info.motion)) {
+    request->send(400, "text/plain", "Invalid motion profile");
+    return;
+  }
   if (!Storage::saveBase(rfid, info)) {
-    server.send(500, "text/plain", "Save failed");
+    request->send(503, "text/plain", "Storage busy or full");
     return;
   }
-  server.send(200, "text/plain", "OK");
+  request->send(200, "text/plain", "OK");
+  publishBase(rfid, "saved");
+  if (rfid == currentRfid()) {
+    CurrentBase::onSaved(rfid, info);
+    publishCurrent();
+  }
 }
 
-void handleDeleteBase(uint32_t rfid) {
+void handleDeleteBase(AsyncWebServerRequest* request, TagId rfid) {
   if (!Storage::deleteBase(rfid)) {
-    server.send(404, "text/plain", "Delete failed");
+    request->send(404, "text/plain", "Delete failed");
     return;
   }
-  server.send(200, "text/plain", "OK");
+  request->send(200, "text/plain", "OK");
+  publishBase(rfid, "deleted");
+  if (rfid == currentRfid()) {
+    CurrentBase::onDeleted(rfid);
+    publishCurrent();
+  }
 }
 
-void handleApiBases() {
-  if (server.method() == HTTP_GET) {
-    handleListBases();
+void handleApiBaseItem(AsyncWebServerRequest* request) {
+  const String prefix = "/api/bases/";
+  String hexStr = request->url().substring(prefix.length());
+  TagId rfid = 0;
+  if (!Tags::parse(hexStr.c_str(), rfid)) {
+    request->send(400, "text/plain", "Invalid RFID");
     return;
   }
-  server.send(405, "text/plain", "Method not allowed");
+
+  if (request->method() == HTTP_GET) {
+    handleGetBase(request, rfid);
+  } else if (request->method() == HTTP_PUT) {
+    handlePutBase(request, rfid);
+  } else if (request->method() == HTTP_DELETE) {
+    handleDeleteBase(request, rfid);
+  } else {
+    request->send(405, "text/plain", "Method not allowed");
+  }
 }
 
-void handleApiBaseItem() {
-  String uri = server.uri();
-  const String prefix = "/api/bases/";
-  if (!uri.startsWith(prefix)) {
-    server.send(404, "text/plain", "Not found");
+// The /api/bases route also receives /api/bases/<id>.
+void handleApiBases(AsyncWebServerRequest* request) {
+  Metrics::PhaseTimer timer(Metrics::Phase::Web);
+  if (request->url() != "/api/bases") {
+    handleApiBaseItem(request);
     return;
   }
+  if (request->method() == HTTP_GET) {
+    const AsyncWebParameter* full = request->getParam("full");
+    if (full && full->value() != "0") {
+      handleListBasesFull(request);
+    } else {
+      handleListBases(request);
+    }
+    return;
+  }
+  request->send(405, "text/plain", "Method not allowed");
+}
+
+void handleRfid(AsyncWebServerRequest* request) {
+  Metrics::PhaseTimer timer(Metrics::Phase::Web);
+  JsonDocument doc;
+  TagId rfid = currentRfid();
+  if (rfid != 0) {
+    doc["rfid"] = toHex(rfid);
+  } else {
+    doc["rfid"] = "";
+  }
+  sendJson(request, doc);
+}
+
+// Served from the hot slot; never reads storage.
+void handleCurrent(AsyncWebServerRequest* request) {
+  Metrics::PhaseTimer timer(Metrics::Phase::Web);
+  sendObject(request, [](JsonWriter& out) { CurrentBase::toJson(CurrentBase::get(), out); });
+}
+
+void handleMetrics(AsyncWebServerRequest* request) {
+  Metrics::PhaseTimer timer(Metrics::Phase::Web);
+  sendObject(request, [](JsonWriter& out) {
+    Metrics::toJson(out);
+
+    Storage::CacheStats stats = Storage::cacheStats();
+    out.key("base_cache").beginObject();
+    out.member("hits", stats.hits);
+    out.member("misses", stats.misses);
+    out.member("evictions", stats.evictions);
+    out.member("entries", stats.entries);
+    out.member("capacity", stats.capacity);
+    out.member("bytes", stats.bytes);
+    out.member("complete", stats.complete);
+    out.endObject();
+
+    Storage::StoreStats store = Storage::storeStats();
+    out.key("base_store").beginObject();
+    out.member("live", store.live);
+    out.member("dead", store.dead);
+    out.member("file_bytes", store.fileBytes);
+    out.member("compactions", store.compactions);
+    out.member("corrupt", store.corrupt);
+    out.member("index_slots", store.indexSlots);
+    out.member("max_probe", store.maxProbe);
+    out.endObject();
+
+    Storage::WriteStats writes = Storage::writeStats();
+    out.key("base_writes").beginObject();
+    out.member("saves", writes.saves);
+    out.member("coalesced", writes.coalesced);
+    out.member("unchanged", writes.unchanged);
+    out.member("commits", writes.commits);
+    out.member("records", writes.recordsWritten);
+    out.member("pending", writes.pending);
+    out.member("write_amplification", writes.writeAmplification);
+    out.endObject();
+  });
+}
+
+void sendMotionStatus(AsyncWebServerRequest* request) {
+  sendObject(request, [](JsonWriter& out) { Motion::toJson(out); });
+}
 
-  String hexStr = uri.substring(prefix.length());
-  uint32_t rfid = 0;
-  if (!parseHex(hexStr, rfid)) {
-    server.send(400, "text/plain", "Invalid RFID");
+// POST {"cmd":"withdraw"|"dispense","ul":<n>}, {"cmd":"move","steps":<n>},
+// {"cmd":"stop"}, {"cmd":"zero"} or {"cmd":"calibrate","steps_per_ul":<n>}.
+// Moves are queued; the reply is the motion status after queueing.
+void handleMotionCommand(AsyncWebServerRequest* request) {
+  JsonDocument doc;
+  if (!parseBody(request, doc)) return;
+
+  const char* cmd = doc["cmd"] | "";
+  Motion::Result result = Motion::Result::Ok;
+  if (strcmp(cmd, "withdraw") == 0) {
+    result = Motion::withdraw(doc["ul"] | 0.0f);
+  } else if (strcmp(cmd, "dispense") == 0) {
+    result = Motion::dispense(doc["ul"] | 0.0f);
+  } else if (strcmp(cmd, "move") == 0) {
+    result = Motion::move(doc["steps"] | static_cast<int32_t>(0));
+  } else if (strcmp(cmd, "stop") == 0) {
+    Motion::stop();
+  } else if (strcmp(cmd, "zero") == 0) {
+    result = Motion::zero();
+  } else if (strcmp(cmd, "calibrate") == 0) {
+    result = Motion::setStepsPerMicroliter(doc["steps_per_ul"] | 0.0f);
+  } else {
+    request->send(400, "text/plain", "Unknown cmd");
     return;
   }
 
-  if (server.method() == HTTP_GET) {
-    handleGetBase(rfid);
-  } else if (server.method() == HTTP_PUT) {
-    handlePutBase(rfid);
-  } else if (server.method() == HTTP_DELETE) {
-    handleDeleteBase(rfid);
+  switch (result) {
+    case Motion::Result::Ok:
+      sendMotionStatus(request);
+      return;
+    case Motion::Result::BadArgument:
+      request->send(400, "text/plain", Motion::describe(result));
+      return;
+    default:
+      request->send(409, "text/plain", Motion::describe(result));
+      return;
+  }
+}
+
+void handleMotion(AsyncWebServerRequest* request) {
+  Metrics::PhaseTimer timer(Metrics::Phase::Web);
+  if (request->method() == HTTP_GET) {
+    sendMotionStatus(request);
+  } else if (request->method() == HTTP_POST) {
+    handleMotionCommand(request);
   } else {
-    server.send(405, "text/plain", "Method not allowed");
+    request->send(405, "text/plain", "Method not allowed");
   }
 }
 
-void handleRfid() {
+void handleJobCommand(AsyncWebServerRequest* request) {
   JsonDocument doc;
-  if (g_currentRfid != 0) {
-    doc["rfid"] = toHex(g_currentRfid);
+  if (!parseBody(request, doc)) return;
+
+  const char* cmd = doc["cmd"] | "";
+  Job::Result result;
+  if (strcmp(cmd, "start") == 0) {
+    result = Job::start(doc["recipe_id"] | "", currentRfid());
+  } else if (strcmp(cmd, "pause") == 0) {
+    result = Job::pause();
+  } else if (strcmp(cmd, "resume") == 0) {
+    result = Job::resume();
+  } else if (strcmp(cmd, "abort") == 0) {
+    result = Job::abort();
   } else {
-    doc["rfid"] = "";
+    request->send(400, "text/plain", "Unknown cmd");
+    return;
+  }
+  if (result == Job::Result::Ok) {
+    request->send(202, "text/plain", "Accepted");
+  } else {
+    request->send(result == Job::Result::UnknownRecipe ? 404 : 409, "text/plain", Job::describe(result));
+  }
+}
+
+// GET reports progress; POST {"cmd":"start","recipe_id":...} starts a recipe
+// for the docked base, {"cmd":"pause"|"resume"|"abort"} controls it. Commands
+// are applied by the motion task within a millisecond; watch the "job" event
+// or poll GET for the outcome.
+void handleJob(AsyncWebServerRequest* request) {
+  Metrics::PhaseTimer timer(Metrics::Phase::Web);
+  if (request->method() == HTTP_GET) {
+    sendObject(request, [](JsonWriter& out) { Job::toJson(Job::progress(), out); });
+  } else if (request->method() == HTTP_POST) {
+    handleJobCommand(request);
+  } else {
+    request->send(405, "text/plain", "Method not allowed");
+  }
+}
+
+void handleRecipeItem(AsyncWebServerRequest* request) {
+  const String prefix = "/api/recipes/";
+  String id = request->url().substring(prefix.length());
+  if (id.length() == 0 || id.length() >= sizeof(Recipes::Recipe::id)) {
+    request->send(400, "text/plain", "Invalid recipe id");
+    return;
+  }
+
+  if (request->method() == HTTP_GET) {
+    Recipes::Recipe recipe;
+    if (!Recipes::find(id.c_str(), recipe)) {
+      request->send(404, "text/plain", "Recipe not found");
+      return;
+    }
+    sendObject(request, [&recipe](JsonWriter& out) { Recipes::toJson(recipe, out); });
+  } else if (request->method() == HTTP_PUT) {
+    JsonDocument doc;
+    if (!parseBody(request, doc)) return;
+    Recipes::Recipe recipe;
+    strlcpy(recipe.id, id.c_str(), sizeof(recipe.id));
+    if (const char* error = Recipes::fromJson(doc.as<JsonObjectConst>(), recipe)) {
+      request->send(400, "text/plain", error);
+      return;
+    }
+    if (!Recipes::put(recipe)) {
+      request->send(409, "text/plain", "Invalid recipe or store full");
+      return;
+    }
+    request->send(200, "text/plain", "OK");
+  } else if (request->method() == HTTP_DELETE) {
+    if (!Recipes::erase(id.c_str())) {
+      request->send(404, "text/plain", "Delete failed");
+      return;
+    }
+    request->send(200, "text/plain", "OK");
+  } else {
+    request->send(405, "text/plain", "Method not allowed");
   }
-  sendJson(doc);
+}
+
+// GET /api/recipes lists ids; /api/recipes/<id> is GET, PUT or DELETE with the
+// shape documented in Recipes.hpp.
+void handleRecipes(AsyncWebServerRequest* request) {
+  Metrics::PhaseTimer timer(Metrics::Phase::Web);
+  if (request->url() != "/api/recipes") {
+    handleRecipeItem(request);
+    return;
+  }
+  if (request->method() != HTTP_GET) {
+    request->send(405, "text/plain", "Method not allowed");
+    return;
+  }
+  char ids[Recipes::kMaxRecipes][24];
+  size_t count = Recipes::listIds(ids, Recipes::kMaxRecipes);
+  JsonDocument doc;
+  JsonArray list = doc["recipes"].to<JsonArray>();
+  for (size_t i = 0; i < count; ++i) list.add(ids[i]);
+  sendJson(request, doc);
+}
+
+// Serves the build-time gzipped UI. Every browser we target accepts gzip,
+// so there is no uncompressed fallback.
+void handleIndex(AsyncWebServerRequest* request) {
+  Metrics::PhaseTimer timer(Metrics::Phase::Web);
+  const AsyncWebHeader* ifNoneMatch = request->getHeader("If-None-Match");
+  AsyncWebServerResponse* response;
+  if (ifNoneMatch && ifNoneMatch->value() == kIndexHtmlEtag) {
+    response = request->beginResponse(304, "text/html");
+  } else {
+    response = request->beginResponse(200, "text/html", kIndexHtmlGz, kIndexHtmlGzLen);
+    response->addHeader("Content-Encoding", "gzip");
+  }
+  response->addHeader("ETag", kIndexHtmlEtag);
+  response->addHeader("Cache-Control", kIndexCacheControl);
+  request->send(response);
 }
 
 }  // namespace
@@ -314,26 +762,49 @@ void handleRfid() {
 namespace WebUI {
 
 void begin() {
-  server.on("/", HTTP_GET, []() {
-    server.send_P(200, "text/html", kIndexHtml);
-  });
-  server.on("/index.html", HTTP_GET, []() {
-    server.send_P(200, "text/html", kIndexHtml);
-  });
-  server.on("/api/bases", HTTP_ANY, handleApiBases);
+  server.on("/", HTTP_GET, handleIndex);
+  server.on("/index.html", HTTP_GET, handleIndex);
+  server.on("/api/bases", HTTP_ANY, handleApiBases, nullptr, onBody);
   server.on("/api/rfid", HTTP_GET, handleRfid);
-  server.onNotFound(handleApiBaseItem);
+  server.on("/api/current", HTTP_GET, handleCurrent);
+  server.on("/api/metrics", HTTP_GET, handleMetrics);
+  server.on("/api/motion", HTTP_ANY, handleMotion, nullptr, onBody);
+  server.on("/api/job", HTTP_ANY, handleJob, nullptr, onBody);
+  server.on("/api/recipes", HTTP_ANY, handleRecipes, nullptr, onBody);
+  events.onConnect(onEventsConnect);
+  events.setFilter([](AsyncWebServerRequest*) { return events.count() < kMaxEventClients; });
+  server.addHandler(&events);
+  server.onNotFound([](AsyncWebServerRequest* request) { request->send(404, "text/plain", "Not found"); });
 
   server.begin();
-  Serial.println("[WebUI] HTTP server started on port 80.");
+  Log::printf("[WebUI] HTTP server started on port 80.");
 }
 
-void handle() {
-  server.handleClient();
+void setCurrentRfid(TagId rfid) {
+  if (rfid == currentRfid()) return;
+  portENTER_CRITICAL(&g_tagMux);
+  g_currentRfid = rfid;
+  portEXIT_CRITICAL(&g_tagMux);
+  char buf[32];
+  formatTag(buf, sizeof(buf), rfid);
+  events.send(buf, "tag", millis());
+  publishCurrent();
 }
 
-void setCurrentRfid(uint32_t rfid) {
-  g_currentRfid = rfid;
+void setStepperState(bool moving, bool withdrawing) {
+  if (moving == g_stepperMoving && withdrawing == g_stepperWithdrawing) return;
+  g_stepperMoving = moving;
+  g_stepperWithdrawing = withdrawing;
+  char buf[48];
+  formatStepper(buf, sizeof(buf), moving, withdrawing);
+  events.send(buf, "stepper", millis());
+}
+
+void refreshJob() {
+  uint32_t generation = Job::progress().generation;
+  if (generation == g_jobGeneration) return;
+  g_jobGeneration = generation;
+  publishJob();
 }
 
 }  // namespace WebUI
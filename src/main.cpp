@@ -1,228 +1,207 @@
 /**
  * @file main.cpp
  * @brief Single-syringe firmware: stepper + buttons + PN532 + web UI.
+ *
+ * Work is split across FreeRTOS tasks by priority so a slow web client or
+ * flash read can never delay motor control. Tasks exchange data through
+ * SpscQueue instances rather than shared globals.
+ *
+ * setup() only brings up what the operator needs at the bench: the stepper,
+ * the jog buttons and the serial console. Storage, the PN532 and WiFi follow
+ * in a background boot task (see Boot.hpp), so a slow or failing WiFi
+ * connect no longer holds up the plunger after a power blip.
  */
 #include <Arduino.h>
 
 #include <WifiCredentials.hpp>
 #include <WifiManager.hpp>
 
-#include "Pins.hpp"
+#include "Boot.hpp"
+#include "Buttons.hpp"
+#include "Console.hpp"
+#include "CurrentBase.hpp"
+#include "Job.hpp"
+#include "Log.hpp"
+#include "Metrics.hpp"
+#include "Motion.hpp"
+#include "Recipes.hpp"
 #include "RfidReader.hpp"
+#include "SpscQueue.hpp"
+#include "StepperControl.hpp"
 #include "Storage.hpp"
 #include "WebUI.hpp"
 
 namespace {
-constexpr uint32_t kStepIntervalUs = 800;  // ~1250 steps/sec
-constexpr uint16_t kStepPulseWidthUs = 3;
-constexpr bool kWithdrawDirHigh = true;
-
 Shared::WifiManager g_wifi;
 RfidReader g_rfid;
-
-class StepperControl {
- public:
-  void begin() {
-    pinMode(Pins::STEPPER_STEP, OUTPUT);
-    pinMode(Pins::STEPPER_DIR, OUTPUT);
-    digitalWrite(Pins::STEPPER_STEP, LOW);
-    digitalWrite(Pins::STEPPER_DIR, LOW);
-  }
-
-  void setDirection(bool withdraw) {
-    digitalWrite(Pins::STEPPER_DIR, withdraw ? HIGH : LOW);
-  }
-
-  void setMoving(bool moving) { m_moving = moving; }
-
-  void update() {
-    if (!m_moving) return;
-    uint32_t now = micros();
-    if (now - m_lastStepUs < kStepIntervalUs) return;
-    m_lastStepUs = now;
-    digitalWrite(Pins::STEPPER_STEP, HIGH);
-    delayMicroseconds(kStepPulseWidthUs);
-    digitalWrite(Pins::STEPPER_STEP, LOW);
-  }
-
- private:
-  bool m_moving = false;
-  uint32_t m_lastStepUs = 0;
-};
-
 StepperControl g_stepper;
 
-String g_input;
-
-void printStructured(const char* cmd, bool ok, const String& message = "", const String& data = "") {
-  Serial.print("{\"cmd\":\"");
-  Serial.print(cmd);
-  Serial.print("\",\"status\":\"");
-  Serial.print(ok ? "ok" : "error");
-  Serial.print("\"");
-  if (message.length()) {
-    Serial.print(",\"message\":\"");
-    Serial.print(message);
-    Serial.print("\"");
-  }
-  if (data.length()) {
-    Serial.print(",\"data\":");
-    Serial.print(data);
-  }
-  Serial.println("}");
-}
-
-void handleWifiStatus() {
-  printStructured("wifi.status", true, "", g_wifi.buildStatusJson());
-}
-
-void handleWifiSet(const String& args) {
-  int sp = args.indexOf(' ');
-  String ssid = (sp < 0) ? args : args.substring(0, sp);
-  String password = (sp < 0) ? "" : args.substring(sp + 1);
-  ssid.trim();
-  password.trim();
-  if (ssid.length() == 0) {
-    printStructured("wifi.set", false, "usage: wifi.set <ssid> [password]");
-    return;
-  }
-
-  if (!Shared::WiFiCredentials::save(ssid, password)) {
-    printStructured("wifi.set", false, "failed to save credentials");
-    return;
-  }
-
-  bool connected = g_wifi.connect(ssid, password);
-  printStructured("wifi.set", connected, connected ? "connected" : "connect failed", g_wifi.buildStatusJson());
-}
+// Task priorities: motion and buttons preempt everything else, then RFID,
+// then the HTTP server and serial console, then the boot task that brings
+// up the slow subsystems. Arduino's loop task runs at 1.
+// The AsyncTCP task that serves HTTP is pinned to 3 in platformio.ini, below
+// motion and RFID.
+constexpr UBaseType_t kMotionPriority = 5;
+constexpr UBaseType_t kRfidPriority = 4;
+constexpr UBaseType_t kWebPriority = 2;
+constexpr UBaseType_t kConsolePriority = 2;
+constexpr UBaseType_t kBootPriority = 1;
+
+constexpr TickType_t kMotionPeriod = pdMS_TO_TICKS(1);
+constexpr TickType_t kRfidPeriod = pdMS_TO_TICKS(5);
+constexpr TickType_t kWebPeriod = pdMS_TO_TICKS(10);
+constexpr TickType_t kConsolePeriod = pdMS_TO_TICKS(5);
+
+// RFID task -> web task: latest tag seen by the reader.
+SpscQueue<TagId, 8> g_tagEvents;
 
-void handleWifiConnect() {
+void startWiFi() {
   String ssid;
   String password;
-  if (!Shared::WiFiCredentials::load(ssid, password)) {
-    printStructured("wifi.connect", false, "no saved credentials");
-    return;
+  if (Shared::WiFiCredentials::load(ssid, password)) {
+    if (g_wifi.connect(ssid, password)) {
+      return;
+    }
+    Log::printf("[WiFi] Falling back to AP mode.");
+  } else {
+    Log::printf("[WiFi] No saved WiFi credentials found.");
   }
-  bool connected = g_wifi.connect(ssid, password);
-  printStructured("wifi.connect", connected, connected ? "connected" : "connect failed", g_wifi.buildStatusJson());
+  g_wifi.startAccessPoint();
+  Log::printf("[WiFi] Open http://192.168.4.1/ to configure.");
 }
 
-void handleWifiClear() {
-  if (!Shared::WiFiCredentials::clear()) {
-    printStructured("wifi.clear", false, "failed to clear credentials");
-    return;
+// Motion, buttons and the recipe job: highest priority, fixed 1 ms cadence.
+void motionTask(void*) {
+  TickType_t lastWake = xTaskGetTickCount();
+  for (;;) {
+    Metrics::markPeriod(Metrics::Task::Motion);
+    {
+      Metrics::PhaseTimer timer(Metrics::Phase::Buttons);
+      Buttons::poll();
+    }
+    Job::tick();
+    vTaskDelayUntil(&lastWake, kMotionPeriod);
   }
-  printStructured("wifi.clear", true, "credentials cleared");
 }
 
-void handleWifiAp() {
-  g_wifi.startAccessPoint();
-  printStructured("wifi.ap", true, "ap started");
+void rfidTask(void*) {
+  TagId published = 0;
+  for (;;) {
+    Metrics::markPeriod(Metrics::Task::Rfid);
+    {
+      Metrics::PhaseTimer timer(Metrics::Phase::Rfid);
+      g_rfid.poll();
+    }
+    TagId tag = g_rfid.currentTag();
+    if (tag != published && g_tagEvents.push(tag)) {
+      published = tag;
+    }
+    vTaskDelay(kRfidPeriod);
+  }
 }
 
-void handleWifiScan() {
-  printStructured("wifi.scan", true, "", g_wifi.buildScanJson());
+// HTTP requests are served on the AsyncTCP task; this task prefetches the
+// record of each newly docked tag, applies its motion profile (again after
+// the docked base is edited), starts its recipe, and hands tag, stepper and job changes over to the web layer, which
+// pushes them to subscribers. It also commits base, recipe and calibration
+// changes to flash once the plunger is at rest.
+void webTask(void*) {
+  for (;;) {
+    Metrics::markPeriod(Metrics::Task::Web);
+    TagId tag = 0;
+    while (g_tagEvents.pop(tag)) {
+      CurrentBase::load(tag);
+      WebUI::setCurrentRfid(tag);
+      CurrentBase::Slot slot = CurrentBase::get();
+      Motion::useBaseProfile(slot.known ? &slot.info.motion : nullptr);
+      Job::onDocked(tag, slot.known ? slot.info.recipeId : "");
+    }
+    // The docked base was edited or deleted over HTTP.
+    if (CurrentBase::takeChanged()) {
+      CurrentBase::Slot slot = CurrentBase::get();
+      Motion::useBaseProfile(slot.known ? &slot.info.motion : nullptr);
+    }
+    WebUI::setStepperState(g_stepper.isMoving(), g_stepper.isWithdrawing());
+    WebUI::refreshJob();
+    bool idle = !g_stepper.isMoving() && g_stepper.queuedMoves() == 0;
+    Storage::tick(idle);
+    Recipes::tick(idle);
+    Motion::tick(idle);
+    vTaskDelay(kWebPeriod);
+  }
 }
 
-void handleCommand(const String& line) {
-  int sp = line.indexOf(' ');
-  String cmd = (sp < 0) ? line : line.substring(0, sp);
-  String args = (sp < 0) ? "" : line.substring(sp + 1);
-  cmd.trim();
-  args.trim();
-
-  if (cmd == "wifi.status") {
-    handleWifiStatus();
-  } else if (cmd == "wifi.set") {
-    handleWifiSet(args);
-  } else if (cmd == "wifi.connect") {
-    handleWifiConnect();
-  } else if (cmd == "wifi.clear") {
-    handleWifiClear();
-  } else if (cmd == "wifi.ap") {
-    handleWifiAp();
-  } else if (cmd == "wifi.scan") {
-    handleWifiScan();
-  } else if (cmd.length()) {
-    printStructured(cmd.c_str(), false, "unknown command");
+void consoleTask(void*) {
+  for (;;) {
+    Metrics::markPeriod(Metrics::Task::Console);
+    {
+      Metrics::PhaseTimer timer(Metrics::Phase::Console);
+      Console::poll();
+    }
+    vTaskDelay(kConsolePeriod);
   }
 }
 
-void readSerialCommands() {
-  while (Serial.available()) {
-    char c = static_cast<char>(Serial.read());
-    if (c == '\r') continue;
-    if (c == '\n') {
-      String line = g_input;
-      g_input = "";
-      line.trim();
-      if (line.length()) handleCommand(line);
-      continue;
-    }
-    g_input += c;
+void startTask(TaskFunction_t fn, const char* name, uint32_t stackBytes, UBaseType_t priority) {
+  if (xTaskCreate(fn, name, stackBytes, nullptr, priority, nullptr) != pdPASS) {
+    Log::printf("[Single] Failed to start task %s.", name);
   }
 }
 
-void startWiFi() {
-  String ssid;
-  String password;
-  if (Shared::WiFiCredentials::load(ssid, password)) {
-    if (g_wifi.connect(ssid, password)) {
-      return;
-    }
-    Serial.println("[WiFi] Falling back to AP mode.");
+// Brings up the slow subsystems in dependency order while motion and the
+// console are already running. The web task starts with storage, so docking
+// a base prefetches its record and starts its recipe before WiFi is up.
+void bootTask(void*) {
+  Boot::enter(Boot::Stage::Storage);
+  bool ok = Storage::init();
+  if (ok) {
+    Motion::loadCalibration();
+    Recipes::init();
   } else {
-    Serial.println("[WiFi] No saved WiFi credentials found.");
+    Log::printf("[Storage] Failed to init LittleFS.");
   }
-  g_wifi.startAccessPoint();
-  Serial.println("[WiFi] Open http://192.168.4.1/ to configure.");
+  Boot::finish(Boot::Stage::Storage, ok);
+  startTask(webTask, "web", 4096, kWebPriority);
+
+  Boot::enter(Boot::Stage::Rfid);
+  ok = g_rfid.begin();
+  Boot::finish(Boot::Stage::Rfid, ok);
+  startTask(rfidTask, "rfid", 4096, kRfidPriority);
+
+  Boot::enter(Boot::Stage::Wifi);
+  startWiFi();
+  Boot::finish(Boot::Stage::Wifi, true);
+
+  Boot::enter(Boot::Stage::Web);
+  WebUI::begin();
+  Boot::finish(Boot::Stage::Web, true);
+
+  vTaskDelete(nullptr);
 }
 
 }  // namespace
 
 void setup() {
+  Boot::begin();
   Serial.begin(115200);
-  delay(200);
-  Serial.println("\n[Single] Booting...");
+  Log::printf("\n[Single] Booting...");
 
-  pinMode(Pins::BUTTON_WITHDRAW, INPUT_PULLUP);
-  pinMode(Pins::BUTTON_DISPENSE, INPUT_PULLUP);
-  g_stepper.begin();
+  Metrics::begin();
 
-  if (!Storage::init()) {
-    Serial.println("[Storage] Failed to init LittleFS.");
-  }
+  g_stepper.begin();
+  Buttons::begin(g_stepper);
+  Motion::begin(g_stepper);
+  Job::begin(g_stepper);
+  Console::begin(g_wifi, g_rfid, g_stepper);
 
-  g_rfid.begin();
+  startTask(motionTask, "motion", 3072, kMotionPriority);
+  startTask(consoleTask, "console", 8192, kConsolePriority);
+  Boot::finish(Boot::Stage::Core, true);
 
-  startWiFi();
-  WebUI::begin();
+  startTask(bootTask, "boot", 8192, kBootPriority);
 }
 
 void loop() {
-  readSerialCommands();
-
-  static uint32_t lastRfidPoll = 0;
-  uint32_t nowMs = millis();
-  if (nowMs - lastRfidPoll >= 200) {
-    lastRfidPoll = nowMs;
-    g_rfid.poll();
-    WebUI::setCurrentRfid(g_rfid.currentTag());
-  }
-
-  bool withdrawPressed = digitalRead(Pins::BUTTON_WITHDRAW) == LOW;
-  bool dispensePressed = digitalRead(Pins::BUTTON_DISPENSE) == LOW;
-
-  if (withdrawPressed && !dispensePressed) {
-    g_stepper.setDirection(kWithdrawDirHigh);
-    g_stepper.setMoving(true);
-  } else if (dispensePressed && !withdrawPressed) {
-    g_stepper.setDirection(!kWithdrawDirHigh);
-    g_stepper.setMoving(true);
-  } else {
-    g_stepper.setMoving(false);
-  }
-
-  g_stepper.update();
-  WebUI::handle();
+  // All work runs in the tasks started by setup().
+  vTaskDelete(nullptr);
 }
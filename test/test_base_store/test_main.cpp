@@ -0,0 +1,329 @@
+/**
+ * @file test_main.cpp
+ * @brief BaseStore: reopen, format upgrades, corrupt records and torn tails.
+ */
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <stdlib.h>
+#include <unity.h>
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "BaseStore.hpp"
+#include "Checksum.hpp"
+
+namespace {
+
+constexpr const char* kPath = "/bases.db";
+constexpr uint32_t kMagic = 0x53424653;
+constexpr size_t kHeaderBytes = 16;
+constexpr size_t kRecordBytes = 216;
+
+// The on-flash layouts of older formats, written here byte for byte as
+// older firmware did.
+struct Header {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t recordSize;
+  uint32_t reserved;
+  uint32_t crc;
+};
+
+struct InfoV2 {
+  char paintName[32];
+  char recipeName[32];
+  char recipeId[24];
+  char notes[96];
+};
+
+struct RecordV1 {
+  uint32_t rfid;
+  uint8_t op;
+  uint8_t reserved[3];
+  InfoV2 info;
+  uint32_t crc;
+};
+
+struct RecordV2 {
+  TagId rfid;
+  uint8_t op;
+  uint8_t flags;
+  uint8_t reserved[2];
+  InfoV2 info;
+  uint32_t crc;
+};
+
+static_assert(sizeof(RecordV1) == 196 && sizeof(RecordV2) == 200, "old record layouts");
+
+enum : uint8_t { kOpPut = 1, kOpDelete = 2 };
+enum : uint8_t { kFlagLegacyKey = 1 };
+
+std::string g_root;
+
+std::vector<uint8_t> readFile() {
+  File f = LittleFS.open(kPath, "r");
+  std::vector<uint8_t> bytes(f.size());
+  f.read(bytes.data(), bytes.size());
+  f.close();
+  return bytes;
+}
+
+void writeFile(const std::vector<uint8_t>& bytes) {
+  File f = LittleFS.open(kPath, "w");
+  f.write(bytes.data(), bytes.size());
+  f.close();
+}
+
+template <typename T>
+void append(std::vector<uint8_t>& bytes, const T& value) {
+  const uint8_t* p = reinterpret_cast<const uint8_t*>(&value);
+  bytes.insert(bytes.end(), p, p + sizeof(value));
+}
+
+std::vector<uint8_t> oldHeader(uint16_t version, uint16_t recordSize) {
+  Header h = {kMagic, version, recordSize, 0, 0};
+  h.crc = Checksum::crc32(&h, offsetof(Header, crc));
+  std::vector<uint8_t> bytes;
+  append(bytes, h);
+  return bytes;
+}
+
+template <typename Record>
+Record oldRecord(decltype(Record::rfid) rfid, uint8_t op, const char* paint) {
+  Record r = {};
+  r.rfid = rfid;
+  r.op = op;
+  strlcpy(r.info.paintName, paint, sizeof(r.info.paintName));
+  strlcpy(r.info.notes, "kept across upgrades", sizeof(r.info.notes));
+  r.crc = Checksum::crc32(&r, offsetof(Record, crc));
+  return r;
+}
+
+Storage::BaseInfo named(const char* paint) {
+  Storage::BaseInfo info;
+  strlcpy(info.paintName, paint, sizeof(info.paintName));
+  info.motion.dispenseUlPerSec = 12.5f;
+  info.motion.dwellMs = 300;
+  return info;
+}
+
+void assertPaint(BaseStore& store, TagId rfid, const char* paint) {
+  Storage::BaseInfo out;
+  TEST_ASSERT_TRUE(store.read(rfid, out));
+  TEST_ASSERT_EQUAL_STRING(paint, out.paintName);
+}
+
+}  // namespace
+
+void setUp() {
+  char dir[] = "/tmp/basestore-XXXXXX";
+  g_root = mkdtemp(dir);
+  HostFs::setRoot(g_root.c_str());
+  LittleFS.begin(true);
+}
+
+void tearDown() { std::filesystem::remove_all(g_root); }
+
+void test_reopen_rebuilds_the_index() {
+  {
+    BaseStore store;
+    TEST_ASSERT_TRUE(store.open(kPath));
+    TEST_ASSERT_TRUE(store.put(0x04A1B2C3D4E5F6ull, named("Cobalt")));
+    TEST_ASSERT_TRUE(store.put(0xC3D4E5F6u, named("Ochre")));
+    TEST_ASSERT_TRUE(store.put(0xC3D4E5F6u, named("Umber")));
+    TEST_ASSERT_TRUE(store.put(0x11u, named("Gone")));
+    TEST_ASSERT_TRUE(store.erase(0x11u));
+  }
+  BaseStore store;
+  TEST_ASSERT_TRUE(store.open(kPath));
+  TEST_ASSERT_EQUAL(2, store.size());
+  assertPaint(store, 0x04A1B2C3D4E5F6ull, "Cobalt");
+  assertPaint(store, 0xC3D4E5F6u, "Umber");
+  TEST_ASSERT_FALSE(store.contains(0x11u));
+
+  Storage::BaseInfo out;
+  store.read(0x04A1B2C3D4E5F6ull, out);
+  TEST_ASSERT_EQUAL_FLOAT(12.5f, out.motion.dispenseUlPerSec);
+  TEST_ASSERT_EQUAL_UINT32(300, out.motion.dwellMs);
+}
+
+// v1 is keyed by the last four UID bytes. Its records come through with an
+// empty motion profile and may move to the full key once.
+void test_upgrades_v1() {
+  std::vector<uint8_t> file = oldHeader(1, sizeof(RecordV1));
+  append(file, oldRecord<RecordV1>(0xC3D4E5F6u, kOpPut, "Ochre"));
+  append(file, oldRecord<RecordV1>(0x0A0B0C0Du, kOpPut, "Deleted"));
+  append(file, oldRecord<RecordV1>(0x0A0B0C0Du, kOpDelete, ""));
+  writeFile(file);
+
+  BaseStore store;
+  TEST_ASSERT_TRUE(store.open(kPath));
+  TEST_ASSERT_EQUAL(1, store.size());
+  Storage::BaseInfo out;
+  TEST_ASSERT_TRUE(store.read(0xC3D4E5F6u, out));
+  TEST_ASSERT_EQUAL_STRING("Ochre", out.paintName);
+  TEST_ASSERT_EQUAL_STRING("kept across upgrades", out.notes);
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, out.motion.dispenseUlPerSec);
+  TEST_ASSERT_FALSE(store.contains(0x0A0B0C0Du));
+
+  // The file is v3 now: same history, current record size.
+  std::vector<uint8_t> upgraded = readFile();
+  TEST_ASSERT_EQUAL(kHeaderBytes + 3 * kRecordBytes, upgraded.size());
+  Header h;
+  memcpy(&h, upgraded.data(), sizeof(h));
+  TEST_ASSERT_EQUAL(3, h.version);
+  TEST_ASSERT_EQUAL(kRecordBytes, h.recordSize);
+
+  TEST_ASSERT_TRUE(store.rekey(0xC3D4E5F6u, 0x04A1B2C3D4E5F6ull));
+  TEST_ASSERT_FALSE(store.contains(0xC3D4E5F6u));
+  assertPaint(store, 0x04A1B2C3D4E5F6ull, "Ochre");
+  // A record moved once is no longer under a legacy key.
+  TEST_ASSERT_FALSE(store.rekey(0x04A1B2C3D4E5F6ull, 0x04FFFFFFFFFFFFull));
+}
+
+// v2 records keep their flags: one that came from a v1 file can still move
+// to its full key after the v2 -> v3 step, and one that did not cannot.
+void test_upgrades_v2_keeping_legacy_flags() {
+  std::vector<uint8_t> file = oldHeader(2, sizeof(RecordV2));
+  RecordV2 legacy = oldRecord<RecordV2>(0xC3D4E5F6u, kOpPut, "From v1");
+  legacy.flags = kFlagLegacyKey;
+  legacy.crc = Checksum::crc32(&legacy, offsetof(RecordV2, crc));
+  append(file, legacy);
+  append(file, oldRecord<RecordV2>(0x0B0C0D0Eu, kOpPut, "Native v2"));
+  writeFile(file);
+
+  BaseStore store;
+  TEST_ASSERT_TRUE(store.open(kPath));
+  TEST_ASSERT_EQUAL(2, store.size());
+  assertPaint(store, 0xC3D4E5F6u, "From v1");
+  assertPaint(store, 0x0B0C0D0Eu, "Native v2");
+  TEST_ASSERT_TRUE(store.rekey(0xC3D4E5F6u, 0x04A1B2C3D4E5F6ull));
+  TEST_ASSERT_FALSE(store.rekey(0x0B0C0D0Eu, 0x04B1B2C3D4E5F6ull));
+
+  BaseStore reopened;
+  TEST_ASSERT_TRUE(reopened.open(kPath));
+  assertPaint(reopened, 0x04A1B2C3D4E5F6ull, "From v1");
+  assertPaint(reopened, 0x0B0C0D0Eu, "Native v2");
+}
+
+void test_upgrade_skips_corrupt_records() {
+  std::vector<uint8_t> file = oldHeader(1, sizeof(RecordV1));
+  append(file, oldRecord<RecordV1>(0x01u, kOpPut, "One"));
+  RecordV1 damaged = oldRecord<RecordV1>(0x02u, kOpPut, "Two");
+  damaged.info.notes[3] ^= 0x40;
+  append(file, damaged);
+  append(file, oldRecord<RecordV1>(0x03u, kOpPut, "Three"));
+  writeFile(file);
+
+  BaseStore store;
+  TEST_ASSERT_TRUE(store.open(kPath));
+  TEST_ASSERT_EQUAL(2, store.size());
+  assertPaint(store, 0x01u, "One");
+  assertPaint(store, 0x03u, "Three");
+}
+
+// A full-size record that fails its CRC is skipped; the ones after it are
+// still aligned and load.
+void test_skips_corrupt_records() {
+  {
+    BaseStore store;
+    TEST_ASSERT_TRUE(store.open(kPath));
+    for (TagId id = 1; id <= 5; ++id) TEST_ASSERT_TRUE(store.put(id, named("Base")));
+  }
+  std::vector<uint8_t> file = readFile();
+  file[kHeaderBytes + kRecordBytes + 40] ^= 0x55;
+  writeFile(file);
+
+  BaseStore store;
+  TEST_ASSERT_TRUE(store.open(kPath));
+  TEST_ASSERT_EQUAL(4, store.size());
+  TEST_ASSERT_EQUAL(1, store.stats().corrupt);
+  TEST_ASSERT_FALSE(store.contains(2));
+  for (TagId id : {1, 3, 4, 5}) assertPaint(store, id, "Base");
+  // Still appendable behind the damaged record.
+  TEST_ASSERT_TRUE(store.put(6, named("After")));
+  BaseStore reopened;
+  TEST_ASSERT_TRUE(reopened.open(kPath));
+  assertPaint(reopened, 6, "After");
+}
+
+// An interrupted append leaves a partial record. Open drops it and rewrites
+// the log so the next append is not stranded behind it.
+void test_drops_torn_tail() {
+  {
+    BaseStore store;
+    TEST_ASSERT_TRUE(store.open(kPath));
+    TEST_ASSERT_TRUE(store.put(1, named("One")));
+    TEST_ASSERT_TRUE(store.put(2, named("Two")));
+  }
+  std::vector<uint8_t> file = readFile();
+  std::vector<uint8_t> torn(file.end() - kRecordBytes, file.end() - kRecordBytes + 100);
+  file.insert(file.end(), torn.begin(), torn.end());
+  writeFile(file);
+
+  BaseStore store;
+  TEST_ASSERT_TRUE(store.open(kPath));
+  TEST_ASSERT_EQUAL(2, store.size());
+  TEST_ASSERT_EQUAL(1, store.stats().compactions);
+  TEST_ASSERT_EQUAL(kHeaderBytes + 2 * kRecordBytes, readFile().size());
+
+  TEST_ASSERT_TRUE(store.put(3, named("Three")));
+  BaseStore reopened;
+  TEST_ASSERT_TRUE(reopened.open(kPath));
+  TEST_ASSERT_EQUAL(3, reopened.size());
+  assertPaint(reopened, 3, "Three");
+}
+
+void test_compaction_keeps_latest_records() {
+  BaseStore store;
+  TEST_ASSERT_TRUE(store.open(kPath));
+  TEST_ASSERT_TRUE(store.put(1, named("v0")));
+  TEST_ASSERT_TRUE(store.put(2, named("Two")));
+  char paint[8];
+  for (int i = 1; i <= 40; ++i) {
+    snprintf(paint, sizeof(paint), "v%d", i);
+    TEST_ASSERT_TRUE(store.put(1, named(paint)));
+  }
+  TEST_ASSERT_TRUE(store.needsCompaction());
+  TEST_ASSERT_TRUE(store.compact());
+  TEST_ASSERT_FALSE(store.needsCompaction());
+  TEST_ASSERT_EQUAL(kHeaderBytes + 2 * kRecordBytes, store.stats().fileBytes);
+  assertPaint(store, 1, "v40");
+  assertPaint(store, 2, "Two");
+
+  BaseStore reopened;
+  TEST_ASSERT_TRUE(reopened.open(kPath));
+  assertPaint(reopened, 1, "v40");
+}
+
+// One batch may mix new tags and edits; it counts only the replaced records
+// as dead.
+void test_put_all_mixes_new_and_existing_tags() {
+  BaseStore store;
+  TEST_ASSERT_TRUE(store.open(kPath));
+  TEST_ASSERT_TRUE(store.put(1, named("v0")));
+  BaseStore::Update batch[2] = {{1, named("v1")}, {2, named("Two")}};
+  TEST_ASSERT_TRUE(store.putAll(batch, 2));
+  TEST_ASSERT_EQUAL(2, store.size());
+  TEST_ASSERT_EQUAL(1, store.stats().dead);
+
+  BaseStore reopened;
+  TEST_ASSERT_TRUE(reopened.open(kPath));
+  assertPaint(reopened, 1, "v1");
+  assertPaint(reopened, 2, "Two");
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_reopen_rebuilds_the_index);
+  RUN_TEST(test_upgrades_v1);
+  RUN_TEST(test_upgrades_v2_keeping_legacy_flags);
+  RUN_TEST(test_upgrade_skips_corrupt_records);
+  RUN_TEST(test_skips_corrupt_records);
+  RUN_TEST(test_drops_torn_tail);
+  RUN_TEST(test_compaction_keeps_latest_records);
+  RUN_TEST(test_put_all_mixes_new_and_existing_tags);
+  return UNITY_END();
+}
@@ -0,0 +1,112 @@
+/**
+ * @file test_main.cpp
+ * @brief Jog buttons on the virtual clock: taps, holds and both buttons.
+ */
+#include <Arduino.h>
+#include <unity.h>
+
+#include "Buttons.hpp"
+#include "Pins.hpp"
+#include "StepperControl.hpp"
+
+namespace {
+
+constexpr int32_t kTapSteps = 50 * StepperControl::kMicrosteps;
+
+StepperControl g_stepper;
+
+void press(int pin) { HostGpio::setInput(pin, LOW); }
+void release(int pin) { HostGpio::setInput(pin, HIGH); }
+
+void runMs(uint32_t ms) {
+  HostTimer::runUntil(HostClock::now() + static_cast<uint64_t>(ms) * 1000);
+  Buttons::poll();
+}
+
+void settle() {
+  for (int i = 0; i < 100 && g_stepper.isMoving(); ++i) runMs(50);
+  TEST_ASSERT_FALSE(g_stepper.isMoving());
+}
+
+}  // namespace
+
+void setUp() {
+  static bool started = false;
+  if (!started) {
+    HostClock::useVirtual(true);
+    HostClock::set(1000000);
+    TEST_ASSERT_TRUE(g_stepper.begin());
+    Buttons::begin(g_stepper);
+    started = true;
+  }
+  runMs(100);
+}
+
+void tearDown() {
+  release(Pins::BUTTON_WITHDRAW);
+  release(Pins::BUTTON_DISPENSE);
+  runMs(10);
+  settle();
+}
+
+// A quick press and release moves exactly the tap distance.
+void test_tap_moves_the_tap_distance() {
+  Buttons::Stats before = Buttons::stats();
+  int32_t start = g_stepper.position();
+  press(Pins::BUTTON_WITHDRAW);
+  runMs(20);
+  TEST_ASSERT_TRUE(g_stepper.isMoving());
+  release(Pins::BUTTON_WITHDRAW);
+  settle();
+  TEST_ASSERT_EQUAL(kTapSteps, g_stepper.position() - start);
+  TEST_ASSERT_EQUAL(1, Buttons::stats().taps - before.taps);
+
+  start = g_stepper.position();
+  press(Pins::BUTTON_DISPENSE);
+  runMs(20);
+  release(Pins::BUTTON_DISPENSE);
+  settle();
+  TEST_ASSERT_EQUAL(-kTapSteps, g_stepper.position() - start);
+}
+
+// Holding keeps the plunger moving from the press on, with no pause when
+// the press turns into a hold.
+void test_hold_moves_without_a_pause() {
+  Buttons::Stats before = Buttons::stats();
+  int32_t last = g_stepper.position();
+  press(Pins::BUTTON_WITHDRAW);
+  runMs(10);
+  for (int i = 0; i < 100; ++i) {
+    runMs(10);
+    TEST_ASSERT_TRUE(g_stepper.isMoving());
+    TEST_ASSERT_TRUE(g_stepper.position() > last);
+    last = g_stepper.position();
+  }
+  release(Pins::BUTTON_WITHDRAW);
+  settle();
+  Buttons::Stats after = Buttons::stats();
+  TEST_ASSERT_EQUAL(1, after.holds - before.holds);
+  TEST_ASSERT_EQUAL(0, after.taps - before.taps);
+}
+
+// Pressing the second button stops the jog until a button is pressed again.
+void test_both_buttons_stop() {
+  press(Pins::BUTTON_WITHDRAW);
+  runMs(100);
+  press(Pins::BUTTON_DISPENSE);
+  settle();
+  int32_t stopped = g_stepper.position();
+  runMs(500);
+  TEST_ASSERT_EQUAL(stopped, g_stepper.position());
+  release(Pins::BUTTON_DISPENSE);
+  runMs(100);
+  TEST_ASSERT_EQUAL(stopped, g_stepper.position());
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_tap_moves_the_tap_distance);
+  RUN_TEST(test_hold_moves_without_a_pause);
+  RUN_TEST(test_both_buttons_stop);
+  return UNITY_END();
+}
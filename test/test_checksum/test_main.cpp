@@ -0,0 +1,55 @@
+/**
+ * @file test_main.cpp
+ * @brief CRC-32 used by the record log, motion.cfg and serial frames.
+ */
+#include <unity.h>
+
+#include <string.h>
+
+#include "Checksum.hpp"
+
+void setUp() {}
+void tearDown() {}
+
+void test_check_value() {
+  // The standard CRC-32/ISO-HDLC check value.
+  TEST_ASSERT_EQUAL_HEX32(0xCBF43926u, Checksum::crc32("123456789", 9));
+  TEST_ASSERT_EQUAL_HEX32(0x00000000u, Checksum::crc32("", 0));
+  TEST_ASSERT_EQUAL_HEX32(0xE8B7BE43u, Checksum::crc32("a", 1));
+}
+
+void test_pieces_match_whole() {
+  uint8_t data[300];
+  for (size_t i = 0; i < sizeof(data); ++i) data[i] = static_cast<uint8_t>(i * 131 + 7);
+  uint32_t whole = Checksum::crc32(data, sizeof(data));
+
+  for (size_t split = 0; split <= sizeof(data); split += 37) {
+    uint32_t crc = Checksum::crc32(data, split);
+    crc = Checksum::crc32(data + split, sizeof(data) - split, crc);
+    TEST_ASSERT_EQUAL_HEX32(whole, crc);
+  }
+
+  // Byte at a time, as the frame writer does.
+  uint32_t crc = 0;
+  for (uint8_t b : data) crc = Checksum::crc32(&b, 1, crc);
+  TEST_ASSERT_EQUAL_HEX32(whole, crc);
+}
+
+void test_detects_single_bit_flips() {
+  uint8_t data[64];
+  memset(data, 0x5A, sizeof(data));
+  uint32_t good = Checksum::crc32(data, sizeof(data));
+  for (size_t bit = 0; bit < sizeof(data) * 8; ++bit) {
+    data[bit / 8] ^= static_cast<uint8_t>(1u << (bit % 8));
+    TEST_ASSERT_TRUE(Checksum::crc32(data, sizeof(data)) != good);
+    data[bit / 8] ^= static_cast<uint8_t>(1u << (bit % 8));
+  }
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_check_value);
+  RUN_TEST(test_pieces_match_whole);
+  RUN_TEST(test_detects_single_bit_flips);
+  return UNITY_END();
+}
@@ -0,0 +1,153 @@
+/**
+ * @file test_main.cpp
+ * @brief COBS stuffing and the serial frame layer built on it.
+ */
+#include <Arduino.h>
+#include <unity.h>
+
+#include <string>
+
+#include "Cobs.hpp"
+#include "SerialFrames.hpp"
+
+namespace {
+
+class Capture : public Print {
+ public:
+  size_t write(uint8_t c) override {
+    bytes.push_back(static_cast<char>(c));
+    return 1;
+  }
+  using Print::write;
+  std::string bytes;
+};
+
+// Encodes `data`, checks the output has no zero byte and fits the bound, and
+// decodes it again.
+void roundTrip(const uint8_t* data, size_t len) {
+  uint8_t encoded[Cobs::maxEncodedSize(600)];
+  size_t n = Cobs::encode(data, len, encoded);
+  TEST_ASSERT_TRUE(n <= Cobs::maxEncodedSize(len));
+  for (size_t i = 0; i < n; ++i) TEST_ASSERT_TRUE(encoded[i] != 0);
+
+  uint8_t decoded[600];
+  TEST_ASSERT_EQUAL(len, Cobs::decode(encoded, n, decoded, sizeof(decoded)));
+  if (len) TEST_ASSERT_EQUAL_MEMORY(data, decoded, len);
+
+  // The streaming encoder produces the same bytes plus the delimiter.
+  Capture streamed;
+  Cobs::Encoder encoder(streamed);
+  for (size_t i = 0; i < len; ++i) encoder.put(data[i]);
+  encoder.finish();
+  TEST_ASSERT_EQUAL(n + 1, streamed.bytes.size());
+  TEST_ASSERT_EQUAL_MEMORY(encoded, streamed.bytes.data(), n);
+  TEST_ASSERT_EQUAL(0, streamed.bytes.back());
+}
+
+}  // namespace
+
+void setUp() {}
+void tearDown() {}
+
+void test_known_vectors() {
+  const uint8_t in[] = {0x11, 0x22, 0x00, 0x33};
+  const uint8_t expected[] = {0x03, 0x11, 0x22, 0x02, 0x33};
+  uint8_t out[8];
+  TEST_ASSERT_EQUAL(sizeof(expected), Cobs::encode(in, sizeof(in), out));
+  TEST_ASSERT_EQUAL_MEMORY(expected, out, sizeof(expected));
+
+  const uint8_t zeros[] = {0x00, 0x00};
+  const uint8_t zerosEncoded[] = {0x01, 0x01, 0x01};
+  TEST_ASSERT_EQUAL(sizeof(zerosEncoded), Cobs::encode(zeros, sizeof(zeros), out));
+  TEST_ASSERT_EQUAL_MEMORY(zerosEncoded, out, sizeof(zerosEncoded));
+}
+
+void test_round_trips() {
+  uint8_t data[600] = {};
+  roundTrip(data, 0);
+
+  const uint8_t single[] = {0x00};
+  roundTrip(single, 1);
+
+  // Runs of exactly 254 and 255 non-zero bytes hit the 0xFF block code.
+  for (size_t i = 0; i < sizeof(data); ++i) data[i] = static_cast<uint8_t>(i % 255 + 1);
+  roundTrip(data, 253);
+  roundTrip(data, 254);
+  roundTrip(data, 255);
+  roundTrip(data, 600);
+
+  for (size_t i = 0; i < sizeof(data); ++i) data[i] = static_cast<uint8_t>(i * 37);
+  roundTrip(data, sizeof(data));
+}
+
+void test_decode_rejects_malformed_input() {
+  uint8_t out[16];
+  // The code byte promises more bytes than there are.
+  const uint8_t shortBlock[] = {0x05, 0x11, 0x22};
+  TEST_ASSERT_EQUAL(0, Cobs::decode(shortBlock, sizeof(shortBlock), out, sizeof(out)));
+  // A zero inside a frame is never produced by the encoder.
+  const uint8_t zeroCode[] = {0x02, 0x11, 0x00};
+  TEST_ASSERT_EQUAL(0, Cobs::decode(zeroCode, sizeof(zeroCode), out, sizeof(out)));
+  // Output that does not fit is refused rather than truncated.
+  const uint8_t fits[] = {0x04, 0x11, 0x22, 0x33};
+  TEST_ASSERT_EQUAL(0, Cobs::decode(fits, sizeof(fits), out, 2));
+  TEST_ASSERT_EQUAL(3, Cobs::decode(fits, sizeof(fits), out, 3));
+}
+
+void test_frames_round_trip() {
+  Capture wire;
+  {
+    SerialFrames::FrameWriter frame(wire, SerialFrames::CommandReply, 7);
+    frame.print("{\"cmd\":\"x\"}");
+    frame.u32(0);
+  }
+
+  SerialFrames::FrameReader<64> reader;
+  SerialFrames::Frame frame;
+  SerialFrames::ErrorCode error;
+  int frames = 0;
+  for (char c : wire.bytes) {
+    if (reader.push(static_cast<uint8_t>(c), frame, error) != decltype(reader)::Result::Ok) continue;
+    ++frames;
+    TEST_ASSERT_EQUAL(SerialFrames::CommandReply, frame.type);
+    TEST_ASSERT_EQUAL(7, frame.seq);
+    TEST_ASSERT_EQUAL(15, frame.len);
+    TEST_ASSERT_EQUAL_MEMORY("{\"cmd\":\"x\"}\0\0\0\0", frame.payload, 15);
+  }
+  TEST_ASSERT_EQUAL(1, frames);
+}
+
+void test_frames_reject_bad_crc_and_overflow() {
+  Capture wire;
+  {
+    SerialFrames::FrameWriter frame(wire, SerialFrames::Ping, 3);
+  }
+  // Change the sequence number after the CRC was taken over it.
+  wire.bytes[3] ^= 0x01;
+  if (wire.bytes[3] == 0) wire.bytes[3] = 0x02;
+
+  SerialFrames::FrameReader<8> reader;
+  SerialFrames::Frame frame;
+  SerialFrames::ErrorCode error = SerialFrames::BadFrame;
+  decltype(reader)::Result last = decltype(reader)::Result::None;
+  for (char c : wire.bytes) {
+    decltype(reader)::Result r = reader.push(static_cast<uint8_t>(c), frame, error);
+    if (r != decltype(reader)::Result::None) last = r;
+  }
+  TEST_ASSERT_TRUE(last == decltype(reader)::Result::Error);
+  TEST_ASSERT_EQUAL(SerialFrames::BadCrc, error);
+
+  for (int i = 0; i < 64; ++i) reader.push(0x41, frame, error);
+  TEST_ASSERT_TRUE(reader.push(0x00, frame, error) == decltype(reader)::Result::Error);
+  TEST_ASSERT_EQUAL(SerialFrames::TooLong, error);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_known_vectors);
+  RUN_TEST(test_round_trips);
+  RUN_TEST(test_decode_rejects_malformed_input);
+  RUN_TEST(test_frames_round_trip);
+  RUN_TEST(test_frames_reject_bad_crc_and_overflow);
+  return UNITY_END();
+}
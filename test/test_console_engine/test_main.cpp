@@ -0,0 +1,191 @@
+/**
+ * @file test_main.cpp
+ * @brief Console building blocks: command table, line reader, tokenizer and
+ *        reply formatting.
+ */
+#include <Arduino.h>
+#include <WifiManager.hpp>
+#include <math.h>
+#include <unity.h>
+
+#include <string>
+
+#include "Console.hpp"
+#include "ConsoleEngine.hpp"
+#include "JsonWriter.hpp"
+#include "RfidReader.hpp"
+#include "StepperControl.hpp"
+
+namespace {
+
+class Capture : public Print {
+ public:
+  size_t write(uint8_t c) override { return write(&c, 1); }
+  size_t write(const uint8_t* data, size_t size) override {
+    bytes.append(reinterpret_cast<const char*>(data), size);
+    ++writes;
+    return size;
+  }
+  using Print::write;
+  std::string bytes;
+  size_t writes = 0;
+};
+
+void noop(ConsoleEngine::Args&) {}
+
+constexpr ConsoleEngine::Command kTable[] = {
+    {"a", noop}, {"base.current", noop}, {"job", noop}, {"job.abort", noop}, {"job.start", noop, 1}, {"z", noop},
+};
+static_assert(ConsoleEngine::isSorted(kTable), "sorted table");
+
+constexpr ConsoleEngine::Command kUnsorted[] = {{"job.start", noop}, {"job.abort", noop}};
+static_assert(!ConsoleEngine::isSorted(kUnsorted), "misplaced entry is caught");
+constexpr ConsoleEngine::Command kDuplicate[] = {{"job", noop}, {"job", noop}};
+static_assert(!ConsoleEngine::isSorted(kDuplicate), "duplicate is caught");
+
+}  // namespace
+
+void setUp() {}
+void tearDown() {}
+
+void test_find_every_entry_and_nothing_else() {
+  for (const ConsoleEngine::Command& c : kTable) {
+    TEST_ASSERT_TRUE(ConsoleEngine::find(kTable, c.name) == &c);
+  }
+  TEST_ASSERT_EQUAL(1, ConsoleEngine::find(kTable, "job.start")->needs);
+  for (const char* name : {"", "b", "jo", "job.", "job.abortx", "zz", "A"}) {
+    TEST_ASSERT_NULL(ConsoleEngine::find(kTable, name));
+  }
+}
+
+void test_line_reader() {
+  ConsoleEngine::LineReader<8> reader;
+  char* line = nullptr;
+  for (char c : std::string("ab\r\n")) line = reader.push(c);
+  TEST_ASSERT_NOT_NULL(line);
+  TEST_ASSERT_EQUAL_STRING("ab", line);
+
+  // Seven characters fit in eight bytes; eight are dropped whole.
+  for (char c : std::string("1234567\n")) line = reader.push(c);
+  TEST_ASSERT_EQUAL_STRING("1234567", line);
+  TEST_ASSERT_FALSE(reader.overflowed());
+  for (char c : std::string("12345678\n")) line = reader.push(c);
+  TEST_ASSERT_NULL(line);
+  TEST_ASSERT_TRUE(reader.overflowed());
+  TEST_ASSERT_FALSE(reader.overflowed());
+
+  for (char c : std::string("ok\n")) line = reader.push(c);
+  TEST_ASSERT_EQUAL_STRING("ok", line);
+}
+
+void test_args() {
+  char text[] = "  recipe.set  fill withdraw:25@100   rest of it  ";
+  ConsoleEngine::Args args(text);
+  TEST_ASSERT_EQUAL_STRING("recipe.set", args.next());
+  TEST_ASSERT_EQUAL_STRING("fill", args.next());
+  TEST_ASSERT_EQUAL_STRING("withdraw:25@100", args.next());
+  TEST_ASSERT_FALSE(args.empty());
+  TEST_ASSERT_EQUAL_STRING("rest of it", args.rest());
+  TEST_ASSERT_TRUE(args.empty());
+  TEST_ASSERT_NULL(args.next());
+
+  char blank[] = "   ";
+  ConsoleEngine::Args none(blank);
+  TEST_ASSERT_TRUE(none.empty());
+  TEST_ASSERT_NULL(none.next());
+}
+
+void test_reply_format_and_escaping() {
+  Capture out;
+  {
+    ConsoleEngine::Reply reply(out, "motion.status", true);
+    reply.data().print("{\"moving\":false}");
+  }
+  TEST_ASSERT_EQUAL_STRING("{\"cmd\":\"motion.status\",\"status\":\"ok\",\"data\":{\"moving\":false}}\r\n",
+                           out.bytes.c_str());
+
+  out.bytes.clear();
+  { ConsoleEngine::Reply reply(out, "bad\"cmd\\", false, "unknown\ncommand"); }
+  TEST_ASSERT_EQUAL_STRING(
+      "{\"cmd\":\"bad\\\"cmd\\\\\",\"status\":\"error\",\"message\":\"unknown\\u000acommand\"}\r\n",
+      out.bytes.c_str());
+}
+
+// Replies larger than the chunk buffer go out in whole chunks, intact.
+void test_reply_streams_large_payloads() {
+  Capture out;
+  std::string payload(1000, 'x');
+  {
+    ConsoleEngine::Reply reply(out, "big", true);
+    Print& data = reply.data();
+    data.print('"');
+    for (char c : payload) data.print(c);
+    data.print('"');
+  }
+  std::string expected = "{\"cmd\":\"big\",\"status\":\"ok\",\"data\":\"" + payload + "\"}\r\n";
+  TEST_ASSERT_EQUAL_STRING(expected.c_str(), out.bytes.c_str());
+  TEST_ASSERT_EQUAL((expected.size() + ConsoleEngine::Reply::kChunk - 1) / ConsoleEngine::Reply::kChunk, out.writes);
+}
+
+void test_json_writer() {
+  Capture out;
+  JsonWriter json(out);
+  json.beginObject();
+  json.member("n", -42);
+  json.member("u", 4000000000u);
+  json.member("f", 2.5f);
+  json.member("nan", NAN);
+  json.member("b", true);
+  json.member("s", "tab\there");
+  json.key("empty").beginArray();
+  json.endArray();
+  json.key("list").beginArray();
+  json.value(1);
+  json.beginObject();
+  json.member("x", static_cast<const char*>(nullptr));
+  json.endObject();
+  json.value(false);
+  json.endArray();
+  json.endObject();
+  TEST_ASSERT_EQUAL_STRING(
+      "{\"n\":-42,\"u\":4000000000,\"f\":2.5,\"nan\":null,\"b\":true,\"s\":\"tab\\u0009here\",\"empty\":[],"
+      "\"list\":[1,{\"x\":null},false]}",
+      out.bytes.c_str());
+}
+
+// The console refuses numbers with trailing garbage instead of reading their
+// prefix.
+void test_console_checks_integer_arguments() {
+  static Shared::WifiManager wifi;
+  static RfidReader rfid;
+  static StepperControl stepper;
+  Console::begin(wifi, rfid, stepper);
+  Serial.setEcho(false);
+  Serial.takeOutput();
+
+  const char* kRefused[] = {"motion.profile 12abc", "motion.profile 1200 3000x", "motion.profile 0",
+                            "motion.profile 1200 0", "proto.telemetry 5hz", "proto.telemetry 201",
+                            "proto.binary 9600baud"};
+  for (const char* line : kRefused) {
+    Console::handleLine(line);
+    std::string reply = Serial.takeOutput();
+    TEST_ASSERT_TRUE(reply.find("\"status\":\"error\"") != std::string::npos);
+  }
+
+  Console::handleLine("no.such.command");
+  TEST_ASSERT_EQUAL_STRING("{\"cmd\":\"no.such.command\",\"status\":\"error\",\"message\":\"unknown command\"}\r\n",
+                           Serial.takeOutput().c_str());
+  Serial.setEcho(true);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_find_every_entry_and_nothing_else);
+  RUN_TEST(test_line_reader);
+  RUN_TEST(test_args);
+  RUN_TEST(test_reply_format_and_escaping);
+  RUN_TEST(test_reply_streams_large_payloads);
+  RUN_TEST(test_json_writer);
+  RUN_TEST(test_console_checks_integer_arguments);
+  return UNITY_END();
+}
@@ -0,0 +1,150 @@
+/**
+ * @file test_main.cpp
+ * @brief Job engine on the virtual clock: start, dwell, abort, and recipes
+ *        rejected before they reach it.
+ */
+#include <Arduino.h>
+#include <math.h>
+#include <string.h>
+#include <unity.h>
+
+#include <initializer_list>
+
+#include "Job.hpp"
+#include "Motion.hpp"
+#include "Recipes.hpp"
+#include "StepperControl.hpp"
+
+namespace {
+
+constexpr TagId kRfid = 0x04A1B2C3D4E5F6ULL;
+constexpr float kStepsPerUl = 100.0f;
+
+StepperControl g_stepper;
+
+Recipes::Recipe recipe(const char* id, std::initializer_list<Recipes::Step> steps) {
+  Recipes::Recipe r;
+  strncpy(r.id, id, sizeof(r.id) - 1);
+  for (const Recipes::Step& s : steps) r.steps[r.stepCount++] = s;
+  return r;
+}
+
+Recipes::Step step(Recipes::Action action, float amount, float rate = 0.0f) {
+  Recipes::Step s = {};
+  s.action = action;
+  s.amount = amount;
+  s.rate = rate;
+  return s;
+}
+
+// Advances the clock in motion-task periods, ticking the job after each.
+void runMs(uint32_t ms) {
+  for (uint32_t i = 0; i < ms; ++i) {
+    HostTimer::runUntil(HostClock::now() + 1000);
+    Job::tick();
+  }
+}
+
+Job::State runUntilStopped(uint32_t maxMs) {
+  for (uint32_t i = 0; i < maxMs; ++i) {
+    runMs(1);
+    Job::State state = Job::progress().state;
+    if (state != Job::State::Running && state != Job::State::Paused) return state;
+  }
+  return Job::progress().state;
+}
+
+}  // namespace
+
+void setUp() {
+  static bool started = false;
+  if (!started) {
+    HostClock::useVirtual(true);
+    HostClock::set(1000000);
+    TEST_ASSERT_TRUE(g_stepper.begin());
+    Motion::begin(g_stepper);
+    TEST_ASSERT_EQUAL(static_cast<int>(Motion::Result::Ok),
+                      static_cast<int>(Motion::setStepsPerMicroliter(kStepsPerUl)));
+    Job::begin(g_stepper);
+    started = true;
+  }
+  runMs(10);
+}
+
+void tearDown() {
+  Job::abort();
+  runMs(10);
+  for (int i = 0; i < 1000 && g_stepper.isMoving(); ++i) runMs(10);
+}
+
+// Out-of-range steps are refused before a job could cast them.
+void test_put_rejects_bad_recipes() {
+  using A = Recipes::Action;
+  TEST_ASSERT_TRUE(Recipes::put(recipe("ok", {step(A::Withdraw, 5.0f, 100.0f), step(A::Dwell, 500.0f)})));
+  TEST_ASSERT_FALSE(Recipes::put(recipe("zero", {step(A::Withdraw, 0.0f)})));
+  TEST_ASSERT_FALSE(Recipes::put(recipe("negative", {step(A::Dispense, -1.0f)})));
+  TEST_ASSERT_FALSE(Recipes::put(recipe("nan", {step(A::Dispense, NAN)})));
+  TEST_ASSERT_FALSE(Recipes::put(recipe("dwell", {step(A::Dwell, 1.0e12f)})));
+  TEST_ASSERT_FALSE(Recipes::put(recipe("volume", {step(A::Withdraw, Recipes::kMaxStepUl * 2)})));
+  TEST_ASSERT_FALSE(Recipes::put(recipe("rate", {step(A::Withdraw, 1.0f, 1.0e30f)})));
+  TEST_ASSERT_FALSE(Recipes::put(recipe("slow", {step(A::Withdraw, 1.0f, -1.0f)})));
+  Recipes::Recipe none;
+  TEST_ASSERT_FALSE(Recipes::find("dwell", none));
+  TEST_ASSERT_FALSE(Recipes::find("rate", none));
+}
+
+void test_start_needs_a_base_and_a_known_recipe() {
+  TEST_ASSERT_TRUE(Recipes::put(recipe("known", {step(Recipes::Action::Dwell, 10.0f)})));
+  TEST_ASSERT_EQUAL(static_cast<int>(Job::Result::NoBase), static_cast<int>(Job::start("known", 0)));
+  TEST_ASSERT_EQUAL(static_cast<int>(Job::Result::UnknownRecipe), static_cast<int>(Job::start("missing", kRfid)));
+  TEST_ASSERT_EQUAL(static_cast<int>(Job::State::Idle), static_cast<int>(Job::progress().state));
+}
+
+// Each step runs in order: the withdraw moves the plunger, the dwell holds it
+// for its time, the dispense moves it back.
+void test_runs_steps_to_done() {
+  using A = Recipes::Action;
+  TEST_ASSERT_TRUE(Recipes::put(
+      recipe("fill", {step(A::Withdraw, 2.0f, 50.0f), step(A::Dwell, 300.0f), step(A::Dispense, 0.5f)})));
+  int32_t start = g_stepper.position();
+  TEST_ASSERT_EQUAL(static_cast<int>(Job::Result::Ok), static_cast<int>(Job::start("fill", kRfid)));
+
+  // Withdraw: 200 steps.
+  for (int i = 0; i < 10000 && Job::progress().step == 0; ++i) runMs(1);
+  TEST_ASSERT_EQUAL(1, Job::progress().step);
+  TEST_ASSERT_EQUAL(static_cast<int>(A::Dwell), static_cast<int>(Job::progress().action));
+  TEST_ASSERT_EQUAL(200, g_stepper.position() - start);
+
+  // The dwell holds the plunger for 300 ms.
+  runMs(290);
+  TEST_ASSERT_EQUAL(1, Job::progress().step);
+  TEST_ASSERT_FALSE(g_stepper.isMoving());
+  runMs(20);
+  TEST_ASSERT_EQUAL(2, Job::progress().step);
+
+  TEST_ASSERT_EQUAL(static_cast<int>(Job::State::Done), static_cast<int>(runUntilStopped(10000)));
+  TEST_ASSERT_EQUAL(150, g_stepper.position() - start);
+}
+
+// Aborting a dwell ends the job at once, and a new job may start.
+void test_abort_mid_dwell() {
+  TEST_ASSERT_TRUE(Recipes::put(recipe("wait", {step(Recipes::Action::Dwell, Recipes::kMaxDwellMs)})));
+  TEST_ASSERT_EQUAL(static_cast<int>(Job::Result::Ok), static_cast<int>(Job::start("wait", kRfid)));
+  runMs(50);
+  TEST_ASSERT_EQUAL(static_cast<int>(Job::State::Running), static_cast<int>(Job::progress().state));
+  TEST_ASSERT_EQUAL(static_cast<int>(Job::Result::Ok), static_cast<int>(Job::abort()));
+  runMs(2);
+  Job::Progress progress = Job::progress();
+  TEST_ASSERT_EQUAL(static_cast<int>(Job::State::Aborted), static_cast<int>(progress.state));
+  TEST_ASSERT_EQUAL_STRING("aborted", progress.reason);
+  TEST_ASSERT_EQUAL(static_cast<int>(Job::Result::Ok), static_cast<int>(Job::start("wait", kRfid)));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_put_rejects_bad_recipes);
+  RUN_TEST(test_start_needs_a_base_and_a_known_recipe);
+  RUN_TEST(test_runs_steps_to_done);
+  RUN_TEST(test_abort_mid_dwell);
+  return UNITY_END();
+}
@@ -0,0 +1,146 @@
+/**
+ * @file test_main.cpp
+ * @brief Per-base motion profiles: selecting, clearing and following edits
+ *        to the docked base.
+ */
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <stdlib.h>
+#include <unity.h>
+
+#include <filesystem>
+#include <string>
+
+#include "CurrentBase.hpp"
+#include "Motion.hpp"
+#include "StepperControl.hpp"
+#include "Storage.hpp"
+
+namespace {
+
+constexpr TagId kDocked = 0x04A1B2C3D4E5F6ull;
+constexpr TagId kOther = 0x04B1B2C3D4E5F6ull;
+
+StepperControl g_stepper;
+std::string g_root;
+
+// 5 uL/s withdraw, 25 uL/s dispense and 20 uL/s^2 at 100 steps/uL.
+Storage::MotionProfile slowBase() {
+  Storage::MotionProfile p;
+  p.withdrawUlPerSec = 5.0f;
+  p.dispenseUlPerSec = 25.0f;
+  p.accelUlPerSec2 = 20.0f;
+  p.dwellMs = 400;
+  return p;
+}
+
+void assertGlobal(uint32_t maxSpeed, uint32_t accel) {
+  TEST_ASSERT_EQUAL_UINT32(maxSpeed, g_stepper.speedLimit(true));
+  TEST_ASSERT_EQUAL_UINT32(maxSpeed, g_stepper.speedLimit(false));
+  TEST_ASSERT_EQUAL_UINT32(maxSpeed, g_stepper.maxSpeed());
+  TEST_ASSERT_EQUAL_UINT32(accel, g_stepper.acceleration());
+  TEST_ASSERT_EQUAL_UINT32(0, Motion::settleMs());
+}
+
+}  // namespace
+
+void setUp() {
+  static bool started = false;
+  if (!started) {
+    TEST_ASSERT_TRUE(g_stepper.begin());
+    Motion::begin(g_stepper);
+    started = true;
+  }
+  Motion::useBaseProfile(nullptr);
+  Motion::setProfile(2000, 8000);
+}
+
+void tearDown() {}
+
+// Speeds in uL/s need a calibration; until then only the settle time applies.
+void test_base_profile_waits_for_a_calibration() {
+  Storage::MotionProfile base = slowBase();
+  Motion::useBaseProfile(&base);
+  TEST_ASSERT_EQUAL_UINT32(2000, g_stepper.speedLimit(true));
+  TEST_ASSERT_EQUAL_UINT32(8000, g_stepper.acceleration());
+  TEST_ASSERT_EQUAL_UINT32(400, Motion::settleMs());
+
+  TEST_ASSERT_TRUE(Motion::setStepsPerMicroliter(100.0f) == Motion::Result::Ok);
+  TEST_ASSERT_EQUAL_UINT32(500, g_stepper.speedLimit(true));
+}
+
+// A base may run faster than the global maximum in one direction and slower
+// in the other; clearing it brings the global profile back.
+void test_select_and_clear() {
+  Storage::MotionProfile base = slowBase();
+  Motion::useBaseProfile(&base);
+  TEST_ASSERT_EQUAL_UINT32(500, g_stepper.speedLimit(true));
+  TEST_ASSERT_EQUAL_UINT32(2500, g_stepper.speedLimit(false));
+  TEST_ASSERT_EQUAL_UINT32(2500, g_stepper.maxSpeed());
+  TEST_ASSERT_EQUAL_UINT32(2000, g_stepper.acceleration());
+  TEST_ASSERT_EQUAL_UINT32(400, Motion::settleMs());
+
+  Motion::useBaseProfile(nullptr);
+  assertGlobal(2000, 8000);
+}
+
+void test_unset_fields_fall_back_to_global() {
+  Storage::MotionProfile base;
+  base.withdrawUlPerSec = 5.0f;
+  Motion::useBaseProfile(&base);
+  TEST_ASSERT_EQUAL_UINT32(500, g_stepper.speedLimit(true));
+  TEST_ASSERT_EQUAL_UINT32(2000, g_stepper.speedLimit(false));
+  TEST_ASSERT_EQUAL_UINT32(8000, g_stepper.acceleration());
+
+  // A new global profile applies underneath the docked base.
+  Motion::setProfile(2500, 10000);
+  TEST_ASSERT_EQUAL_UINT32(500, g_stepper.speedLimit(true));
+  TEST_ASSERT_EQUAL_UINT32(2500, g_stepper.speedLimit(false));
+  TEST_ASSERT_EQUAL_UINT32(10000, g_stepper.acceleration());
+  Motion::useBaseProfile(nullptr);
+  assertGlobal(2500, 10000);
+}
+
+// Edits over HTTP only flag the slot when they hit the docked base; the web
+// task then reapplies the profile from the slot.
+void test_edits_to_the_docked_base_are_flagged() {
+  char dir[] = "/tmp/motion-XXXXXX";
+  g_root = mkdtemp(dir);
+  HostFs::setRoot(g_root.c_str());
+  TEST_ASSERT_TRUE(Storage::init());
+  Storage::BaseInfo info;
+  info.motion = slowBase();
+  TEST_ASSERT_TRUE(Storage::saveBase(kDocked, info));
+
+  CurrentBase::load(kDocked);
+  CurrentBase::takeChanged();
+  TEST_ASSERT_TRUE(CurrentBase::get().known);
+
+  CurrentBase::onSaved(kOther, Storage::BaseInfo());
+  CurrentBase::onDeleted(kOther);
+  TEST_ASSERT_FALSE(CurrentBase::takeChanged());
+
+  info.motion.withdrawUlPerSec = 10.0f;
+  CurrentBase::onSaved(kDocked, info);
+  TEST_ASSERT_TRUE(CurrentBase::takeChanged());
+  TEST_ASSERT_FALSE(CurrentBase::takeChanged());
+  CurrentBase::Slot slot = CurrentBase::get();
+  Motion::useBaseProfile(slot.known ? &slot.info.motion : nullptr);
+  TEST_ASSERT_EQUAL_UINT32(1000, g_stepper.speedLimit(true));
+
+  CurrentBase::onDeleted(kDocked);
+  TEST_ASSERT_TRUE(CurrentBase::takeChanged());
+  TEST_ASSERT_FALSE(CurrentBase::get().known);
+
+  Storage::flush();
+  std::filesystem::remove_all(g_root);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_base_profile_waits_for_a_calibration);
+  RUN_TEST(test_select_and_clear);
+  RUN_TEST(test_unset_fields_fall_back_to_global);
+  RUN_TEST(test_edits_to_the_docked_base_are_flagged);
+  return UNITY_END();
+}
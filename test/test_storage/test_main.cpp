@@ -0,0 +1,319 @@
+/**
+ * @file test_main.cpp
+ * @brief Storage write coalescing: which saves and deletes reach flash, and
+ *        when; and the read cache once it is full.
+ */
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <stdlib.h>
+#include <unity.h>
+
+#include <filesystem>
+#include <string>
+
+#include "BaseStore.hpp"
+#include "Storage.hpp"
+
+namespace {
+
+constexpr size_t kRecordBytes = 216;
+constexpr TagId kTag = 0x04A1B2C3D4E5F6ull;
+
+std::string g_root;
+std::string g_visited;
+
+Storage::BaseInfo named(const char* paint) {
+  Storage::BaseInfo info;
+  strlcpy(info.paintName, paint, sizeof(info.paintName));
+  return info;
+}
+
+size_t fileBytes() { return Storage::storeStats().fileBytes; }
+
+void advanceMs(uint32_t ms) { HostClock::advance(static_cast<uint64_t>(ms) * 1000); }
+
+// Saves a base and commits it, as if the UI had gone quiet.
+void stored(TagId rfid, const char* paint) {
+  TEST_ASSERT_TRUE(Storage::saveBase(rfid, named(paint)));
+  TEST_ASSERT_TRUE(Storage::flush());
+}
+
+// The tick after a quiet window with the plunger at rest.
+void settle() {
+  advanceMs(STORAGE_COALESCE_MS);
+  Storage::tick(true);
+}
+
+void assertPaint(TagId rfid, const char* paint) {
+  Storage::BaseInfo out;
+  TEST_ASSERT_TRUE(Storage::loadBase(rfid, out));
+  TEST_ASSERT_EQUAL_STRING(paint, out.paintName);
+}
+
+}  // namespace
+
+void setUp() {
+  char dir[] = "/tmp/storage-XXXXXX";
+  g_root = mkdtemp(dir);
+  HostFs::setRoot(g_root.c_str());
+  HostClock::useVirtual(true);
+  HostClock::set(1000000);
+  g_visited.clear();
+  TEST_ASSERT_TRUE(Storage::init());
+}
+
+void tearDown() {
+  Storage::flush();
+  HostClock::useVirtual(false);
+  std::filesystem::remove_all(g_root);
+}
+
+// New bases wait like edits, but counts and listings include them at once.
+void test_new_bases_wait_for_a_commit() {
+  size_t before = fileBytes();
+  TEST_ASSERT_TRUE(Storage::saveBase(kTag, named("Cobalt")));
+  TEST_ASSERT_EQUAL(before, fileBytes());
+  TEST_ASSERT_EQUAL(1, Storage::writeStats().pending);
+  TEST_ASSERT_EQUAL(1, Storage::baseCount());
+  assertPaint(kTag, "Cobalt");
+  TagId ids[4];
+  size_t count = 0;
+  TEST_ASSERT_TRUE(Storage::listBaseIds(ids, 4, count));
+  TEST_ASSERT_EQUAL(1, count);
+  TEST_ASSERT_TRUE(ids[0] == kTag);
+
+  settle();
+  TEST_ASSERT_EQUAL(before + kRecordBytes, fileBytes());
+  TEST_ASSERT_EQUAL(0, Storage::writeStats().pending);
+  TEST_ASSERT_TRUE(Storage::init());
+  assertPaint(kTag, "Cobalt");
+}
+
+// A burst of edits to one base costs one record once the burst goes quiet.
+void test_burst_of_edits_is_one_record() {
+  stored(kTag, "v0");
+  Storage::WriteStats start = Storage::writeStats();
+  size_t before = fileBytes();
+
+  char paint[8];
+  for (int i = 1; i <= 5; ++i) {
+    snprintf(paint, sizeof(paint), "v%d", i);
+    TEST_ASSERT_TRUE(Storage::saveBase(kTag, named(paint)));
+    advanceMs(100);
+    Storage::tick(true);
+  }
+  Storage::WriteStats held = Storage::writeStats();
+  TEST_ASSERT_EQUAL(before, fileBytes());
+  TEST_ASSERT_EQUAL(1, held.pending);
+  TEST_ASSERT_EQUAL(4, held.coalesced - start.coalesced);
+  // Readers see the newest edit before it reaches flash.
+  assertPaint(kTag, "v5");
+
+  advanceMs(STORAGE_COALESCE_MS);
+  Storage::tick(true);
+  Storage::WriteStats done = Storage::writeStats();
+  TEST_ASSERT_EQUAL(before + kRecordBytes, fileBytes());
+  TEST_ASSERT_EQUAL(0, done.pending);
+  TEST_ASSERT_EQUAL(1, done.recordsWritten - start.recordsWritten);
+
+  TEST_ASSERT_TRUE(Storage::init());
+  assertPaint(kTag, "v5");
+}
+
+void test_unchanged_save_writes_nothing() {
+  stored(kTag, "Same");
+  Storage::WriteStats start = Storage::writeStats();
+  size_t before = fileBytes();
+  TEST_ASSERT_TRUE(Storage::saveBase(kTag, named("Same")));
+  TEST_ASSERT_EQUAL(1, Storage::writeStats().unchanged - start.unchanged);
+  TEST_ASSERT_EQUAL(0, Storage::writeStats().pending);
+  advanceMs(STORAGE_MAX_DELAY_MS);
+  Storage::tick(true);
+  TEST_ASSERT_EQUAL(before, fileBytes());
+}
+
+// Edits that keep arriving are still committed once the oldest has waited
+// STORAGE_MAX_DELAY_MS.
+void test_max_delay_bounds_a_steady_stream() {
+  stored(kTag, "v0");
+  size_t before = fileBytes();
+  char paint[8];
+  uint32_t waited = 0;
+  for (int i = 1; fileBytes() == before; ++i) {
+    snprintf(paint, sizeof(paint), "v%d", i);
+    Storage::saveBase(kTag, named(paint));
+    advanceMs(STORAGE_COALESCE_MS / 2);
+    waited += STORAGE_COALESCE_MS / 2;
+    Storage::tick(true);
+    TEST_ASSERT_TRUE(waited <= STORAGE_MAX_DELAY_MS + STORAGE_COALESCE_MS);
+  }
+  TEST_ASSERT_TRUE(waited >= STORAGE_MAX_DELAY_MS);
+}
+
+// Flash writes hold off the step ISR, so nothing is committed while the
+// plunger moves, even past the maximum delay.
+void test_commits_wait_for_motion_to_stop() {
+  stored(kTag, "v0");
+  Storage::saveBase(kTag, named("v1"));
+  Storage::saveBase(kTag + 1, named("new"));
+  Storage::deleteBase(kTag);
+  size_t before = fileBytes();
+  advanceMs(STORAGE_MAX_DELAY_MS * 2);
+  Storage::tick(false);
+  TEST_ASSERT_EQUAL(before, fileBytes());
+  TEST_ASSERT_EQUAL(2, Storage::writeStats().pending);
+  Storage::tick(true);
+  TEST_ASSERT_EQUAL(before + 2 * kRecordBytes, fileBytes());
+}
+
+// A delete replaces a pending edit and is committed like one.
+void test_delete_waits_for_a_commit() {
+  stored(kTag, "v0");
+  Storage::saveBase(kTag, named("v1"));
+  size_t before = fileBytes();
+  TEST_ASSERT_TRUE(Storage::deleteBase(kTag));
+  TEST_ASSERT_FALSE(Storage::deleteBase(kTag));
+  TEST_ASSERT_EQUAL(before, fileBytes());
+  TEST_ASSERT_EQUAL(1, Storage::writeStats().pending);
+  TEST_ASSERT_EQUAL(0, Storage::baseCount());
+  Storage::BaseInfo out;
+  TEST_ASSERT_FALSE(Storage::loadBase(kTag, out));
+
+  settle();
+  TEST_ASSERT_EQUAL(before + kRecordBytes, fileBytes());
+  TEST_ASSERT_TRUE(Storage::init());
+  TEST_ASSERT_FALSE(Storage::loadBase(kTag, out));
+}
+
+// Deleting a base that never reached flash leaves nothing to write.
+void test_delete_of_a_new_base_writes_nothing() {
+  size_t before = fileBytes();
+  Storage::saveBase(kTag, named("v0"));
+  TEST_ASSERT_TRUE(Storage::deleteBase(kTag));
+  TEST_ASSERT_EQUAL(0, Storage::writeStats().pending);
+  settle();
+  TEST_ASSERT_EQUAL(before, fileBytes());
+}
+
+// With every slot taken, writes for other tags are refused rather than
+// committed mid-move; edits to a held tag still go through.
+void test_full_pending_table_refuses_other_tags() {
+  stored(kTag + 100, "kept");
+  for (TagId i = 0; i < 8; ++i) TEST_ASSERT_TRUE(Storage::saveBase(kTag + i, named("new")));
+  size_t before = fileBytes();
+  TEST_ASSERT_FALSE(Storage::saveBase(kTag + 8, named("new")));
+  TEST_ASSERT_FALSE(Storage::deleteBase(kTag + 100));
+  TEST_ASSERT_TRUE(Storage::saveBase(kTag + 3, named("edited")));
+  advanceMs(STORAGE_MAX_DELAY_MS);
+  Storage::tick(false);
+  TEST_ASSERT_EQUAL(before, fileBytes());
+
+  Storage::tick(true);
+  TEST_ASSERT_EQUAL(before + 8 * kRecordBytes, fileBytes());
+  TEST_ASSERT_TRUE(Storage::saveBase(kTag + 8, named("new")));
+  TEST_ASSERT_TRUE(Storage::deleteBase(kTag + 100));
+  assertPaint(kTag + 3, "edited");
+}
+
+// Listings merge pending saves and deletes into the store's order, page by
+// page.
+void test_listings_include_pending_edits() {
+  stored(10, "a");
+  stored(30, "c");
+  stored(50, "e");
+  Storage::saveBase(20, named("b"));
+  Storage::saveBase(60, named("f"));
+  Storage::deleteBase(30);
+  TEST_ASSERT_EQUAL(4, Storage::baseCount());
+
+  const TagId expected[] = {10, 20, 50, 60};
+  TagId page[3];
+  size_t count = 0;
+  TEST_ASSERT_TRUE(Storage::listBaseIds(page, 3, count));
+  TEST_ASSERT_EQUAL(3, count);
+  for (size_t i = 0; i < 3; ++i) TEST_ASSERT_TRUE(page[i] == expected[i]);
+  TEST_ASSERT_TRUE(Storage::listBaseIds(page, 3, count, page[2]));
+  TEST_ASSERT_EQUAL(1, count);
+  TEST_ASSERT_TRUE(page[0] == 60);
+
+  size_t visited = Storage::visitBases(0, 10, [](TagId, const Storage::BaseInfo& info, void* seen) {
+    static_cast<std::string*>(seen)->append(info.paintName);
+    return true;
+  }, &g_visited);
+  TEST_ASSERT_EQUAL(4, visited);
+  TEST_ASSERT_EQUAL_STRING("abef", g_visited.c_str());
+}
+
+// Loading a 7-byte tag whose record older firmware keyed by its last four
+// UID bytes answers from that record and only queues the move.
+void test_legacy_record_moves_on_the_next_commit() {
+  constexpr TagId kLegacy = 0xC3D4E5F6u;
+  {
+    BaseStore seed;
+    TEST_ASSERT_TRUE(seed.open("/bases.db"));
+    TEST_ASSERT_TRUE(seed.put(kLegacy, named("Ochre"), true));
+  }
+  TEST_ASSERT_TRUE(Storage::init());
+  size_t before = fileBytes();
+
+  assertPaint(kTag, "Ochre");
+  TEST_ASSERT_EQUAL(before, fileBytes());
+  TEST_ASSERT_EQUAL(2, Storage::writeStats().pending);
+  Storage::BaseInfo out;
+  TEST_ASSERT_FALSE(Storage::loadBase(kLegacy, out));
+  TEST_ASSERT_EQUAL(1, Storage::baseCount());
+
+  settle();
+  TEST_ASSERT_EQUAL(0, Storage::writeStats().pending);
+  TEST_ASSERT_TRUE(Storage::init());
+  assertPaint(kTag, "Ochre");
+  TEST_ASSERT_FALSE(Storage::loadBase(kLegacy, out));
+}
+
+void test_flush_commits_at_once() {
+  stored(kTag, "v0");
+  Storage::saveBase(kTag, named("v1"));
+  size_t before = fileBytes();
+  TEST_ASSERT_TRUE(Storage::flush());
+  TEST_ASSERT_EQUAL(before + kRecordBytes, fileBytes());
+  TEST_ASSERT_EQUAL(0, Storage::writeStats().pending);
+}
+
+// Past capacity, a new record evicts the least recently used one, and the
+// evicted one is read back from flash.
+void test_full_cache_evicts_the_least_recently_used() {
+  size_t capacity = Storage::cacheStats().capacity;
+  for (size_t i = 0; i < capacity; ++i) stored(kTag + i, "Base");
+  TEST_ASSERT_EQUAL(0, Storage::cacheStats().evictions);
+  assertPaint(kTag, "Base");
+  stored(kTag + capacity, "Last");
+
+  Storage::CacheStats stats = Storage::cacheStats();
+  TEST_ASSERT_EQUAL(capacity, stats.entries);
+  TEST_ASSERT_EQUAL(1, stats.evictions);
+  assertPaint(kTag, "Base");
+  assertPaint(kTag + capacity, "Last");
+  TEST_ASSERT_EQUAL(stats.misses, Storage::cacheStats().misses);
+  assertPaint(kTag + 1, "Base");
+  stats = Storage::cacheStats();
+  TEST_ASSERT_EQUAL(1, stats.misses);
+  TEST_ASSERT_EQUAL(2, stats.evictions);
+  TEST_ASSERT_FALSE(stats.complete);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_new_bases_wait_for_a_commit);
+  RUN_TEST(test_burst_of_edits_is_one_record);
+  RUN_TEST(test_unchanged_save_writes_nothing);
+  RUN_TEST(test_max_delay_bounds_a_steady_stream);
+  RUN_TEST(test_commits_wait_for_motion_to_stop);
+  RUN_TEST(test_delete_waits_for_a_commit);
+  RUN_TEST(test_delete_of_a_new_base_writes_nothing);
+  RUN_TEST(test_full_pending_table_refuses_other_tags);
+  RUN_TEST(test_listings_include_pending_edits);
+  RUN_TEST(test_legacy_record_moves_on_the_next_commit);
+  RUN_TEST(test_flush_commits_at_once);
+  RUN_TEST(test_full_cache_evicts_the_least_recently_used);
+  return UNITY_END();
+}
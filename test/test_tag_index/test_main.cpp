@@ -0,0 +1,125 @@
+/**
+ * @file test_main.cpp
+ * @brief TagIndex against a std::map model.
+ */
+#include <unity.h>
+
+#include <map>
+#include <random>
+
+#include "TagIndex.hpp"
+
+namespace {
+
+constexpr size_t kCapacity = 64;
+using Index = TagIndex<kCapacity>;
+
+Index g_index;
+
+// Every model entry is found with its value and nothing else is stored.
+void checkAgainst(const std::map<TagId, uint32_t>& model) {
+  TEST_ASSERT_EQUAL(model.size(), g_index.size());
+  for (const auto& kv : model) {
+    const uint32_t* v = g_index.find(kv.first);
+    TEST_ASSERT_NOT_NULL(v);
+    TEST_ASSERT_EQUAL_UINT32(kv.second, *v);
+  }
+  size_t seen = 0;
+  g_index.forEach([&](TagId key, uint32_t& value) {
+    ++seen;
+    auto it = model.find(key);
+    TEST_ASSERT_TRUE(it != model.end());
+    TEST_ASSERT_EQUAL_UINT32(it->second, value);
+  });
+  TEST_ASSERT_EQUAL(model.size(), seen);
+}
+
+}  // namespace
+
+void setUp() { g_index.clear(); }
+void tearDown() {}
+
+void test_put_find_update() {
+  TEST_ASSERT_TRUE(g_index.put(0x04A1B2C3D4E5F6ull, 16));
+  TEST_ASSERT_TRUE(g_index.put(0xC3D4E5F6u, 232));
+  TEST_ASSERT_EQUAL_UINT32(16, *g_index.find(0x04A1B2C3D4E5F6ull));
+  TEST_ASSERT_EQUAL_UINT32(232, *g_index.find(0xC3D4E5F6u));
+  TEST_ASSERT_NULL(g_index.find(0x1234));
+
+  TEST_ASSERT_TRUE(g_index.put(0xC3D4E5F6u, 448));
+  TEST_ASSERT_EQUAL(2, g_index.size());
+  TEST_ASSERT_EQUAL_UINT32(448, *g_index.find(0xC3D4E5F6u));
+}
+
+void test_zero_is_not_a_key() {
+  TEST_ASSERT_FALSE(g_index.put(0, 1));
+  TEST_ASSERT_FALSE(g_index.contains(0));
+  TEST_ASSERT_FALSE(g_index.erase(0));
+  TEST_ASSERT_EQUAL(0, g_index.size());
+}
+
+void test_full_index_refuses_new_keys_only() {
+  for (size_t i = 1; i <= kCapacity; ++i) TEST_ASSERT_TRUE(g_index.put(i * 0x10001ull, i));
+  TEST_ASSERT_FALSE(g_index.put(0xFFFFFF, 1));
+  TEST_ASSERT_TRUE(g_index.put(0x10001ull, 99));
+  TEST_ASSERT_EQUAL_UINT32(99, *g_index.find(0x10001ull));
+  TEST_ASSERT_EQUAL(kCapacity, g_index.size());
+}
+
+// Random inserts and erases at full load; backward-shift deletion must keep
+// every remaining key reachable.
+void test_matches_model_under_churn() {
+  std::mt19937_64 rng(12345);
+  std::map<TagId, uint32_t> model;
+  // A small key space forces collisions and long runs.
+  auto randomKey = [&]() { return static_cast<TagId>(rng() % 200 + 1) * 0x0100000001ull; };
+  for (int step = 0; step < 20000; ++step) {
+    TagId key = randomKey();
+    if (rng() % 3 == 0) {
+      TEST_ASSERT_EQUAL(model.erase(key) == 1, g_index.erase(key));
+    } else {
+      uint32_t value = static_cast<uint32_t>(rng());
+      bool fits = model.count(key) || model.size() < kCapacity;
+      TEST_ASSERT_EQUAL(fits, g_index.put(key, value));
+      if (fits) model[key] = value;
+    }
+    if (step % 1000 == 0) checkAgainst(model);
+  }
+  checkAgainst(model);
+  TEST_ASSERT_TRUE(g_index.maxProbe() >= 1 && g_index.maxProbe() <= Index::kSlots);
+}
+
+void test_list_after_pages_in_order() {
+  std::mt19937_64 rng(7);
+  std::map<TagId, uint32_t> model;
+  while (model.size() < kCapacity) {
+    TagId key = (rng() & 0x00FFFFFFFFFFFFFFull) | 1;
+    model[key] = 0;
+    g_index.put(key, 0);
+  }
+
+  TagId page[10];
+  TagId after = 0;
+  auto expected = model.begin();
+  for (;;) {
+    size_t n = g_index.listAfter(after, page, 10);
+    if (n == 0) break;
+    for (size_t i = 0; i < n; ++i, ++expected) {
+      TEST_ASSERT_TRUE(expected != model.end());
+      TEST_ASSERT_TRUE(page[i] == expected->first);
+    }
+    after = page[n - 1];
+  }
+  TEST_ASSERT_TRUE(expected == model.end());
+  TEST_ASSERT_EQUAL(0, g_index.listAfter(0, page, 0));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_put_find_update);
+  RUN_TEST(test_zero_is_not_a_key);
+  RUN_TEST(test_full_index_refuses_new_keys_only);
+  RUN_TEST(test_matches_model_under_churn);
+  RUN_TEST(test_list_after_pages_in_order);
+  return UNITY_END();
+}
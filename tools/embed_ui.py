@@ -0,0 +1,68 @@
+"""Gzip web/index.html into a generated C header at build time.
+
+PlatformIO runs this as a pre: extra script; the header lands in
+$BUILD_DIR/generated/IndexHtml.h and that directory is added to the include
+path. It can also be run by hand: python tools/embed_ui.py <out_dir>.
+
+The ETag is a hash of the uncompressed page, so it changes exactly when the
+UI does. The header is only rewritten when its contents change, which keeps
+incremental builds incremental.
+"""
+
+import gzip
+import hashlib
+import os
+import sys
+
+HEADER_NAME = "IndexHtml.h"
+
+
+def render(html):
+    gz = gzip.compress(html, compresslevel=9, mtime=0)
+    etag = hashlib.sha256(html).hexdigest()[:16]
+    lines = [
+        "// Generated by tools/embed_ui.py from web/index.html. Do not edit.",
+        "#pragma once",
+        "",
+        "#include <Arduino.h>",
+        "",
+        'constexpr char kIndexHtmlEtag[] = "\\"%s\\"";' % etag,
+        "constexpr size_t kIndexHtmlGzLen = %d;" % len(gz),
+        "const uint8_t kIndexHtmlGz[] PROGMEM = {",
+    ]
+    for i in range(0, len(gz), 16):
+        lines.append("  " + ", ".join("0x%02x" % b for b in gz[i:i + 16]) + ",")
+    lines.append("};")
+    lines.append("")
+    return "\n".join(lines), len(html), len(gz)
+
+
+def generate(project_dir, out_dir):
+    src = os.path.join(project_dir, "web", "index.html")
+    with open(src, "rb") as f:
+        text, raw_len, gz_len = render(f.read())
+
+    os.makedirs(out_dir, exist_ok=True)
+    dst = os.path.join(out_dir, HEADER_NAME)
+    if os.path.exists(dst):
+        with open(dst) as f:
+            if f.read() == text:
+                return
+    with open(dst, "w") as f:
+        f.write(text)
+    print("embed_ui: %s %d -> %d bytes gzipped" % (HEADER_NAME, raw_len, gz_len))
+
+
+try:
+    Import("env")  # noqa: F821 - provided by PlatformIO's SCons runtime
+except NameError:
+    env = None
+
+if env is not None:
+    out = os.path.join(env.subst("$BUILD_DIR"), "generated")
+    generate(env.subst("$PROJECT_DIR"), out)
+    env.Append(CPPPATH=[out])
+elif __name__ == "__main__":
+    if len(sys.argv) != 2:
+        sys.exit("usage: embed_ui.py <out_dir>")
+    generate(os.path.join(os.path.dirname(os.path.abspath(__file__)), ".."), sys.argv[1])